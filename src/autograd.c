@@ -74,6 +74,145 @@ gzStackBlockTop(stack_blocks_state *State) {
     return State->CurrentBlock->TensorPtr[State->CurrentBlockTopIdx];
 }
 
+/* ============================================
+ * NOTE(abid): Gradient Scratch Pool
+ * ============================================ */
+
+/* NOTE(abid): Non-leaf grads only live from the moment the first consumer passes its grad down, until
+ *             the tensor itself has passed it on to its operands. They are handed out from this pool
+ *             and given back right after, so the same few buffers get reused over the whole backward
+ *             pass. The chunks are kept around across steps, therefore after the first step the pool
+ *             does not allocate anymore. */
+global_var grad_pool __gzGLOBALGradPool = {0};
+
+internal inline u32
+__gz_grad_pool_size_class(usize bytes) {
+    u32 size_class = 0;
+    usize class_bytes = GZ_GRAD_POOL_MIN_CLASS_BYTES;
+    while(class_bytes < bytes) { class_bytes <<= 1; ++size_class; }
+    assert(size_class < GZ_GRAD_POOL_NUM_CLASSES, "grad buffer of %zu bytes is too large for the pool", bytes);
+
+    return size_class;
+}
+
+internal f32 *
+gz_grad_pool_acquire(grad_pool *pool, usize num_elements) {
+    usize bytes = num_elements*sizeof(f32);
+    u32 size_class = __gz_grad_pool_size_class(bytes);
+    usize class_bytes = (usize)GZ_GRAD_POOL_MIN_CLASS_BYTES << size_class;
+
+    gz_spin_lock(&pool->lock);
+    grad_pool_block *block = pool->free_lists[size_class];
+    if(block) pool->free_lists[size_class] = block->next_free;
+    else {
+        usize block_bytes = sizeof(grad_pool_block) + class_bytes;
+        if(!pool->chunk || (pool->chunk->size - pool->chunk->used) < block_bytes) {
+            /* NOTE(abid): The remainder of the old chunk is simply abandoned, it is at most one block. */
+            usize chunk_bytes = GZ_GRAD_POOL_CHUNK_BYTES;
+            if(chunk_bytes < block_bytes) chunk_bytes = block_bytes;
+
+            /* NOTE(abid): Chunks are never freed, so we can align the start without keeping the original pointer. */
+            u8 *memory = (u8 *)Malloc(chunk_bytes + 2*sizeof(grad_pool_block));
+            assert(memory, "failed to allocate grad pool chunk");
+            grad_pool_chunk *chunk = (grad_pool_chunk *)(((uintptr)memory + sizeof(grad_pool_block)-1) &
+                                                         ~(uintptr)(sizeof(grad_pool_block)-1));
+            chunk->prev = pool->chunk;
+            chunk->size = chunk_bytes;
+            chunk->used = 0;
+            pool->chunk = chunk;
+            pool->bytes_reserved += chunk_bytes;
+        }
+        /* NOTE(abid): Blocks start one `grad_pool_block` after the chunk header. */
+        block = (grad_pool_block *)((u8 *)pool->chunk + sizeof(grad_pool_block) + pool->chunk->used);
+        pool->chunk->used += block_bytes;
+    }
+    block->next_free = NULL;
+    block->size_class = size_class;
+
+    pool->bytes_in_use += class_bytes;
+    if(pool->bytes_in_use > pool->peak_bytes_in_use) pool->peak_bytes_in_use = pool->bytes_in_use;
+    gz_spin_unlock(&pool->lock);
+
+    f32 *result = (f32 *)(block+1);
+    memset(result, 0, bytes);
+    return result;
+}
+
+internal void
+gz_grad_pool_release(grad_pool *pool, void *ptr) {
+    grad_pool_block *block = (grad_pool_block *)ptr - 1;
+    assert(block->size_class < GZ_GRAD_POOL_NUM_CLASSES, "pointer was not handed out by the grad pool");
+
+    gz_spin_lock(&pool->lock);
+    block->next_free = pool->free_lists[block->size_class];
+    pool->free_lists[block->size_class] = block;
+    pool->bytes_in_use -= (usize)GZ_GRAD_POOL_MIN_CLASS_BYTES << block->size_class;
+    gz_spin_unlock(&pool->lock);
+}
+
+/* NOTE(abid): Whether backprop has to deliver a grad to this tensor at all. */
+internal inline bool
+__gzNeedsGrad(t32 *A) { return A->Header->ShouldGrad; }
+
+internal inline bool
+__gzIsLeaf(t32 *A) { return A->Header->DerivedOp.TensorOp == op_none; }
+
+/* NOTE(abid): The tensor whose grad storage a grad for `A` ends up in. A view of a leaf shares the grad of the
+ *             leaf, so anything that accumulates into the view accumulates into the leaf. */
+internal inline t32 *
+__gzGradOwner(t32 *A) {
+    t32 *Owner = A;
+    while(Owner->Header->DerivedOp.TensorOp == op_unary_view) Owner = Owner->Header->DerivedOp.Operands[0];
+    return __gzIsLeaf(Owner) ? Owner : A;
+}
+
+/* NOTE(abid): The hook is kept in the meta arena of `Arena`, so it goes away together with the model. A
+ *             second registration replaces the first one. */
+internal void
+gz_grad_hook_register(t32 *A, grad_hook_fn *Fn, void *Context, mem_arena *Arena) {
+    assert(A->Header->HasAutograd && A->Header->ShouldGrad, "grad hook on a tensor that does not track grads");
+    assert(__gzIsLeaf(A), "grad hooks can only be registered on leaf tensors");
+    grad_hook *Hook = gz_mem_push_struct(grad_hook, gz_mem_arena_meta(Arena));
+    Hook->fn = Fn;
+    Hook->context = Context;
+    A->Header->GradHook = Hook;
+}
+
+internal inline void
+gz_grad_hook_remove(t32 *A) { A->Header->GradHook = NULL; }
+
+/* NOTE(abid): Called once all consumers of `A` have passed their grad down, and none of them reads its data
+ *             anymore. */
+internal inline void
+__gzLeafGradFinal(t32 *A) {
+    grad_hook *Hook = A->Header->GradHook;
+    if(Hook) Hook->fn(A, Hook->context);
+}
+
+/* NOTE(abid): Make sure the tensor has a grad to accumulate into. Leaves bring their own,
+ *             non-leaf grads are taken from the pool on first use. */
+internal inline void
+__gzEnsureGrad(t32 *A) {
+    if(A->Grad.Ptr) return;
+    assert(!__gzIsLeaf(A), "leaf tensor requires grad, but has no grad storage");
+
+    /* NOTE(abid): When a memory plan is replayed, the grad has its own place in the slab. */
+    f32 *PlannedGrad = __gz_mem_plan_grad_for(A);
+    if(PlannedGrad) memset(PlannedGrad, 0, A->Header->StorageNumElements*sizeof(f32));
+    else PlannedGrad = gz_grad_pool_acquire(&__gzGLOBALGradPool, A->Header->StorageNumElements);
+
+    A->Grad.Ptr = PlannedGrad;
+    A->Header->IsGradTransient = true;
+}
+
+internal inline void
+__gzReleaseGrad(t32 *A) {
+    if(!A->Header->IsGradTransient) return;
+    if(!__gz_mem_plan_owns(A->Grad.Ptr)) gz_grad_pool_release(&__gzGLOBALGradPool, A->Grad.Ptr);
+    A->Grad.Ptr = NULL;
+    A->Header->IsGradTransient = false;
+}
+
 /* ============================================
  * NOTE(Abid): Backward Operations
  * ============================================ */
@@ -104,288 +243,304 @@ __gzBackwardSetElements(t32 *A, f32 Value)
 { __GZ_BACKWARD_OP_ELEMENTS_SCALAR(A, Value, =); }
 #undef __GZ_BACKWARD_OP_ELEMENTS_SCALAR
 
-/* NOTE(Abid): The following operation does a reduce sum on the broadcast dims of A and add/sub/mul/div
- *             it to Result tensor. There is a faster way to do it, but that most likely requires a
- *             malloc which I shall never do. */
-#define __GZ_REDUCE_BROADCAST_DIMS(A, Result, OP) \
-    assert(A->Header->Dim >= Result->Header->Dim, "result tensor cannot be higher than operand"); \
-    size_t ANumData = A->Header->StorageNumElements; \
-    \
-    size_t ResultOffset = 0; \
-    size_t AOffset = 0; \
-    for(size_t OpNum = 1; OpNum <= ANumData; ++OpNum) { \
-        *((f32 *)Result->Grad.Ptr + ResultOffset) OP *((f32 *)A->Grad.Ptr + AOffset); \
-                                                        \
-        i32 DimMaxNumSoFar = 1; \
-        for(i32 DimIdx = 1; DimIdx <= (i32)A->Header->Dim; ++DimIdx) { \
-            DimMaxNumSoFar *= A->Header->Sizes[A->Header->Dim-DimIdx]; \
-            if(OpNum % DimMaxNumSoFar == 0) { \
-                AOffset -= A->Header->Strides[A->Header->Dim-DimIdx]*(A->Header->Sizes[A->Header->Dim-DimIdx]-1); \
-                if((i32)Result->Header->Dim - DimIdx < 0) ResultOffset = 0; \
-                else ResultOffset -= Result->Header->Strides[Result->Header->Dim-DimIdx]*(Result->Header->Sizes[Result->Header->Dim-DimIdx]-1); \
-                continue; \
-            } \
-            AOffset += A->Header->Strides[A->Header->Dim-DimIdx]; \
-            if((i32)Result->Header->Dim - DimIdx >= 0) ResultOffset += Result->Header->Strides[Result->Header->Dim-DimIdx]; \
-            break; \
-        } \
+/* NOTE(abid): Broadcast backward. The parent is walked through the merged dims of `broadcast_reduce`,
+ *             the innermost dim is either summed into a single element (reduced) or added elementwise
+ *             (kept), both of which are plain loops over contiguous memory in the common layouts. */
+internal void
+__gzBroadcastReduceBuild(broadcast_reduce *Reduce, t32 *Parent, t32 *Dest, t32 *Other) {
+    tensor_header *ParentHeader = Parent->Header;
+    tensor_header *DestHeader = Dest->Header;
+    assert(ParentHeader->Dim >= DestHeader->Dim, "operand tensor dim cannot be higher than parent");
+    assert(!Other || (ParentHeader->Dim >= Other->Header->Dim), "operand tensor dim cannot be higher than parent");
+    assert(Parent->Data.DType == dtype_f32 && Dest->Data.DType == dtype_f32 && (!Other || Other->Data.DType == dtype_f32),
+           "cannot backpropagate through a non-float tensor");
+
+    Reduce->num_dims = 0;
+    for(u32 DimIdx = 0; DimIdx < ParentHeader->Dim; ++DimIdx) {
+        usize Size = GetSizeR(Parent, DimIdx);
+        if(Size == 1) continue;
+
+        usize SrcStride = GetStrideR(Parent, DimIdx);
+        usize DestStride = ((DimIdx < DestHeader->Dim) && (GetSizeR(Dest, DimIdx) != 1)) ? GetStrideR(Dest, DimIdx) : 0;
+        usize OtherStride = (Other && (DimIdx < Other->Header->Dim) && (GetSizeR(Other, DimIdx) != 1))
+                          ? GetStrideR(Other, DimIdx) : 0;
+
+        /* NOTE(abid): Merge into the inner dim when stepping over it once is the same as one step here. */
+        if(Reduce->num_dims) {
+            u32 Inner = Reduce->num_dims-1;
+            usize InnerSize = Reduce->sizes[Inner];
+            if((SrcStride == InnerSize*Reduce->src_strides[Inner]) &&
+               (DestStride == InnerSize*Reduce->dest_strides[Inner]) &&
+               (OtherStride == InnerSize*Reduce->other_strides[Inner])) {
+                Reduce->sizes[Inner] *= Size;
+                continue;
+            }
+        }
+
+        assert(Reduce->num_dims < GZ_BROADCAST_MAX_DIMS, "broadcast reduce supports up to %d dims", GZ_BROADCAST_MAX_DIMS);
+        Reduce->sizes[Reduce->num_dims] = Size;
+        Reduce->src_strides[Reduce->num_dims] = SrcStride;
+        Reduce->dest_strides[Reduce->num_dims] = DestStride;
+        Reduce->other_strides[Reduce->num_dims] = OtherStride;
+        ++Reduce->num_dims;
     }
-internal void 
-__gzBackwardReduceAddBroadcast(t32 *A, t32 *Result) { __GZ_REDUCE_BROADCAST_DIMS(A, Result, +=); }
-internal void 
-__gzBackwardReduceSubBroadcast(t32 *A, t32 *Result) { __GZ_REDUCE_BROADCAST_DIMS(A, Result, -=); }
-#undef __GZ_REDUCE_BROADCAST_DIMS
-
-#define __GZ_BACKWARD_BINARY_MUL(OtherOperand, Parent, ResultOperand, OTHER_OPERAND_DTYPE) \
-    assert(Parent->Header->Dim >= ResultOperand->Header->Dim, "operand tensor dim cannot be higher than parent"); \
-    assert(Parent->Header->Dim >= OtherOperand->Header->Dim, "operand tensor dim cannot be higher than parent"); \
-    \
-    size_t ResultOffset = 0; \
-    size_t ParentOffset = 0; \
-    size_t OtherOperandOffset = 0; \
-    size_t ParentNumData = Parent->Header->StorageNumElements; \
-    for(size_t OpNum = 1; OpNum <= ParentNumData; ++OpNum) { \
-        *((f32 *)ResultOperand->Grad.Ptr + ResultOffset) += *((OTHER_OPERAND_DTYPE *)OtherOperand->Data.Ptr + OtherOperandOffset) * \
-                                                                *((f32 *)Parent->Grad.Ptr + ParentOffset); \
-        i32 DimMaxNumSoFar = 1; \
-        /* NOTE(Abid): If we have reached the end of the current dim in ResultOperand */ \
-        for(i32 DimIdx = 1; DimIdx <= (i32)Parent->Header->Dim; ++DimIdx) { \
-            DimMaxNumSoFar *= Parent->Header->Sizes[Parent->Header->Dim-DimIdx]; \
-            if(OpNum % DimMaxNumSoFar == 0) { \
-                ParentOffset -= Parent->Header->Strides[Parent->Header->Dim-DimIdx] * \
-                                (Parent->Header->Sizes[Parent->Header->Dim-DimIdx]-1); \
-                if((i32)ResultOperand->Header->Dim - DimIdx < 0) ResultOffset = 0; \
-                else ResultOffset -= ResultOperand->Header->Strides[ResultOperand->Header->Dim-DimIdx]* \
-                                     (ResultOperand->Header->Sizes[ResultOperand->Header->Dim-DimIdx]-1); \
-                if((i32)OtherOperand->Header->Dim - DimIdx < 0) OtherOperandOffset = 0; \
-                else OtherOperandOffset -= OtherOperand->Header->Strides[OtherOperand->Header->Dim-DimIdx]* \
-                                           (OtherOperand->Header->Sizes[OtherOperand->Header->Dim-DimIdx]-1); \
-                continue; \
-            } \
-            ParentOffset += Parent->Header->Strides[Parent->Header->Dim-DimIdx]; \
-            if((i32)ResultOperand->Header->Dim - DimIdx >= 0) ResultOffset += ResultOperand->Header->Strides[ResultOperand->Header->Dim-DimIdx]; \
-            if((i32)OtherOperand->Header->Dim - DimIdx >= 0) OtherOperandOffset += OtherOperand->Header->Strides[OtherOperand->Header->Dim-DimIdx]; \
-            break; \
-        } \
+    if(Reduce->num_dims == 0) {
+        Reduce->sizes[0] = 1;
+        Reduce->src_strides[0] = Reduce->dest_strides[0] = Reduce->other_strides[0] = 0;
+        Reduce->num_dims = 1;
     }
-/* TODO(Abid): Doing a backprop on i32 doesn't make sense, this routine should be ammended so
- *             that only f32 remains. */
-internal void 
-__gzBackwardMul(t32 *OtherOperand, t32 *Parent, t32 *ResultOperand) {
-    switch (OtherOperand->Data.DType) {
-        case dtype_f32: { __GZ_BACKWARD_BINARY_MUL(OtherOperand, Parent, ResultOperand, f32); } break;
-        case dtype_i32: { __GZ_BACKWARD_BINARY_MUL(OtherOperand, Parent, ResultOperand, i32); } break;
-    }
-}
-#undef __BACKWARD_BINARY_MUL
-
-#define __GZ_BACKWARD_BINARY_DIV(OtherOperand, Parent, ResultOperand, OTHER_OPERAND_DTYPE) \
-    assert(Parent->Header->Dim >= ResultOperand->Header->Dim, "operand tensor dim cannot be higher than parent"); \
-    assert(Parent->Header->Dim >= OtherOperand->Header->Dim, "operand tensor dim cannot be higher than parent"); \
-    \
-    size_t ResultOffset = 0; \
-    size_t ParentOffset = 0; \
-    size_t OtherOperandOffset = 0; \
-    size_t ParentNumData = Parent->Header->StorageNumElements; \
-    for(size_t OpNum = 1; OpNum <= ParentNumData; ++OpNum) { \
-        f32 ParentGrad = *((f32 *)Parent->Grad.Ptr + ParentOffset); \
-        OTHER_OPERAND_DTYPE OtherOperandData = *((OTHER_OPERAND_DTYPE *)OtherOperand->Data.Ptr + OtherOperandOffset); \
-        __GZ_BACKWARD_BINARY_DIV_OPERAND_OP; \
-        i32 DimMaxNumSoFar = 1; \
-        for(i32 DimIdx = 1; DimIdx <= (i32)Parent->Header->Dim; ++DimIdx) { \
-            DimMaxNumSoFar *= Parent->Header->Sizes[Parent->Header->Dim-DimIdx]; \
-            if(OpNum % DimMaxNumSoFar == 0) { \
-                ParentOffset -= Parent->Header->Strides[Parent->Header->Dim-DimIdx]*(Parent->Header->Sizes[Parent->Header->Dim-DimIdx]-1); \
-                if((i32)ResultOperand->Header->Dim - DimIdx < 0) ResultOffset = 0; \
-                else ResultOffset -= ResultOperand->Header->Strides[ResultOperand->Header->Dim-DimIdx]* \
-                                     (ResultOperand->Header->Sizes[ResultOperand->Header->Dim-DimIdx]-1); \
-                if((i32)OtherOperand->Header->Dim - DimIdx < 0) OtherOperandOffset = 0; \
-                else OtherOperandOffset -= OtherOperand->Header->Strides[OtherOperand->Header->Dim-DimIdx]* \
-                                           (OtherOperand->Header->Sizes[OtherOperand->Header->Dim-DimIdx]-1); \
-                continue; \
-            } \
-            ParentOffset += Parent->Header->Strides[Parent->Header->Dim-DimIdx]; \
-            if((i32)ResultOperand->Header->Dim - DimIdx >= 0) ResultOffset += ResultOperand->Header->Strides[ResultOperand->Header->Dim-DimIdx]; \
-            if((i32)OtherOperand->Header->Dim - DimIdx >= 0) OtherOperandOffset += OtherOperand->Header->Strides[OtherOperand->Header->Dim-DimIdx]; \
-            break; \
+
+    Reduce->src = (f32 *)Parent->Grad.Ptr;
+    Reduce->dest = (f32 *)Dest->Grad.Ptr;
+    Reduce->self = (f32 *)Dest->Data.Ptr;
+    Reduce->other = Other ? (f32 *)Other->Data.Ptr : NULL;
+    Reduce->dest_num_elements = DestHeader->StorageNumElements;
+    Reduce->outer_chunk = 0;
+    Reduce->partials = NULL;
+    Reduce->num_partials = 0;
+}
+
+#define __GZ_BROADCAST_TERM_GRAD(G, O, S) (G)
+#define __GZ_BROADCAST_TERM_GRAD_MUL(G, O, S) ((G)*(O))
+#define __GZ_BROADCAST_TERM_GRAD_DIV(G, O, S) ((G)/(O))
+#define __GZ_BROADCAST_TERM_GRAD_DIV_SELF(G, O, S) ((G)*(O)/((S)*(S)))
+
+/* NOTE(abid): Sums of the reduced case go into separate lanes so the loop vectorizes without having to
+ *             reorder the float adds. */
+#define __GZ_BROADCAST_INNER(TERM) \
+    if(DestStride == 0) { \
+        f32 SelfValue = Self ? Self[0] : 0.f; \
+        (void)SelfValue; \
+        f32 Lanes[GZ_BROADCAST_LANES] = {0}; \
+        usize Idx = 0; \
+        if(SrcStride == 1 && (!Other || OtherStride == 1)) { \
+            for(; Idx + GZ_BROADCAST_LANES <= Count; Idx += GZ_BROADCAST_LANES) \
+                for(u32 Lane = 0; Lane < GZ_BROADCAST_LANES; ++Lane) \
+                    Lanes[Lane] += TERM(Src[Idx+Lane], Other[Idx+Lane], SelfValue); \
         } \
+        for(; Idx < Count; ++Idx) Lanes[0] += TERM(Src[Idx*SrcStride], Other[Idx*OtherStride], SelfValue); \
+        f32 Sum = 0.f; \
+        for(u32 Lane = 0; Lane < GZ_BROADCAST_LANES; ++Lane) Sum += Lanes[Lane]; \
+        Dest[0] += Scale*Sum; \
+    } else if(SrcStride == 1 && DestStride == 1 && (!Other || OtherStride == 1)) { \
+        for(usize Idx = 0; Idx < Count; ++Idx) Dest[Idx] += Scale*TERM(Src[Idx], Other[Idx], Self[Idx]); \
+    } else { \
+        for(usize Idx = 0; Idx < Count; ++Idx) \
+            Dest[Idx*DestStride] += Scale*TERM(Src[Idx*SrcStride], Other[Idx*OtherStride], Self[Idx*DestStride]); \
     }
 
-/* TODO(Abid): Doing a backprop on i32 doesn't make sense, this routine should be ammended so
- *             that only f32 remains. */
-internal void
-__gzBackwardDiv(t32 *OtherOperand, t32 *Parent, t32 *ResultOperand, u32 OperandIdx) {
-    if(OperandIdx == 0) { /* First Operand */
-        #define __GZ_BACKWARD_BINARY_DIV_OPERAND_OP \
-            *((f32 *)ResultOperand->Grad.Ptr + ResultOffset) += (1.f / OtherOperandData) * ParentGrad
-
-        switch (OtherOperand->Data.DType) {
-            case dtype_f32: { __GZ_BACKWARD_BINARY_DIV(OtherOperand, Parent, ResultOperand, f32); } break;
-            case dtype_i32: { __GZ_BACKWARD_BINARY_DIV(OtherOperand, Parent, ResultOperand, i32); } break;
-        }
-        #undef __GZ_BACKWARD_BINARY_DIV_OPERAND_OP
-    } else { /* Second Operand */
-        #define __GZ_BACKWARD_BINARY_DIV_OPERAND_OP \
-            f32 SelfData = *((f32 *)ResultOperand->Data.Ptr + ResultOffset);\
-            *((f32 *)ResultOperand->Grad.Ptr + ResultOffset) += (-OtherOperandData / (SelfData*SelfData)) * ParentGrad
-
-        switch (OtherOperand->Data.DType) {
-            case dtype_f32: { __GZ_BACKWARD_BINARY_DIV(OtherOperand, Parent, ResultOperand, f32); } break;
-            case dtype_i32: { __GZ_BACKWARD_BINARY_DIV(OtherOperand, Parent, ResultOperand, i32); } break;
-        }
-        #undef __GZ_BACKWARD_BINARY_DIV_OPERAND_OP
+internal inline void
+__gzBroadcastReduceInner(broadcast_reduce *Reduce, f32 *DestBase, usize SrcOffset, usize DestOffset,
+                         usize OtherOffset, usize Count) {
+    usize SrcStride = Reduce->src_strides[0];
+    usize DestStride = Reduce->dest_strides[0];
+    usize OtherStride = Reduce->other_strides[0];
+    f32 Scale = Reduce->scale;
+    f32 *Src = Reduce->src + SrcOffset;
+    f32 *Dest = DestBase + DestOffset;
+    f32 *Self = Reduce->self + DestOffset;
+    f32 *Other = Reduce->other ? Reduce->other + OtherOffset : NULL;
+
+    switch(Reduce->term) {
+        case broadcast_term_grad: { __GZ_BROADCAST_INNER(__GZ_BROADCAST_TERM_GRAD); } break;
+        case broadcast_term_grad_mul: { __GZ_BROADCAST_INNER(__GZ_BROADCAST_TERM_GRAD_MUL); } break;
+        case broadcast_term_grad_div: { __GZ_BROADCAST_INNER(__GZ_BROADCAST_TERM_GRAD_DIV); } break;
+        case broadcast_term_grad_div_self: { __GZ_BROADCAST_INNER(__GZ_BROADCAST_TERM_GRAD_DIV_SELF); } break;
     }
 }
-#undef __BACKWARD_BINARY_DIV
-
-internal inline void
-__gzExpandVectorDim(t32 *A, u32 Pos) {
-    assert(A->Header->Dim == 1, "non-vector tensors given");
-    ++A->Header->Dim;
-    A->Header->Sizes[1-Pos] = A->Header->Sizes[0];
-    A->Header->Strides[1-Pos] = A->Header->Strides[0];
-    A->Header->Sizes[Pos] = 1;
-    A->Header->Strides[Pos] = 0;
+#undef __GZ_BROADCAST_INNER
+#undef __GZ_BROADCAST_TERM_GRAD
+#undef __GZ_BROADCAST_TERM_GRAD_MUL
+#undef __GZ_BROADCAST_TERM_GRAD_DIV
+#undef __GZ_BROADCAST_TERM_GRAD_DIV_SELF
+
+/* NOTE(abid): The bias grad, a contiguous (rows, cols) grad summed over its rows. Four rows are added up
+ *             per pass over dest so dest is loaded and stored a quarter as often. */
+internal inline bool
+__gzBroadcastReduceIsRows(broadcast_reduce *Reduce) {
+    return (Reduce->term == broadcast_term_grad) && (Reduce->num_dims == 2) &&
+           (Reduce->src_strides[0] == 1) && (Reduce->dest_strides[0] == 1) &&
+           (Reduce->dest_strides[1] == 0);
 }
 
-internal inline void
-__gzSqueezeMatrixToVectorDim(t32 *A) {
-    assert(A->Header->Dim == 2, "must be matrix (dim==2)");
-    assert((A->Header->Sizes[0] == 1) || (A->Header->Sizes[1] == 1), "at least one dimension size must be 1");
-
-    if(A->Header->Sizes[0] == 1) {
-        A->Header->Sizes[0] = A->Header->Sizes[1];
-        A->Header->Strides[0] = A->Header->Strides[1];
+internal void
+__gzBroadcastReduceRows(broadcast_reduce *Reduce, f32 *Dest, usize RowBegin, usize RowEnd) {
+    usize NumCols = Reduce->sizes[0];
+    usize RowStride = Reduce->src_strides[1];
+    f32 Scale = Reduce->scale;
+
+    usize Row = RowBegin;
+    for(; Row + 4 <= RowEnd; Row += 4) {
+        f32 *Row0 = Reduce->src + Row*RowStride;
+        f32 *Row1 = Row0 + RowStride;
+        f32 *Row2 = Row1 + RowStride;
+        f32 *Row3 = Row2 + RowStride;
+        for(usize Col = 0; Col < NumCols; ++Col)
+            Dest[Col] += Scale*((Row0[Col] + Row1[Col]) + (Row2[Col] + Row3[Col]));
+    }
+    for(; Row < RowEnd; ++Row) {
+        f32 *RowPtr = Reduce->src + Row*RowStride;
+        for(usize Col = 0; Col < NumCols; ++Col) Dest[Col] += Scale*RowPtr[Col];
     }
-    A->Header->Dim = 1;
 }
 
-
-/* TODO(abid): This routine is a travesty of unconscionable magnitude. Must purge before someone sees it.
- * 0_0 - 27.Sep.2024 */
+/* NOTE(abid): Does the part of the reduction with the outermost index in [Begin, End). */
 internal void
-__gzBackwardMatMul(t32 **Operands, t32 *Parent, u32 OperandIdx) {
-    t32 *OtherOperand = Operands[1-OperandIdx];
-    t32 *ResOper = Operands[OperandIdx];
-
-    /* NOTE(Abid): If dim=1, expand by a dim to make it a matrix.
-     *             Ergo, we shall never have a vector (dim != 1) */
-    u32 OrigOperand0Dim = Operands[0]->Header->Dim;
-    u32 OrigOperand1Dim = Operands[1]->Header->Dim;
-    u32 OrigParentDim = Parent->Header->Dim;
-    if(Operands[0]->Header->Dim == 1) {
-        __gzExpandVectorDim(Operands[0], 0);
-        if(Parent->Header->Dim == 1) __gzExpandVectorDim(Parent, 0);
-    }
-    if(Operands[1]->Header->Dim == 1) {
-        __gzExpandVectorDim(Operands[1], 1);
-        if(Parent->Header->Dim == 1) __gzExpandVectorDim(Parent, 1);
-    }
-
-    /* NOTE(Abid): Temporarily transpose the OtherOperand */
-    __gzTransposeInPlaceNoGrad(OtherOperand, OtherOperand->Header->Dim-1, OtherOperand->Header->Dim-2);
-
-    /* NOTE(Abid): Defining the first and second operand, as well as their values based on OperandIdx. */
-    t32 *FirstOper = NULL;
-    void *FirstOperValPtr = NULL;
-    t32 *SecOper = NULL;
-    void *SecOperValPtr = NULL;
-    if(OperandIdx == 1) {
-        FirstOper = OtherOperand;
-        FirstOperValPtr = OtherOperand->Data.Ptr;
-        SecOper = Parent;
-        SecOperValPtr = Parent->Grad.Ptr;
-
-    } else {
-        FirstOper = Parent;
-        FirstOperValPtr = Parent->Grad.Ptr;
-        SecOper = OtherOperand;
-        SecOperValPtr = OtherOperand->Data.Ptr;
-    }
-
-    /* NOTE(Abid): Total number of broadcasts carried out during the forward process. */
-    u32 NumOfBroadcastOps = 1;
-    for(u32 Idx = 2; Idx < Parent->Header->Dim; ++Idx) NumOfBroadcastOps *= GetSizeR(Parent, Idx);
-
-    size_t ResultOffset = 0;
-    size_t FirstOffset = 0;
-    size_t SecondOffset = 0;
-    u32 ReducedDimSize = GetSizeR(FirstOper, 0);
-
-    u32 TotalMatMulOps = NumOfBroadcastOps * GetSizeR(ResOper, 0) * GetSizeR(ResOper, 1);
-    for(size_t OpNum = 1; OpNum <= TotalMatMulOps; ++OpNum) {
-        for(u32 ReduceDimIdx = 0; ReduceDimIdx < ReducedDimSize; ++ReduceDimIdx) {
-            *((f32 *)ResOper->Grad.Ptr + ResultOffset) += *((f32 *)FirstOperValPtr + FirstOffset) *
-                                                          *((f32 *)SecOperValPtr + SecondOffset);
-            FirstOffset += GetStrideR(FirstOper, 0);
-            SecondOffset += GetStrideR(SecOper, 1);
-        }
-        FirstOffset -= GetStrideR(FirstOper, 0) * GetSizeR(FirstOper, 0);
-        SecondOffset -= GetStrideR(SecOper, 1) * GetSizeR(SecOper, 1);
-
-        u32 DimMaxNumSoFar = GetSizeR(ResOper, 0);
-
-        /* NOTE(Abid): In case we've not reached end of dim=1 */
-        if(OpNum % DimMaxNumSoFar != 0) {
-            SecondOffset += GetStrideR(SecOper, 0);
-            ResultOffset += GetStrideR(ResOper, 0);
-            continue;
-        } else {
-            SecondOffset -= GetStrideR(SecOper, 0) * (GetSizeR(SecOper, 0)-1);
-            ResultOffset -= GetStrideR(ResOper, 0) * (GetSizeR(ResOper, 0)-1);
-        }
-        DimMaxNumSoFar *= GetSizeR(ResOper, 1);
+__gzBroadcastReduceBlock(broadcast_reduce *Reduce, f32 *Dest, usize Begin, usize End) {
+    u32 Outer = Reduce->num_dims-1;
+    if(Outer == 0) {
+        __gzBroadcastReduceInner(Reduce, Dest, Begin*Reduce->src_strides[0], Begin*Reduce->dest_strides[0],
+                                 Begin*Reduce->other_strides[0], End-Begin);
+        return;
+    }
+    if(__gzBroadcastReduceIsRows(Reduce)) {
+        __gzBroadcastReduceRows(Reduce, Dest, Begin, End);
+        return;
+    }
 
-        /* NOTE(Abid): In case we've not reached end of dim=2 */
-        if(OpNum % DimMaxNumSoFar != 0) {
-            FirstOffset += GetStrideR(FirstOper, 1);
-            ResultOffset += GetStrideR(ResOper, 1);
-            continue;
-        } else {
-            FirstOffset -= GetStrideR(FirstOper, 1) * (GetSizeR(FirstOper, 1)-1);
-            ResultOffset -= GetStrideR(ResOper, 1) * (GetSizeR(ResOper, 1)-1);
+    for(usize OuterIdx = Begin; OuterIdx < End; ++OuterIdx) {
+        usize Index[GZ_BROADCAST_MAX_DIMS] = {0};
+        usize SrcOffset = OuterIdx*Reduce->src_strides[Outer];
+        usize DestOffset = OuterIdx*Reduce->dest_strides[Outer];
+        usize OtherOffset = OuterIdx*Reduce->other_strides[Outer];
+        for(;;) {
+            __gzBroadcastReduceInner(Reduce, Dest, SrcOffset, DestOffset, OtherOffset, Reduce->sizes[0]);
+
+            u32 DimIdx = 1;
+            for(; DimIdx < Outer; ++DimIdx) {
+                SrcOffset += Reduce->src_strides[DimIdx];
+                DestOffset += Reduce->dest_strides[DimIdx];
+                OtherOffset += Reduce->other_strides[DimIdx];
+                if(++Index[DimIdx] < Reduce->sizes[DimIdx]) break;
+
+                SrcOffset -= Reduce->sizes[DimIdx]*Reduce->src_strides[DimIdx];
+                DestOffset -= Reduce->sizes[DimIdx]*Reduce->dest_strides[DimIdx];
+                OtherOffset -= Reduce->sizes[DimIdx]*Reduce->other_strides[DimIdx];
+                Index[DimIdx] = 0;
+            }
+            if(DimIdx == Outer) break;
         }
+    }
+}
 
-        /* NOTE(Abid): We are in the broadcast dimensions now. Parent tensor is the one with
-         *             the greatest possible dim, therefore, we loop through that */
-        for(u32 DimIdx = 2; DimIdx < Parent->Header->Dim; ++DimIdx) {
-            DimMaxNumSoFar *= GetSizeR(Parent, DimIdx);
+internal void
+__gzBroadcastReduceTask(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    broadcast_reduce *Reduce = (broadcast_reduce *)Data;
+    usize OuterSize = Reduce->sizes[Reduce->num_dims-1];
+    usize Begin = TaskIdx*Reduce->outer_chunk;
+    usize End = (Begin + Reduce->outer_chunk < OuterSize) ? Begin + Reduce->outer_chunk : OuterSize;
+
+    f32 *Dest = Reduce->dest;
+    if(Reduce->partials) {
+        Dest = Reduce->partials + TaskIdx*Reduce->dest_num_elements;
+        memset(Dest, 0, Reduce->dest_num_elements*sizeof(f32));
+    }
+    __gzBroadcastReduceBlock(Reduce, Dest, Begin, End);
+}
 
-            /* NOTE(Abid): Check if we've reached the end of this dim */
-            if(OpNum % DimMaxNumSoFar == 0) {
-                if(ResOper->Header->Dim-DimIdx > 0) {
-                    ResultOffset -= GetStrideR(ResOper, DimIdx) * (GetSizeR(ResOper, DimIdx)-1);
-                } else ResultOffset = 0;
+internal void
+__gzBroadcastReduceCombineTask(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    broadcast_reduce *Reduce = (broadcast_reduce *)Data;
+    usize Begin = TaskIdx*Reduce->outer_chunk;
+    usize End = (Begin + Reduce->outer_chunk < Reduce->dest_num_elements)
+              ? Begin + Reduce->outer_chunk : Reduce->dest_num_elements;
+
+    /* NOTE(abid): Always in task order, so the result does not depend on how the tasks were scheduled. */
+    for(u32 PartialIdx = 0; PartialIdx < Reduce->num_partials; ++PartialIdx) {
+        f32 *Partial = Reduce->partials + PartialIdx*Reduce->dest_num_elements;
+        for(usize Idx = Begin; Idx < End; ++Idx) Reduce->dest[Idx] += Partial[Idx];
+    }
+}
 
-                if(FirstOper->Header->Dim-DimIdx > 0) {
-                    FirstOffset -= GetStrideR(FirstOper, DimIdx) * (GetSizeR(FirstOper, DimIdx)-1);
-                } else FirstOffset = 0;
+/* NOTE(abid): Dest grad += Scale * Term, summed down to the shape of `Dest`. Large reductions are split over
+ *             the outermost dim among the thread pool, the partial sums live in the scratch arena. */
+internal void
+__gzBackwardBroadcast(t32 *Parent, t32 *Dest, t32 *Other, broadcast_term Term, f32 Scale) {
+    broadcast_reduce Reduce;
+    Reduce.term = Term;
+    Reduce.scale = Scale;
+    __gzBroadcastReduceBuild(&Reduce, Parent, Dest, Other);
+
+    u32 Outer = Reduce.num_dims-1;
+    usize OuterSize = Reduce.sizes[Outer];
+    usize TotalElements = 1;
+    for(u32 DimIdx = 0; DimIdx < Reduce.num_dims; ++DimIdx) TotalElements *= Reduce.sizes[DimIdx];
+
+    thread_pool *Pool = (TotalElements >= GZ_BROADCAST_PARALLEL_MIN) ? gz_thread_pool_get() : NULL;
+    u32 NumTasks = Pool ? Pool->num_threads : 1;
+    if(OuterSize < NumTasks) NumTasks = (u32)OuterSize;
+
+    bool IsOuterReduced = (Reduce.dest_strides[Outer] == 0) && (OuterSize > 1);
+    mem_arena *Scratch = NULL;
+    temp_memory Partials = {0};
+    if((NumTasks > 1) && IsOuterReduced) {
+        /* NOTE(abid): Fewer tasks when a copy of dest per thread does not fit, serial if not even two do. */
+        Scratch = gz_thread_scratch_arena();
+        usize PartialBytes = Reduce.dest_num_elements*sizeof(f32);
+        usize FreeBytes = Scratch->Size - Scratch->Used - GZ_BROADCAST_PARTIAL_ALIGNMENT;
+        if(FreeBytes / PartialBytes < NumTasks) NumTasks = (u32)(FreeBytes / PartialBytes);
+
+        if(NumTasks > 1) {
+            Partials = gz_mem_temp_begin(Scratch);
+            gzMemPushSize(Scratch, gzMemAligmentOffset(Scratch, GZ_BROADCAST_PARTIAL_ALIGNMENT));
+            Reduce.partials = gzMemPushArray(Scratch, f32, NumTasks*Reduce.dest_num_elements);
+            Reduce.num_partials = NumTasks;
+        } else Scratch = NULL;
+    }
 
-                if(SecOper->Header->Dim-DimIdx > 0) {
-                    SecondOffset -= GetStrideR(SecOper, DimIdx) * (GetSizeR(SecOper, DimIdx)-1);
-                } else SecondOffset = 0;
-            } else {
-                /* NOTE(Abid): In case we've not reached the end of this dim */
-                if(ResOper->Header->Dim-DimIdx > 0) ResultOffset += GetStrideR(ResOper, DimIdx);
-                else ResultOffset = 0;
+    if(NumTasks <= 1) {
+        __gzBroadcastReduceBlock(&Reduce, Reduce.dest, 0, OuterSize);
+        return;
+    }
 
-                if(FirstOper->Header->Dim-DimIdx > 0) FirstOffset += GetStrideR(FirstOper, DimIdx);
-                else FirstOffset = 0;
+    Reduce.outer_chunk = (OuterSize + NumTasks - 1) / NumTasks;
+    NumTasks = (u32)((OuterSize + Reduce.outer_chunk - 1) / Reduce.outer_chunk);
+    Reduce.num_partials = Reduce.partials ? NumTasks : 0;
+    gz_thread_pool_run(Pool, __gzBroadcastReduceTask, &Reduce, NumTasks);
+
+    if(Scratch) {
+        u32 NumCombineTasks = (Reduce.dest_num_elements >= GZ_BROADCAST_PARALLEL_MIN) ? Pool->num_threads : 1;
+        Reduce.outer_chunk = (Reduce.dest_num_elements + NumCombineTasks - 1) / NumCombineTasks;
+        NumCombineTasks = (u32)((Reduce.dest_num_elements + Reduce.outer_chunk - 1) / Reduce.outer_chunk);
+        gz_thread_pool_run(Pool, __gzBroadcastReduceCombineTask, &Reduce, NumCombineTasks);
+        gz_mem_temp_end(Partials);
+    }
+}
 
-                if(SecOper->Header->Dim-DimIdx > 0) SecondOffset += GetStrideR(SecOper, DimIdx);
-                else SecondOffset = 0;
-                break;
-            }
+/* NOTE(abid): With C = A*B, the grads are dA += dC*B^T and dB += A^T*dC, one GEMM per batch of C. Operands
+ *             that were broadcast map several batches onto the same matrix, which the GEMM accumulates into,
+ *             so the reduction over broadcast dims comes for free. */
+internal void
+__gzBackwardMatMul(t32 **Operands, t32 *Parent, u32 OperandIdx) {
+    t32 *A = Operands[0];
+    t32 *B = Operands[1];
+    matrix_layout ALayout = __gzMatrixLayout(A, 0);
+    matrix_layout BLayout = __gzMatrixLayout(B, 1);
+    matrix_layout CLayout = __gzMatrixLayout(Parent, 0);
+
+    usize NumBatches = 1;
+    for(u32 DimIdx = 2; DimIdx < Parent->Header->Dim; ++DimIdx) NumBatches *= GetSizeR(Parent, DimIdx);
+
+    for(usize BatchIdx = 0; BatchIdx < NumBatches; ++BatchIdx) {
+        usize AOffset = __gzMatMulBatchOffset(A, Parent, BatchIdx);
+        usize BOffset = __gzMatMulBatchOffset(B, Parent, BatchIdx);
+        usize COffset = __gzMatMulBatchOffset(Parent, Parent, BatchIdx);
+        f32 *CGrad = (f32 *)Parent->Grad.Ptr + COffset;
+
+        if(OperandIdx == 0) {
+            gz_gemm_f32(false, true, ALayout.rows, ALayout.cols, CLayout.cols,
+                        CGrad, CLayout.row_stride, CLayout.col_stride,
+                        (f32 *)B->Data.Ptr + BOffset, BLayout.row_stride, BLayout.col_stride,
+                        (f32 *)A->Grad.Ptr + AOffset, ALayout.row_stride, ALayout.col_stride);
+        } else {
+            gz_gemm_f32(true, false, BLayout.rows, BLayout.cols, CLayout.rows,
+                        (f32 *)A->Data.Ptr + AOffset, ALayout.row_stride, ALayout.col_stride,
+                        CGrad, CLayout.row_stride, CLayout.col_stride,
+                        (f32 *)B->Grad.Ptr + BOffset, BLayout.row_stride, BLayout.col_stride);
         }
     }
-
-    /* NOTE(Abid): Reverse the temporary transpose */
-    __gzTransposeInPlaceNoGrad(OtherOperand, OtherOperand->Header->Dim-1, OtherOperand->Header->Dim-2);
-
-    /* NOTE(Abid): Reverse the vector dim expansions */
-    if(Operands[0]->Header->Dim != OrigOperand0Dim) __gzSqueezeMatrixToVectorDim(Operands[0]);
-    if(Operands[1]->Header->Dim != OrigOperand1Dim) __gzSqueezeMatrixToVectorDim(Operands[1]);
-    if(Parent->Header->Dim != OrigParentDim) __gzSqueezeMatrixToVectorDim(Parent);
 }
 
 internal void
@@ -507,13 +662,434 @@ __SqueezeEmptyDims(t32 *A) {
 }
 #endif
 
-/* TODO(Abid): At the current moment, the gradients for the non-leaf tensors are also stored in
- *             within the tensor, which is not good. Ideally, one would want the gradient of
- *             non-leaf tensors to be transient and only used for computing leaf tensor grads.
- *             As a optimization, one could keep track of the memory footprint used to achieve
- *             transient gradient calculation for non-leaf tensors. Then, on the second run, we
- *             can completely forgo any allocation at all. */
-/* TODO(Abid): Have to see if the current routine does adhere to the rules of `topological sort` */
+/* NOTE(abid): Number of operands that receive a grad from the given op. */
+internal inline u32
+__gzNumGradOperands(tensor_op Op) {
+    if(Op > op_unary_begin && Op < op_unary_end) return 1;
+    if(Op > op_binary_begin && Op < op_binary_end) return 2;
+    /* NOTE(abid): Losses only pass the grad to the prediction, the target is taken as constant. */
+    if(Op > op_loss_begin && Op < op_loss_end) return 1;
+    return 0;
+}
+
+/* NOTE(abid): Called once the backward of `Tensor` is done with all of its operands. The backward of one operand
+ *             may read the data of the other, e.g. a matmul, so a leaf is only done once every op on it (or on a
+ *             view of it) is done, not when its last grad comes in. Only then may its hook change its data. */
+internal inline void
+__gzBackwardReadersDone(t32 *Tensor, bool IsConcurrent) {
+    u32 NumOperands = __gzNumGradOperands(Tensor->Header->DerivedOp.TensorOp);
+    for(u32 Idx = 0; Idx < NumOperands; ++Idx) {
+        t32 *Operand = Tensor->Header->DerivedOp.Operands[Idx];
+        if(!__gzNeedsGrad(Operand)) continue;
+        t32 *Owner = __gzGradOwner(Operand);
+        if(!__gzIsLeaf(Owner)) continue;
+        u32 *Readers = &Owner->Header->BackwardReaders;
+        u32 PrevReaders = IsConcurrent ? gz_atomic_add_u32(Readers, (u32)-1) : (*Readers)--;
+        assert(PrevReaders > 0, "leaf is read by more backward ops than were counted");
+        if(PrevReaders == 1) __gzLeafGradFinal(Owner);
+    }
+}
+
+/* NOTE(abid): Recursive through checkpoints, see `__gzBackwardCheckpoint`. */
+internal void __gzBackpropGraph(stack_blocks_state *StackState, t32 **Roots, f32 *Weights, u32 NumRoots, f32 *SeedGrad);
+
+/* NOTE(abid): Rebuilds the graph of the segment on the arena's free space and backprops through it with
+ *             the grad of the checkpoint as the seed. The segment input is cut off as a leaf that shares the
+ *             grad of `A`, so nothing beyond the segment is walked twice. All of it is gone afterwards. */
+internal void
+__gzBackwardCheckpoint(t32 *A, t32 *Result, stack_blocks_state *StackState) {
+    checkpoint_info *Info = (checkpoint_info *)Result->Header->DerivedOp.op_context;
+    temp_memory Recompute = gz_mem_temp_begin(Info->arena);
+
+    /* NOTE(abid): The recomputed tensors are not part of any memory plan, and they must record their ops. */
+    mem_plan *Plan = __gzGLOBALMemPlan;
+    __gzGLOBALMemPlan = NULL;
+    bool PrevGradState = IS_GRAD_PRESERVE();
+    GRAD_PRESERVE(true);
+
+    t32 *Input = gz_tensor_detach(A, Info->arena);
+    t32 *Output = Info->forward(Info->context, Input, Info->arena);
+    assert(gzIsShapeEqual(Output->Header, Result->Header), "recomputed checkpoint does not match its forward");
+    if(Output->Header->ShouldGrad) __gzBackpropGraph(StackState, &Output, NULL, 1, (f32 *)Result->Grad.Ptr);
+
+    GRAD_PRESERVE(PrevGradState);
+    __gzGLOBALMemPlan = Plan;
+    gz_mem_temp_end(Recompute);
+}
+
+/* NOTE(abid): Ops whose backward runs once for the node instead of once per operand, whether or not the
+ *             operand needs a grad. A checkpoint recomputes its segment, and the parameters in there need
+ *             their grads even when the segment input (e.g. a batch of data) does not. */
+internal inline bool
+__gzIsNodeBackward(tensor_op Op) { return Op == op_unary_checkpoint; }
+
+/* NOTE(abid): Passes the grad of `CurrentTensor` down to one of its operands. The operand must have a grad
+ *             to accumulate into, except for views which may hand their own grad over. */
+internal void
+__gzBackwardOperand(t32 *CurrentTensor, u32 OperandIdx) {
+    t32 **Operands = CurrentTensor->Header->DerivedOp.Operands;
+    t32 *Operand = Operands[OperandIdx];
+
+    switch (CurrentTensor->Header->DerivedOp.TensorOp) {
+        case op_unary_negate: {
+        } break;
+        case op_unary_broadcast: {
+        } break;
+        case op_unary_tranpose: {
+        } break;
+        case op_unary_tranpose_all: {
+        } break;
+        case op_unary_reduce_sum_all: {
+            __gzBackwardAddToElements(Operand, *(f32 *)CurrentTensor->Grad.Ptr);
+        } break;
+        case op_unary_sigmoid: {
+            __gzBackwardSigmoid(Operand, CurrentTensor);
+        } break;
+        case op_unary_relu: {
+            __gzBackwardReLU(Operand, CurrentTensor);
+        } break;
+        case op_unary_view: {
+            /* NOTE(abid): A view of a leaf shares its grad storage, so there is nothing to pass. Otherwise,
+             *             if the operand has no grad yet, the buffer is simply handed over. */
+            if(Operand->Grad.Ptr == CurrentTensor->Grad.Ptr) break;
+            if(!Operand->Grad.Ptr) {
+                Operand->Grad.Ptr = CurrentTensor->Grad.Ptr;
+                Operand->Header->IsGradTransient = CurrentTensor->Header->IsGradTransient;
+                CurrentTensor->Grad.Ptr = NULL;
+                CurrentTensor->Header->IsGradTransient = false;
+            } else {
+                f32 *SrcGrad = (f32 *)CurrentTensor->Grad.Ptr;
+                f32 *DestGrad = (f32 *)Operand->Grad.Ptr;
+                for(usize Idx = 0; Idx < Operand->Header->StorageNumElements; ++Idx) DestGrad[Idx] += SrcGrad[Idx];
+            }
+        } break;
+        case op_binary_add: {
+            __gzBackwardBroadcast(CurrentTensor, Operand, NULL, broadcast_term_grad, 1.f);
+        } break;
+        case op_binary_sub: {
+            __gzBackwardBroadcast(CurrentTensor, Operand, NULL, broadcast_term_grad, OperandIdx ? -1.f : 1.f);
+        } break;
+        case op_binary_mul: {
+            __gzBackwardBroadcast(CurrentTensor, Operand, Operands[1-OperandIdx], broadcast_term_grad_mul, 1.f);
+        } break;
+        case op_binary_div: {
+            if(OperandIdx == 0) __gzBackwardBroadcast(CurrentTensor, Operand, Operands[1], broadcast_term_grad_div, 1.f);
+            else __gzBackwardBroadcast(CurrentTensor, Operand, Operands[0], broadcast_term_grad_div_self, -1.f);
+        } break;
+        case op_binary_matmul: {
+            __gzBackwardMatMul(Operands, CurrentTensor, OperandIdx);
+        } break;
+        case op_binary_loss_cross_entropy: {
+            reduce_method method = *(reduce_method *)CurrentTensor->Header->DerivedOp.op_context;
+            __gz_backward_loss_binary_cross_entropy(Operand, Operands[1], CurrentTensor, method);
+        } break;
+        default: assert(0, "invalid code path");
+    }
+}
+
+internal inline void
+__gzBackwardCheckTypes(t32 *CurrentTensor) {
+    tensor_op CurrentOp = CurrentTensor->Header->DerivedOp.TensorOp;
+    t32 **Operands = CurrentTensor->Header->DerivedOp.Operands;
+    assert(Operands, "tensor op set without operand(s)");
+    assert(CurrentTensor->Data.DType == dtype_f32, "cannot backpropagate through a non-float tensor")
+    assert(Operands[0]->Data.DType == dtype_f32, "cannot backpropagate through a non-float tensor")
+    assert((CurrentOp > op_unary_end  && Operands[1]->Data.DType == dtype_f32) ||
+           CurrentOp < op_unary_end, "cannot backpropagate through a non-float tensor")
+}
+
+/* NOTE(abid): Queues a task for every operand of a tensor whose grad is final. Called with the schedule
+ *             locked. A tensor with nothing to pass its grad to is done right away. */
+internal void
+__gzBackpropPushNode(backward_schedule *Schedule, t32 *Tensor) {
+    tensor_op Op = Tensor->Header->DerivedOp.TensorOp;
+    __gzBackwardCheckTypes(Tensor);
+    assert(!__gzIsNodeBackward(Op), "graphs with checkpoints only run serially");
+    backward_node *Node = Schedule->nodes + Schedule->num_nodes++;
+    Node->tensor = Tensor;
+    Node->num_pending = 0;
+    for(u32 Idx = 0; Idx < __gzNumGradOperands(Op); ++Idx) {
+        if(!__gzNeedsGrad(Tensor->Header->DerivedOp.Operands[Idx])) continue;
+        backward_task Task = { Node, Idx };
+        Schedule->ready[Schedule->num_ready++] = Task;
+        ++Node->num_pending;
+    }
+
+    if(Node->num_pending) __gz_thread_wake_all(Schedule, work_ready);
+    else {
+        __gzReleaseGrad(Tensor);
+        if(--Schedule->num_remaining == 0) __gz_thread_wake_all(Schedule, work_ready);
+    }
+}
+
+/* NOTE(abid): Parallel backprop, one of the tasks of `gz_thread_pool_run`. Every thread takes operands off the
+ *             ready stack until all tensors are done, waiting while another thread is still working on the
+ *             operands that would make new ones ready. */
+internal void
+__gzBackpropParallelTask(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)TaskIdx; (void)ThreadIdx;
+    backward_schedule *Schedule = (backward_schedule *)Data;
+
+    __gz_thread_lock(Schedule);
+    for(;;) {
+        while(!Schedule->num_ready && Schedule->num_remaining) __gz_thread_wait(Schedule, work_ready);
+        if(!Schedule->num_remaining) break;
+        backward_task Task = Schedule->ready[--Schedule->num_ready];
+        __gz_thread_unlock(Schedule);
+
+        backward_node *Node = Task.node;
+        t32 *CurrentTensor = Node->tensor;
+        t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[Task.operand_idx];
+        /* NOTE(abid): Locked on the owner of the grad, a view of a leaf and the leaf write to the same one. */
+        t32 *GradOwner = __gzGradOwner(Operand);
+        gz_spin_lock(&GradOwner->Header->BackwardLock);
+        if(CurrentTensor->Header->DerivedOp.TensorOp != op_unary_view) __gzEnsureGrad(Operand);
+        __gzBackwardOperand(CurrentTensor, Task.operand_idx);
+        assert(Operand->Header->BackwardRefCount > 0, "tensor received more grads than it has consumers");
+        bool IsFinal = (--Operand->Header->BackwardRefCount == 0);
+        bool IsReady = IsFinal && !__gzIsLeaf(Operand);
+        gz_spin_unlock(&GradOwner->Header->BackwardLock);
+
+        bool IsNodeDone = (gz_atomic_add_u32(&Node->num_pending, (u32)-1) == 1);
+        if(IsNodeDone) __gzBackwardReadersDone(CurrentTensor, true);
+
+        __gz_thread_lock(Schedule);
+        if(IsReady) __gzBackpropPushNode(Schedule, Operand);
+        if(IsNodeDone) {
+            __gzReleaseGrad(CurrentTensor);
+            if(--Schedule->num_remaining == 0) __gz_thread_wake_all(Schedule, work_ready);
+        }
+    }
+    __gz_thread_unlock(Schedule);
+}
+
+/* NOTE(abid): Deterministic backprop, one task per operand of the wave. The edges into the operand are run
+ *             in the order they were found in, so the sum comes out the same no matter the scheduling. */
+internal void
+__gzBackpropWaveTask(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    backward_schedule *Schedule = (backward_schedule *)Data;
+    for(u32 EdgeIdx = Schedule->group_begins[TaskIdx]; EdgeIdx < Schedule->group_begins[TaskIdx+1]; ++EdgeIdx) {
+        backward_edge *Edge = Schedule->edges + EdgeIdx;
+        __gzBackwardOperand(Edge->tensor, Edge->operand_idx);
+    }
+}
+
+internal int
+__gzBackwardEdgeCompare(const void *A, const void *B) {
+    backward_edge *EdgeA = (backward_edge *)A;
+    backward_edge *EdgeB = (backward_edge *)B;
+    if(EdgeA->operand != EdgeB->operand) return ((uintptr)EdgeA->operand < (uintptr)EdgeB->operand) ? -1 : 1;
+    return (EdgeA->order < EdgeB->order) ? -1 : (EdgeA->order > EdgeB->order);
+}
+
+internal inline bool
+__gzIsRepeatedRoot(t32 **Roots, u32 RootIdx) {
+    for(u32 Idx = 0; Idx < RootIdx; ++Idx) if(Roots[Idx] == Roots[RootIdx]) return true;
+    return false;
+}
+
+/* NOTE(abid): A root starts off ready unless another root consumes it, repeated roots only count once. */
+internal inline bool
+__gzIsRootReady(t32 **Roots, u32 RootIdx) {
+    t32 *Root = Roots[RootIdx];
+    return !__gzIsLeaf(Root) && !Root->Header->BackwardRefCount && !__gzIsRepeatedRoot(Roots, RootIdx);
+}
+
+/* NOTE(abid): Runs the counted graph of `Roots` on the thread pool, `NumNodes` is the number of tensors
+ *             in it that pass a grad down. */
+internal void
+__gzBackpropParallel(t32 **Roots, u32 NumRoots, u32 NumNodes, backprop_mode Mode) {
+    thread_pool *Pool = gz_thread_pool_get();
+    mem_arena *Scratch = gz_thread_scratch_arena();
+    temp_memory ScheduleMemory = gz_mem_temp_begin(Scratch);
+
+    backward_schedule Schedule = {0};
+#ifdef GRAZIE_PLT_WIN
+    InitializeCriticalSection(&Schedule.lock);
+    InitializeConditionVariable(&Schedule.work_ready);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_mutex_init(&Schedule.lock, NULL);
+    pthread_cond_init(&Schedule.work_ready, NULL);
+#endif
+
+    if(Mode == backprop_parallel) {
+        Schedule.ready = gzMemPushArray(Scratch, backward_task, 2*NumNodes);
+        Schedule.nodes = gzMemPushArray(Scratch, backward_node, NumNodes);
+        Schedule.num_remaining = NumNodes;
+        for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx) if(__gzIsRootReady(Roots, RootIdx))
+            __gzBackpropPushNode(&Schedule, Roots[RootIdx]);
+        if(Schedule.num_remaining) gz_thread_pool_run(Pool, __gzBackpropParallelTask, &Schedule, Pool->num_threads);
+    } else {
+        t32 **Wave = gzMemPushArray(Scratch, t32 *, NumNodes);
+        t32 **NextWave = gzMemPushArray(Scratch, t32 *, NumNodes);
+        Schedule.edges = gzMemPushArray(Scratch, backward_edge, 2*NumNodes);
+        Schedule.group_begins = gzMemPushArray(Scratch, u32, 2*NumNodes+1);
+        u32 WaveLength = 0;
+        for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx) if(__gzIsRootReady(Roots, RootIdx))
+            Wave[WaveLength++] = Roots[RootIdx];
+
+        while(WaveLength) {
+            /* NOTE(abid): Grads are taken from the pool up front, the tasks only accumulate. */
+            u32 NumEdges = 0;
+            for(u32 NodeIdx = 0; NodeIdx < WaveLength; ++NodeIdx) {
+                t32 *CurrentTensor = Wave[NodeIdx];
+                tensor_op CurrentOp = CurrentTensor->Header->DerivedOp.TensorOp;
+                __gzBackwardCheckTypes(CurrentTensor);
+                assert(!__gzIsNodeBackward(CurrentOp), "graphs with checkpoints only run serially");
+                for(u32 Idx = 0; Idx < __gzNumGradOperands(CurrentOp); ++Idx) {
+                    t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[Idx];
+                    if(!__gzNeedsGrad(Operand)) continue;
+                    if(CurrentOp != op_unary_view) __gzEnsureGrad(Operand);
+                    backward_edge Edge = { CurrentTensor, __gzGradOwner(Operand), Idx, NumEdges };
+                    Schedule.edges[NumEdges++] = Edge;
+                }
+            }
+
+            qsort(Schedule.edges, NumEdges, sizeof(backward_edge), __gzBackwardEdgeCompare);
+            Schedule.num_groups = 0;
+            for(u32 EdgeIdx = 0; EdgeIdx < NumEdges; ++EdgeIdx) {
+                if(EdgeIdx && (Schedule.edges[EdgeIdx].operand == Schedule.edges[EdgeIdx-1].operand)) continue;
+                Schedule.group_begins[Schedule.num_groups++] = EdgeIdx;
+            }
+            Schedule.group_begins[Schedule.num_groups] = NumEdges;
+            gz_thread_pool_run(Pool, __gzBackpropWaveTask, &Schedule, Schedule.num_groups);
+
+            /* NOTE(abid): The next wave, in the order of the current one. */
+            u32 NextWaveLength = 0;
+            for(u32 NodeIdx = 0; NodeIdx < WaveLength; ++NodeIdx) {
+                t32 *CurrentTensor = Wave[NodeIdx];
+                u32 NumOperands = __gzNumGradOperands(CurrentTensor->Header->DerivedOp.TensorOp);
+                for(u32 Idx = 0; Idx < NumOperands; ++Idx) {
+                    t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[Idx];
+                    if(!__gzNeedsGrad(Operand)) continue;
+                    assert(Operand->Header->BackwardRefCount > 0, "tensor received more grads than it has consumers");
+                    if(--Operand->Header->BackwardRefCount) continue;
+                    if(!__gzIsLeaf(Operand)) NextWave[NextWaveLength++] = Operand;
+                }
+                __gzBackwardReadersDone(CurrentTensor, false);
+                __gzReleaseGrad(CurrentTensor);
+            }
+
+            t32 **Temp = Wave;
+            Wave = NextWave;
+            NextWave = Temp;
+            WaveLength = NextWaveLength;
+        }
+    }
+
+#ifdef GRAZIE_PLT_WIN
+    DeleteCriticalSection(&Schedule.lock);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_cond_destroy(&Schedule.work_ready);
+    pthread_mutex_destroy(&Schedule.lock);
+#endif
+    gz_mem_temp_end(ScheduleMemory);
+}
+
+/* NOTE(abid): Walks the union of the graphs of `Roots` on top of whatever is already on the stack, and stops
+ *             once it is back to where it started. This way a backward op can run a backprop of its own,
+ *             e.g. a checkpoint that recomputes its segment. Every root is seeded with its weight (one
+ *             without `Weights`), or, for a single root, `SeedGrad` is taken as its grad. Roots may be part
+ *             of the graph of another root, they get their seed on top of what their consumers pass down. */
+internal void
+__gzBackpropGraph(stack_blocks_state *StackState, t32 **Roots, f32 *Weights, u32 NumRoots, f32 *SeedGrad) {
+    size_t BaseTensorNum = StackState->RunningTensorNum;
+    assert(!SeedGrad || (NumRoots == 1), "seed grad can only be given for a single root");
+
+    /* NOTE(abid): First walk, count the consumers of every tensor in the graph. Roots start out with a count
+     *             of one so that they are not descended into again when another root reaches them. */
+    u32 NumNodes = 0;
+    bool HasCheckpoint = false;
+    for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx) {
+        assert(Roots[RootIdx]->Header->ShouldGrad, "root tensor grad is not tracked");
+        if(__gzIsRepeatedRoot(Roots, RootIdx)) continue;
+        Roots[RootIdx]->Header->BackwardRefCount = 1;
+        gzStackBlockPush(StackState, Roots[RootIdx]);
+    }
+    while(StackState->RunningTensorNum > BaseTensorNum) {
+        t32 *CurrentTensor = gzStackBlockTop(StackState);
+        gzStackBlockPop(StackState);
+        if(__gzIsLeaf(CurrentTensor)) continue;
+        ++NumNodes;
+        if(CurrentTensor->Header->DerivedOp.TensorOp == op_unary_checkpoint) HasCheckpoint = true;
+
+        u32 NumOperands = __gzNumGradOperands(CurrentTensor->Header->DerivedOp.TensorOp);
+        for(u32 Idx = 0; Idx < NumOperands; ++Idx) {
+            t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[Idx];
+            if(!__gzNeedsGrad(Operand)) continue;
+            t32 *Owner = __gzGradOwner(Operand);
+            if(__gzIsLeaf(Owner)) ++Owner->Header->BackwardReaders;
+            /* NOTE(abid): Only descend the first time we see the tensor. */
+            if(Operand->Header->BackwardRefCount++ == 0 && !__gzIsLeaf(Operand))
+                gzStackBlockPush(StackState, Operand);
+        }
+    }
+    for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx)
+        if(!__gzIsRepeatedRoot(Roots, RootIdx)) --Roots[RootIdx]->Header->BackwardRefCount;
+
+    if(SeedGrad) {
+        /* NOTE(abid): The seed belongs to the caller, so it is not given back to the pool. */
+        t32 *RootTensor = Roots[0];
+        assert(!RootTensor->Grad.Ptr, "seeded root tensor already has a grad");
+        RootTensor->Grad.Ptr = SeedGrad;
+        RootTensor->Header->IsGradTransient = false;
+    } else {
+        for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx) {
+            __gzEnsureGrad(Roots[RootIdx]);
+            __gzBackwardAddToElements(Roots[RootIdx], Weights ? Weights[RootIdx] : 1.f);
+        }
+    }
+
+    /* NOTE(abid): Checkpoints recompute on a shared arena and backprop through the segment on the stack of this
+     *             walk, and memory plans depend on the serial order. This holds for every mode. */
+    backprop_mode Mode = __gzGLOBALBackpropMode;
+    if(HasCheckpoint || __gzGLOBALMemPlan || (NumNodes < GZ_BACKPROP_PARALLEL_MIN_NODES) ||
+       (gz_thread_pool_num_threads() == 1)) Mode = backprop_serial;
+    if(Mode != backprop_serial) {
+        __gzBackpropParallel(Roots, NumRoots, NumNodes, Mode);
+        return;
+    }
+
+    /* NOTE(Abid): Backpropagation logic starts here */
+    for(u32 RootIdx = 0; RootIdx < NumRoots; ++RootIdx) if(__gzIsRootReady(Roots, RootIdx))
+        gzStackBlockPush(StackState, Roots[RootIdx]);
+
+    while(StackState->RunningTensorNum > BaseTensorNum) {
+        t32 *CurrentTensor = gzStackBlockTop(StackState);
+        tensor_op CurrentOp = CurrentTensor->Header->DerivedOp.TensorOp;
+        gzStackBlockPop(StackState);
+        if(!CurrentTensor->Header->ShouldGrad || CurrentOp == op_none) continue;
+
+        __gzBackwardCheckTypes(CurrentTensor);
+        t32 **Operands = CurrentTensor->Header->DerivedOp.Operands;
+        u32 NumOperands = __gzNumGradOperands(CurrentOp);
+        bool NeedsGrad[2] = { __gzNeedsGrad(Operands[0]), (NumOperands > 1) && __gzNeedsGrad(Operands[1]) };
+        for(u32 Idx = 0; Idx < NumOperands; ++Idx) if(NeedsGrad[Idx] && (CurrentOp != op_unary_view))
+            __gzEnsureGrad(Operands[Idx]);
+
+        if(__gzIsNodeBackward(CurrentOp)) __gzBackwardCheckpoint(Operands[0], CurrentTensor, StackState);
+        else for(u32 Idx = 0; Idx < NumOperands; ++Idx) if(NeedsGrad[Idx]) __gzBackwardOperand(CurrentTensor, Idx);
+
+        /* NOTE(abid): The grad has been passed down, a non-leaf does not need it anymore. */
+        __gzReleaseGrad(CurrentTensor);
+
+        /* NOTE(abid): Operands that got the grad from all of their consumers are ready to be visited. */
+        for(u32 Idx = 0; Idx < NumOperands; ++Idx) {
+            if(!NeedsGrad[Idx]) continue;
+            t32 *Operand = Operands[Idx];
+            assert(Operand->Header->BackwardRefCount > 0, "tensor received more grads than it has consumers");
+            if(--Operand->Header->BackwardRefCount) continue;
+            if(!__gzIsLeaf(Operand)) gzStackBlockPush(StackState, Operand);
+        }
+        __gzBackwardReadersDone(CurrentTensor, false);
+    }
+}
+
+internal void
+gz_backprop_set_mode(backprop_mode Mode) { __gzGLOBALBackpropMode = Mode; }
 
 /* NOTE(Abid): If for a differentiable operation, one of the operands is also the result tensor,
  *             then we have nasty infinite loop on our hands.
@@ -524,7 +1100,7 @@ __SqueezeEmptyDims(t32 *A) {
  *             The nice thing is, once you build it then you don't have to save operands when 
  *             you do operations on tensor, since we don't have to worry about that anymore. */
 internal void
-gz_backprop(t32 *RootTensor) {
+gz_backprop_many(t32 **Roots, f32 *Weights, u32 NumRoots) {
     /* NOTE(Abid): Here's how `gzBackprop` works:
      * - The function will loop through the computation tree and calculate the gradient.
      *   That means it will not be recursive (at least for now).
@@ -546,152 +1122,83 @@ gz_backprop(t32 *RootTensor) {
      *   different then the whole set of local_persist variables are set to their
      *   defaults, as we expect to be in the 1st run of a new chain of backward
      *   computations.
+     *
+     * - The graph is walked twice. The first walk counts, for every tensor, how many
+     *   consumers will pass a grad down to it (`BackwardRefCount`). The second walk
+     *   only visits a tensor once all of its consumers are done, so its grad is final
+     *   by then. Right after it has passed the grad to its operands, a non-leaf grad
+     *   is given back to the grad pool, i.e. only leaves keep a grad after the call.
+     *
+     * - With several roots, e.g. the losses of a multi-task model, all of them are
+     *   seeded with their weight (one if `Weights` is NULL) and the union of their
+     *   graphs is walked once, so a shared trunk is differentiated a single time.
+     *   The stack is kept for as long as the first root stays the same.
      */
 
-    local_persist t32 *PrevRootTensor = {0};
-    local_persist stack_blocks_state StackState = {0};
+    stack_blocks_state *StackState = &__gzGLOBALBackpropStack;
 
-    assert(RootTensor->Header && RootTensor->Grad.Ptr, "root tensor grad is not tracked");
+    assert(NumRoots > 0, "backprop needs at least one root tensor");
+    /* TODO(abid): The memory planner simulates the backprop of a single root. */
+    assert(!__gzGLOBALMemPlan || (NumRoots == 1), "memory plans only support a single root tensor");
+    t32 *RootTensor = Roots[0];
 
     /* NOTE(Abid): If the below condition doesn't hit, then we are in the nth step of the same computation chain. */
-    if((PrevRootTensor != RootTensor) || (PrevRootTensor->Grad.Ptr != RootTensor->Grad.Ptr)) {
+    if(__gzGLOBALBackpropRoot != RootTensor) {
         /* NOTE(Abid): Its the first run of a new computation chain. */
-        if(PrevRootTensor && PrevRootTensor->Grad.Ptr) {
-            while(StackState.CurrentBlock) {
-                stack_block *NextBlock = StackState.CurrentBlock->BelowBlock;
-                Free(StackState.CurrentBlock); 
-                StackState.CurrentBlock = NextBlock;
+        if(__gzGLOBALBackpropRoot) {
+            while(StackState->CurrentBlock) {
+                stack_block *NextBlock = StackState->CurrentBlock->BelowBlock;
+                Free(StackState->CurrentBlock); 
+                StackState->CurrentBlock = NextBlock;
             }
 
             /* NOTE(Abid): Free the reserved block from previous runs */
-            Free(StackState.ReservedBlock);
-            StackState.ReservedBlock = NULL;
+            Free(StackState->ReservedBlock);
+            StackState->ReservedBlock = NULL;
 
         }
 
         /* NOTE(Abid): This will be the same whether this is the first call of the routine
          *             or we have a new computation chain. */
-        StackState.CurrentBlockTopIdx = (size_t)-1;
-        StackState.GlobalMaxTensorNum = 0;
-        StackState.RunningTensorNum = 0;
-        StackState.NewAllocTensorNum = 5;
+        StackState->CurrentBlockTopIdx = (size_t)-1;
+        StackState->GlobalMaxTensorNum = 0;
+        StackState->RunningTensorNum = 0;
+        StackState->NewAllocTensorNum = 5;
 
-        StackState.CurrentBlock = gzAllocNewStackBlock(StackState.NewAllocTensorNum, NULL);
+        StackState->CurrentBlock = gzAllocNewStackBlock(StackState->NewAllocTensorNum, NULL);
     }
 
-    __gzBackwardAddToElements(RootTensor, 1.f);
+    __gzBackpropGraph(StackState, Roots, Weights, NumRoots, NULL);
 
-    /* NOTE(Abid): Backpropagation logic starts here */
-    gzStackBlockPush(&StackState, RootTensor);
-
-    while(!gzIsStackBlocksEmpty(&StackState)) {
-        t32 *CurrentTensor = gzStackBlockTop(&StackState);
-        tensor_op CurrentOp = CurrentTensor->Header->DerivedOp.TensorOp;
-        gzStackBlockPop(&StackState);
-        if(!CurrentTensor->Header->ShouldGrad || CurrentOp == op_none) continue;
-
-        assert(CurrentTensor->Header->DerivedOp.Operands, "tensor op set without operand(s)");
-        assert(CurrentTensor->Header->DerivedOp.Operands+1, "tensor op set without operand(s)");
-        t32 *Operands[2];
-        Operands[0] = CurrentTensor->Header->DerivedOp.Operands[0];
-        Operands[1] = CurrentTensor->Header->DerivedOp.Operands[1];
-
-        /* assert((CurrentOp > op_binary_begin && CurrentOp < op_binary_end) ? Operands[1]->Grad.Ptr && Operands[0]->Grad.Ptr
-                                                                          : Operands[0]->Grad.Ptr,
-               "grad storage not found"); */
-        assert(CurrentTensor->Data.DType == dtype_f32, "cannot backpropagate through a non-float tensor")
-        assert(Operands[0]->Data.DType == dtype_f32, "cannot backpropagate through a non-float tensor")
-        assert((CurrentOp > op_unary_end  && Operands[1]->Data.DType == dtype_f32) ||
-               CurrentOp < op_unary_end, "cannot backpropagate through a non-float tensor")
-
-        switch (CurrentOp) {
-            case op_unary_negate: {
-            } break;
-            case op_unary_broadcast: {
-            } break;
-            case op_unary_tranpose: {
-            } break;
-            case op_unary_tranpose_all: {
-            } break;
-            case op_unary_reduce_sum_all: {
-                t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[0];
-                gzStackBlockPush(&StackState, Operand);
-
-                __gzBackwardAddToElements(Operand, *(f32 *)CurrentTensor->Grad.Ptr);
-            } break;
-            case op_unary_sigmoid: {
-                t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[0];
-                gzStackBlockPush(&StackState, Operand);
-
-                __gzBackwardSigmoid(Operand, CurrentTensor);
-            } break;
-            case op_unary_relu: {
-                t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[0];
-                gzStackBlockPush(&StackState, Operand);
-
-                __gzBackwardReLU(Operand, CurrentTensor);
-            } break;
-            case op_unary_view: {
-                t32 *Operand = CurrentTensor->Header->DerivedOp.Operands[0];
-                gzStackBlockPush(&StackState, Operand);
-            } break;
-            case op_binary_add: {
-                gzStackBlockPush(&StackState, Operands[1]);
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                __gzBackwardReduceAddBroadcast(CurrentTensor, Operands[0]);
-                __gzBackwardReduceAddBroadcast(CurrentTensor, Operands[1]);
-            } break;
-            case op_binary_sub: {
-                gzStackBlockPush(&StackState, Operands[1]);
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                __gzBackwardReduceAddBroadcast(CurrentTensor, Operands[0]);
-                __gzBackwardReduceSubBroadcast(CurrentTensor, Operands[1]);
-            } break;
-            case op_binary_mul: {
-                gzStackBlockPush(&StackState, Operands[1]);
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                __gzBackwardMul(Operands[1], CurrentTensor, Operands[0]);
-                __gzBackwardMul(Operands[0], CurrentTensor, Operands[1]);
-            } break;
-            case op_binary_div: {
-                gzStackBlockPush(&StackState, Operands[1]);
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                __gzBackwardDiv(Operands[1], CurrentTensor, Operands[0], 0);
-                __gzBackwardDiv(Operands[0], CurrentTensor, Operands[1], 1);
-            } break;
-            case op_binary_matmul: {
-                gzStackBlockPush(&StackState, Operands[1]);
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                __gzBackwardMatMul(Operands, CurrentTensor, 0);
-                __gzBackwardMatMul(Operands, CurrentTensor, 1);
-            } break;
-            case op_binary_loss_cross_entropy: {
-                gzStackBlockPush(&StackState, Operands[0]);
-
-                reduce_method method = *(reduce_method *)CurrentTensor->Header->DerivedOp.op_context;
-                __gz_backward_loss_binary_cross_entropy(Operands[0], Operands[1], CurrentTensor, method);
-            } break;
-            default: assert(0, "invalid code path");
-        }
-    }
-
-    assert(!StackState.CurrentBlock, "oops, we should not have current block at the end");
+    assert(!StackState->CurrentBlock, "oops, we should not have current block at the end");
 
     /* NOTE(Abid): Check if our maximum required stack size exceeded the reserved blocks's size, which means we haven't
      *             caliberated the optimal size. Should only happen if new chain is introduced or on the first run. */
-    assert(StackState.ReservedBlock, "reserved block should've been here! Gary, who took the block, man?");
-    if(StackState.GlobalMaxTensorNum > StackState.ReservedBlock->MaxNumTen) {
-        Free(StackState.ReservedBlock); 
-        StackState.ReservedBlock = gzAllocNewStackBlock(StackState.GlobalMaxTensorNum, NULL);
+    assert(StackState->ReservedBlock, "reserved block should've been here! Gary, who took the block, man?");
+    if(StackState->GlobalMaxTensorNum > StackState->ReservedBlock->MaxNumTen) {
+        Free(StackState->ReservedBlock); 
+        StackState->ReservedBlock = gzAllocNewStackBlock(StackState->GlobalMaxTensorNum, NULL);
     }
 
     /* TODO(Abid): In the end, add an Assert so that RootTensor should only have shape=(1). */
-    PrevRootTensor = RootTensor;
+    __gzGLOBALBackpropRoot = RootTensor;
 
-    StackState.RunningTensorNum = 0;
+    StackState->RunningTensorNum = 0;
+}
+
+internal inline void
+gz_backprop(t32 *RootTensor) { gz_backprop_many(&RootTensor, NULL, 1); }
+
+/* NOTE(abid): Frees the stack of the calling thread, which is about to exit. */
+internal void
+gz_backprop_release_thread() {
+    stack_blocks_state *StackState = &__gzGLOBALBackpropStack;
+    while(StackState->CurrentBlock) {
+        stack_block *NextBlock = StackState->CurrentBlock->BelowBlock;
+        Free(StackState->CurrentBlock);
+        StackState->CurrentBlock = NextBlock;
+    }
+    Free(StackState->ReservedBlock);
+    memset(StackState, 0, sizeof(stack_blocks_state));
+    __gzGLOBALBackpropRoot = NULL;
 }
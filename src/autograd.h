@@ -26,5 +26,163 @@ typedef struct {
     stack_block *ReservedBlock;
 } stack_blocks_state;
 
+/* NOTE(abid): Every pooled grad buffer is preceded by this header, so that we know which free list
+ *             the buffer goes back to. Padded so the buffer itself stays cache-line aligned. */
+typedef struct grad_pool_block grad_pool_block;
+struct grad_pool_block {
+    grad_pool_block *next_free;
+    u32 size_class;
+    u8 _padding[64 - sizeof(grad_pool_block *) - sizeof(u32)];
+};
+
+typedef struct grad_pool_chunk grad_pool_chunk;
+struct grad_pool_chunk {
+    grad_pool_chunk *prev;
+    usize size;
+    usize used;
+};
+
+/* NOTE(abid): Size classes are powers of two, starting at `GZ_GRAD_POOL_MIN_CLASS_BYTES`. */
+#define GZ_GRAD_POOL_MIN_CLASS_BYTES 64
+#define GZ_GRAD_POOL_NUM_CLASSES 40
+#define GZ_GRAD_POOL_CHUNK_BYTES gzMegabyte(4)
+
+typedef struct {
+    grad_pool_chunk *chunk;
+    grad_pool_block *free_lists[GZ_GRAD_POOL_NUM_CLASSES];
+
+    usize bytes_in_use;
+    usize peak_bytes_in_use;
+    usize bytes_reserved;
+
+    /* NOTE(abid): Replicas of a data-parallel trainer run their backprops at the same time. */
+    u32 lock;
+} grad_pool;
+
+/* NOTE(abid): Context of a checkpointed segment. Only the segment's output is kept from the forward,
+ *             during backprop `forward` is run once more on the segment input to rebuild the graph. */
+typedef t32 *checkpoint_forward(void *context, t32 *input, mem_arena *arena);
+typedef struct {
+    checkpoint_forward *forward;
+    void *context;
+    mem_arena *arena;
+} checkpoint_info;
+
+/* NOTE(abid): The backward of a broadcast binary op walks the index space of the parent once and sums a
+ *             term of the parent grad into the grad of an operand, reducing the dims it was broadcast on.
+ *             `other` is the operand on the other side of the op and `self` is the data of the operand. */
+typedef enum {
+    broadcast_term_grad = 0,      /* dC */
+    broadcast_term_grad_mul,      /* dC*other */
+    broadcast_term_grad_div,      /* dC/other */
+    broadcast_term_grad_div_self, /* dC*other/(self*self) */
+} broadcast_term;
+
+#define GZ_BROADCAST_MAX_DIMS 32
+#define GZ_BROADCAST_LANES 8
+#define GZ_BROADCAST_PARTIAL_ALIGNMENT 64
+/* NOTE(abid): Below this many parent elements the reduction is not worth waking the thread pool for. */
+#define GZ_BROADCAST_PARALLEL_MIN (1 << 15)
+
+/* NOTE(abid): Dims of the parent with adjacent dims merged whenever all three layouts allow it, so the
+ *             innermost dim is as long as possible. Dim 0 is the innermost one, a stride of 0 in `dest`
+ *             means the dim is reduced. */
+typedef struct {
+    broadcast_term term;
+    f32 scale;
+
+    u32 num_dims;
+    usize sizes[GZ_BROADCAST_MAX_DIMS];
+    usize src_strides[GZ_BROADCAST_MAX_DIMS];
+    usize dest_strides[GZ_BROADCAST_MAX_DIMS];
+    usize other_strides[GZ_BROADCAST_MAX_DIMS];
+
+    f32 *src;
+    f32 *dest;
+    f32 *self;
+    f32 *other;
+    usize dest_num_elements;
+
+    /* NOTE(abid): When the outermost dim is split among threads and it is a reduced one, every task sums
+     *             into its own copy of dest which are then added up in task order. */
+    usize outer_chunk;
+    f32 *partials;
+    u32 num_partials;
+} broadcast_reduce;
+
+/* NOTE(abid): Runs as soon as backprop is done accumulating into the grad of a leaf, i.e. the grad is final
+ *             for this backprop. In a parallel backprop it runs on whichever thread got there, concurrently
+ *             with the rest of the graph and with the hooks of other leaves. */
+typedef void grad_hook_fn(t32 *tensor, void *context);
+typedef struct grad_hook {
+    grad_hook_fn *fn;
+    void *context;
+} grad_hook;
+
+/* NOTE(abid): How `gz_backprop` runs the graph once it has been counted. Serial is the default. Parallel runs
+ *             every operand of every tensor whose consumers are all done as a task of its own on the thread
+ *             pool, e.g. the grads of both sides of a matmul at the same time. A lock per operand keeps the
+ *             accumulation of its consumers apart, in whatever order the threads get there, and is held for
+ *             the whole backward into it, so consumers of the same operand still take turns. A view of a leaf
+ *             counts as the leaf here, since the two share one grad.
+ *             Deterministic runs the graph in waves of ready tensors and gives every operand of a wave to a
+ *             single task, which adds the grads up in the same order every time. Graphs with checkpoints, and
+ *             graphs under a memory plan, always run serially. */
+typedef enum {
+    backprop_serial = 0,
+    backprop_parallel,
+    backprop_deterministic,
+} backprop_mode;
+
+global_var backprop_mode __gzGLOBALBackpropMode = backprop_serial;
+
+/* NOTE(abid): Per thread, so that the replicas of a data-parallel trainer can backprop at the same time. See
+ *             `gz_backprop_many` for why the root is kept. */
+global_var thread_local_var t32 *__gzGLOBALBackpropRoot = NULL;
+global_var thread_local_var stack_blocks_state __gzGLOBALBackpropStack = {0};
+/* NOTE(abid): Graphs with fewer tensors to pass grads through are not worth waking the pool for. */
+#define GZ_BACKPROP_PARALLEL_MIN_NODES 4
+
+typedef struct {
+    t32 *tensor;
+    t32 *operand; /* NOTE(abid): The owner of the grad the edge writes to, see `__gzGradOwner`. */
+    u32 operand_idx;
+    u32 order;
+} backward_edge;
+
+/* NOTE(abid): Parallel, a tensor whose grad is final, and the grads of how many of its operands are still being
+ *             computed. */
+typedef struct {
+    t32 *tensor;
+    u32 num_pending;
+} backward_node;
+
+typedef struct {
+    backward_node *node;
+    u32 operand_idx;
+} backward_task;
+
+typedef struct {
+#ifdef GRAZIE_PLT_WIN
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE work_ready;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+#endif
+    /* NOTE(abid): Parallel, the operands to pass grads to and the number of tensors not done yet. */
+    backward_task *ready;
+    u32 num_ready;
+    u32 num_remaining;
+    backward_node *nodes;
+    u32 num_nodes;
+
+    /* NOTE(abid): Deterministic, the edges of the wave sorted by operand, and where each operand starts. */
+    backward_edge *edges;
+    u32 *group_begins;
+    u32 num_groups;
+} backward_schedule;
+
 #define AUTOGRAD_H
 #endif
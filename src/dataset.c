@@ -14,6 +14,8 @@ typedef struct {
 
     f32 *stream;
     u64 length;
+
+    mem_file_map file_map; /* NOTE(abid): Only for datasets opened with `gz_dataset_open_mmap`. */
 } dataset;
 
 inline internal dataset
@@ -21,7 +23,7 @@ gz_dataset_build(f32 *stream, u64 stream_length, u64 batch_size, u64 *shape, u64
     dataset result = {0};
 
     /* TODO(abid): Have more types than just `f32`. */
-    /* TODO(abid): Implement shuffling for random batches. */
+    /* NOTE(abid): For shuffled batches, see `dataset_sampler`. */
     result.base_tensor = _gz_tensor_alloc_huskf32_batched(shape, shape_length, batch_size, arena);
     result.stream = stream;
     /* NOTE(abid): Ignoring data not fit into batch. */
@@ -42,3 +44,631 @@ gz_dataset_index(dataset *dataset, u64 idx) {
 
     return dataset->base_tensor;
 }
+
+/* NOTE(abid): Samples are the rows of the batches the dataset was built with. */
+internal inline u64
+gz_dataset_num_samples(dataset *dataset) { return dataset->length*dataset->base_tensor->Header->Sizes[0]; }
+
+internal inline u64
+gz_dataset_sample_stride(dataset *dataset) { return dataset->stride/dataset->base_tensor->Header->Sizes[0]; }
+
+/* NOTE(abid): An order of the samples for an epoch, shared by all datasets of one set of samples (e.g. inputs and
+ *             targets). Batch `idx` is `batch_size` entries of the permutation, from `idx*batch_size` on. Samples
+ *             that do not fill a whole batch are left out of the epoch, which with shuffling is not the same
+ *             samples every epoch. */
+typedef struct {
+    u32 *permutation;
+    u64 num_samples;
+    u64 batch_size;
+    bool shuffle;
+} dataset_sampler;
+
+/* NOTE(abid): Fisher-Yates on the grazie RNG, i.e. reproducible with `gzRandSeed`. */
+internal void
+gz_dataset_sampler_shuffle(dataset_sampler *sampler) {
+    u32 *permutation = sampler->permutation;
+    for(u64 idx = sampler->num_samples; idx > 1; --idx) {
+        u64 jdx = gzRandRangeU64(0, idx);
+        u32 temp = permutation[idx-1];
+        permutation[idx-1] = permutation[jdx];
+        permutation[jdx] = temp;
+    }
+}
+
+internal dataset_sampler
+gz_dataset_sampler_create(u64 num_samples, u64 batch_size, bool shuffle, mem_arena *arena) {
+    assert(num_samples <= UINT32_MAX, "too many samples for a sampler, got %llu", (unsigned long long)num_samples);
+    assert((batch_size > 0) && (batch_size <= num_samples), "batch size must be within the number of samples");
+    dataset_sampler result = {0};
+    result.permutation = gzMemPushArray(arena, u32, num_samples);
+    result.num_samples = num_samples;
+    result.batch_size = batch_size;
+    result.shuffle = shuffle;
+    for(u64 idx = 0; idx < num_samples; ++idx) result.permutation[idx] = (u32)idx;
+    if(shuffle) gz_dataset_sampler_shuffle(&result);
+
+    return result;
+}
+
+/* NOTE(abid): Reshuffles, if the sampler shuffles at all. */
+internal inline void
+gz_dataset_sampler_next_epoch(dataset_sampler *sampler) { if(sampler->shuffle) gz_dataset_sampler_shuffle(sampler); }
+
+internal inline u64
+gz_dataset_sampler_num_batches(dataset_sampler *sampler) { return sampler->num_samples/sampler->batch_size; }
+
+/* NOTE(abid): The sample indices of a batch, `batch_size` of them, without copying anything. For ops that gather
+ *             by themselves, e.g. an embedding lookup. Valid until the next shuffle. */
+internal inline u32 *
+gz_dataset_sampler_indices(dataset_sampler *sampler, u64 batch_idx) {
+    assert(batch_idx < gz_dataset_sampler_num_batches(sampler), "batch index out of bounds");
+    return sampler->permutation + batch_idx*sampler->batch_size;
+}
+
+/* NOTE(abid): Above this many bytes a gathered batch is written past the cache. */
+#define GZ_DATASET_STREAM_MIN_BYTES gzMegabyte(4)
+
+/* NOTE(abid): Tensor of `batch_size` samples of the dataset on an aligned buffer of its own, to gather into. It
+ *             is meant to be made once and reused for every batch. */
+internal t32 *
+gz_dataset_batch_create(dataset *dataset, u64 batch_size, mem_arena *arena) {
+    tensor_header *header = dataset->base_tensor->Header;
+    u32 shape[GZ_TENSOR_MAX_DIMS];
+    memcpy(shape, header->Sizes, header->Dim*sizeof(u32));
+    shape[0] = (u32)batch_size;
+    t32 *result = __gz_tensor_alloc_husk(shape, header->Dim, arena);
+    result->Data.Ptr = gzMemPushSizeAligned(arena, batch_size*gz_dataset_sample_stride(dataset)*sizeof(f32), 64);
+
+    return result;
+}
+
+/* NOTE(abid): Copies the samples of `indices` into the rows of `batch` (see `gz_dataset_batch_create`). */
+internal t32 *
+gz_dataset_gather(dataset *dataset, u32 *indices, u64 count, t32 *batch) {
+    assert(count == batch->Header->Sizes[0], "batch has %u rows, %llu samples given", batch->Header->Sizes[0],
+           (unsigned long long)count);
+    u64 sample_stride = gz_dataset_sample_stride(dataset);
+    u64 num_samples = gz_dataset_num_samples(dataset);
+    f32 *dest = (f32 *)batch->Data.Ptr;
+    bool should_stream = count*sample_stride*sizeof(f32) >= GZ_DATASET_STREAM_MIN_BYTES;
+    for(u64 idx = 0; idx < count; ++idx) {
+        assert(indices[idx] < num_samples, "sample index %u out of bounds", indices[idx]);
+        f32 *src = dataset->stream + indices[idx]*sample_stride;
+        if(should_stream) gz_copy_stream_f32(dest + idx*sample_stride, src, sample_stride);
+        else memcpy(dest + idx*sample_stride, src, sample_stride*sizeof(f32));
+    }
+    if(should_stream) gz_stream_fence();
+
+    return batch;
+}
+
+/* NOTE(abid): Batch `batch_idx` of the sampler's order, gathered into `batch`. */
+internal inline t32 *
+gz_dataset_sample_batch(dataset *dataset, dataset_sampler *sampler, u64 batch_idx, t32 *batch) {
+    return gz_dataset_gather(dataset, gz_dataset_sampler_indices(sampler, batch_idx), sampler->batch_size, batch);
+}
+
+/* NOTE(abid): Same as `gz_dataset_index`, but on a husk of its own in `arena`, so that several threads can
+ *             index the same dataset at once. */
+internal t32 *
+gz_dataset_index_husk(dataset *dataset, u64 idx, mem_arena *arena) {
+    assert(idx < dataset->length, "dataset index out of bounds");
+    tensor_header *header = dataset->base_tensor->Header;
+    t32 *result = __gz_tensor_alloc_husk(header->Sizes, header->Dim, arena);
+    result->Data.Ptr = dataset->stream + dataset->stride*idx;
+
+    return result;
+}
+
+/* NOTE(abid): On-disk dataset, a header followed by `count` rows of `shape`, i.e. exactly the stream that
+ *             `gz_dataset_build` takes. Rows start on a page boundary so that they can be mapped as they are.
+ *             Everything is little endian. */
+#define GZ_DATASET_FILE_MAGIC 0x31445a47 /* NOTE(abid): "GZD1" */
+#define GZ_DATASET_FILE_VERSION 1
+#define GZ_DATASET_FILE_MAX_DIMS 8
+#define GZ_DATASET_FILE_ALIGNMENT 4096
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 dtype; /* NOTE(abid): A `tensor_dtype`. */
+    u32 dim;
+    u64 count;
+    u64 shape[GZ_DATASET_FILE_MAX_DIMS];
+    u64 data_offset;
+} dataset_file_header;
+
+internal inline u64
+__gz_dataset_row_elements(u64 *shape, u64 shape_length) {
+    u64 result = 1;
+    for(u64 idx = 0; idx < shape_length; ++idx) result *= shape[idx];
+    return result;
+}
+
+/* NOTE(abid): Writes `count` rows of `shape` from `stream`. Returns false if the file could not be written. */
+internal bool
+gz_dataset_file_write(char *path, f32 *stream, u64 count, u64 *shape, u64 shape_length) {
+    assert(shape_length <= GZ_DATASET_FILE_MAX_DIMS, "dataset dim %u is too high", (u32)shape_length);
+    dataset_file_header header = {0};
+    header.magic = GZ_DATASET_FILE_MAGIC;
+    header.version = GZ_DATASET_FILE_VERSION;
+    header.dtype = dtype_f32;
+    header.dim = (u32)shape_length;
+    header.count = count;
+    memcpy(header.shape, shape, shape_length*sizeof(u64));
+    header.data_offset = GZ_DATASET_FILE_ALIGNMENT;
+
+    FILE *file = fopen(path, "wb");
+    if(!file) return false;
+    u8 padding[GZ_DATASET_FILE_ALIGNMENT - sizeof(dataset_file_header)] = {0};
+    usize num_elements = (usize)(count*__gz_dataset_row_elements(shape, shape_length));
+    bool result = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+                  (fwrite(padding, sizeof(padding), 1, file) == 1) &&
+                  (fwrite(stream, sizeof(f32), num_elements, file) == num_elements);
+    result = (fclose(file) == 0) && result;
+
+    return result;
+}
+
+/* NOTE(abid): Maps a dataset file read-only and serves its batches straight out of the page cache, so nothing
+ *             is loaded up front and the rows never count as private memory of the process. `access` is how the
+ *             batches are going to be read: `mem_access_sequential` for `gz_dataset_index` in order (the system
+ *             reads far ahead), `mem_access_random` for a shuffled `dataset_sampler` (it reads nothing extra).
+ *             Close with `gz_dataset_close`, after which none of the batches may be touched. */
+internal dataset
+gz_dataset_open_mmap(char *path, u64 batch_size, mem_access access, mem_arena *arena) {
+    mem_file_map file_map = gzPlatformFileMap(path);
+    assert(file_map.Ptr, "could not map dataset file %s", path);
+    assert(file_map.Size >= sizeof(dataset_file_header), "dataset file %s is too small", path);
+
+    dataset_file_header *header = (dataset_file_header *)file_map.Ptr;
+    assert(header->magic == GZ_DATASET_FILE_MAGIC, "%s is not a dataset file", path);
+    assert(header->version == GZ_DATASET_FILE_VERSION, "dataset file version %u is not supported", header->version);
+    /* TODO(abid): Have more types than just `f32`. */
+    assert(header->dtype == dtype_f32, "dataset file dtype %u is not supported", header->dtype);
+    /* NOTE(abid): The header is not trusted, no product of its sizes may wrap around before it is checked
+     *             against the size of the file. The batch dim comes on top of `dim`. */
+    assert(header->dim <= GZ_DATASET_FILE_MAX_DIMS, "dataset file dim %u is too high", header->dim);
+    assert((header->data_offset % sizeof(f32)) == 0, "dataset file rows are not aligned");
+    u64 row_elements = 1;
+    for(u32 idx = 0; idx < header->dim; ++idx) {
+        assert((header->shape[idx] > 0) && (header->shape[idx] <= UINT32_MAX),
+               "dataset file shape entry %u is out of range", idx);
+        assert(row_elements <= UINT64_MAX/header->shape[idx], "dataset file rows are too large");
+        row_elements *= header->shape[idx];
+    }
+    assert(header->count <= (UINT64_MAX/sizeof(f32))/row_elements, "dataset file %s has too many rows", path);
+    u64 num_elements = header->count*row_elements;
+    assert((header->data_offset <= file_map.Size) &&
+           (num_elements <= (file_map.Size - header->data_offset)/sizeof(f32)), "dataset file %s is truncated", path);
+    assert((batch_size > 0) && (batch_size <= header->count), "batch size must be within the number of rows");
+
+    f32 *stream = (f32 *)((u8 *)file_map.Ptr + header->data_offset);
+    dataset result = gz_dataset_build(stream, num_elements, batch_size, header->shape, header->dim, arena);
+    result.file_map = file_map;
+    gzPlatformMemAdvise(stream, (usize)(num_elements*sizeof(f32)), access);
+
+    return result;
+}
+
+internal void
+gz_dataset_close(dataset *dataset) {
+    gzPlatformFileUnmap(&dataset->file_map);
+    dataset->stream = NULL;
+    dataset->length = 0;
+}
+
+/* NOTE(abid): IDX files, the format MNIST comes in. A big endian header of two zero bytes, the type of the
+ *             elements and the number of dims, then the size of every dim as a big endian u32, then the elements
+ *             themselves. Only u8 elements are read, which are kept as they are on disk. */
+#define GZ_IDX_TYPE_U8 0x08
+
+typedef struct {
+    mem_file_map file_map;
+    u8 *data;
+    u32 dim;
+    u32 shape[GZ_TENSOR_MAX_DIMS];
+    u64 count;       /* NOTE(abid): Size of the first dim. */
+    u64 sample_size; /* NOTE(abid): Elements of every entry of the first dim. */
+} idx_file;
+
+internal inline u32
+__gz_read_u32_be(u8 *bytes) { return ((u32)bytes[0] << 24) | ((u32)bytes[1] << 16) | ((u32)bytes[2] << 8) | bytes[3]; }
+
+internal idx_file
+gz_idx_open(char *path, mem_access access) {
+    idx_file result = {0};
+    result.file_map = gzPlatformFileMap(path);
+    assert(result.file_map.Ptr, "could not map idx file %s", path);
+    u8 *bytes = (u8 *)result.file_map.Ptr;
+    usize size = result.file_map.Size;
+    assert((size >= 4) && (bytes[0] == 0) && (bytes[1] == 0), "%s is not an idx file", path);
+    assert(bytes[2] == GZ_IDX_TYPE_U8, "idx element type 0x%02x is not supported", bytes[2]);
+    result.dim = bytes[3];
+    assert((result.dim > 0) && (result.dim < GZ_TENSOR_MAX_DIMS), "idx file dim %u is not supported", result.dim);
+    assert(size >= 4 + 4*(usize)result.dim, "idx file %s is truncated", path);
+
+    /* NOTE(abid): As with the dataset files, no product of the sizes may wrap around before it is checked
+     *             against the size of the file. */
+    result.sample_size = 1;
+    for(u32 idx = 0; idx < result.dim; ++idx) {
+        result.shape[idx] = __gz_read_u32_be(bytes + 4 + 4*idx);
+        assert(result.shape[idx] > 0, "idx file shape entry %u is zero", idx);
+        if(idx == 0) continue;
+        assert(result.sample_size <= UINT64_MAX/result.shape[idx], "idx file samples are too large");
+        result.sample_size *= result.shape[idx];
+    }
+    result.count = result.shape[0];
+    result.data = bytes + 4 + 4*result.dim;
+    assert((result.count <= UINT64_MAX/result.sample_size) &&
+           (result.count*result.sample_size <= size - (usize)(result.data - bytes)), "idx file %s is truncated", path);
+    gzPlatformMemAdvise(result.data, (usize)(result.count*result.sample_size), access);
+
+    return result;
+}
+
+internal inline void
+gz_idx_close(idx_file *file) { gzPlatformFileUnmap(&file->file_map); }
+
+/* NOTE(abid): Default normalization, the mean and the standard deviation of the MNIST training pixels. */
+#define GZ_MNIST_MEAN 0.1307f
+#define GZ_MNIST_STD 0.3081f
+
+/* NOTE(abid): Images and labels stay mapped as u8, a quarter of what they take as floats. Pixels are only
+ *             normalized to f32 when they are gathered into a batch, `pixel*scale + bias`. */
+typedef struct {
+    idx_file images;
+    idx_file labels;
+    u64 num_samples;
+    f32 scale;
+    f32 bias;
+} mnist_dataset;
+
+/* NOTE(abid): Pixels come out as (pixel/255 - mean)/std. */
+internal inline void
+gz_mnist_set_normalization(mnist_dataset *mnist, f32 mean, f32 std) {
+    mnist->scale = 1.0f/(255.0f*std);
+    mnist->bias = -mean/std;
+}
+
+/* NOTE(abid): The images and labels files of one split, e.g. train-images-idx3-ubyte and train-labels-idx1-ubyte. */
+internal mnist_dataset
+gz_mnist_open(char *images_path, char *labels_path, mem_access access) {
+    mnist_dataset result = {0};
+    result.images = gz_idx_open(images_path, access);
+    result.labels = gz_idx_open(labels_path, access);
+    assert(result.images.dim == 3, "mnist images must have 3 dims, got %u", result.images.dim);
+    assert((result.labels.dim == 1) && (result.labels.count == result.images.count),
+           "mnist labels do not match the %llu images", (unsigned long long)result.images.count);
+    result.num_samples = result.images.count;
+    gz_mnist_set_normalization(&result, GZ_MNIST_MEAN, GZ_MNIST_STD);
+
+    return result;
+}
+
+internal void
+gz_mnist_close(mnist_dataset *mnist) {
+    gz_idx_close(&mnist->images);
+    gz_idx_close(&mnist->labels);
+}
+
+/* NOTE(abid): An f32 batch of `batch_size` images of shape {batch_size, rows, cols} and an i32 batch of their
+ *             labels (class indices), both on buffers of their own to gather into. */
+internal void
+gz_mnist_batch_create(mnist_dataset *mnist, u64 batch_size, t32 **images, t32 **labels, mem_arena *arena) {
+    u32 image_shape[3] = {(u32)batch_size, mnist->images.shape[1], mnist->images.shape[2]};
+    *images = __gz_tensor_alloc_husk(image_shape, 3, arena);
+    (*images)->Data.Ptr = gzMemPushSizeAligned(arena, batch_size*mnist->images.sample_size*sizeof(f32), 64);
+
+    u32 label_shape[1] = {(u32)batch_size};
+    *labels = __gz_tensor_alloc_husk(label_shape, 1, arena);
+    (*labels)->Data.DType = dtype_i32;
+    (*labels)->Data.Ptr = gzMemPushSizeAligned(arena, batch_size*sizeof(i32), 64);
+}
+
+internal void
+gz_mnist_gather(mnist_dataset *mnist, u32 *indices, u64 count, t32 *images, t32 *labels) {
+    assert((count == images->Header->Sizes[0]) && (count == labels->Header->Sizes[0]),
+           "batch has %u rows, %llu samples given", images->Header->Sizes[0], (unsigned long long)count);
+    u64 sample_size = mnist->images.sample_size;
+    f32 *image_dest = (f32 *)images->Data.Ptr;
+    i32 *label_dest = (i32 *)labels->Data.Ptr;
+    for(u64 idx = 0; idx < count; ++idx) {
+        assert(indices[idx] < mnist->num_samples, "sample index %u out of bounds", indices[idx]);
+        gz_convert_u8_f32(image_dest + idx*sample_size, mnist->images.data + indices[idx]*sample_size, sample_size,
+                          mnist->scale, mnist->bias);
+        label_dest[idx] = (i32)mnist->labels.data[indices[idx]];
+    }
+}
+
+/* NOTE(abid): Numeric CSV, one sample per line and the same number of columns on every line. Quoted fields are
+ *             not supported. The trailing `num_target_columns` columns are written to a stream of their own,
+ *             e.g. for the labels. */
+typedef struct {
+    char delimiter;
+    bool has_header;
+    u32 num_target_columns;
+    bool report_progress;
+} csv_options;
+
+/* NOTE(abid): `inputs` and `targets` are laid out as `gz_dataset_build` takes them, row after row. */
+typedef struct {
+    f32 *inputs;
+    f32 *targets;
+    u64 num_rows;
+    u32 num_input_columns;
+    u32 num_target_columns;
+
+    usize num_bytes;
+    f64 split_seconds;
+    f64 parse_seconds;
+} csv_table;
+
+/* NOTE(abid): The file is split into chunks of about this size that start on a line. Lines are counted and then
+ *             parsed a chunk per task, and the counts give every chunk the first row it writes to. */
+#define GZ_CSV_CHUNK_BYTES gzMegabyte(1)
+/* NOTE(abid): Longest number that is handed to strtof when it is not taken by the fast path. */
+#define GZ_CSV_MAX_NUMBER_LENGTH 64
+
+typedef struct {
+    u8 **chunk_begins; /* NOTE(abid): `num_chunks+1` of them, the last one is the end of the file. */
+    u64 *chunk_rows;   /* NOTE(abid): Lines of every chunk, then the first row of every chunk. */
+    u32 num_chunks;
+    u32 num_chunks_done;
+
+    csv_options options;
+    csv_table *table;
+} csv_job;
+
+global_var f64 __gzGLOBALPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* NOTE(abid): Eight ASCII digits in a little endian word, checked and summed without a loop. */
+internal inline bool
+__gz_csv_is_8_digits(u64 chars) {
+    return (((chars & 0xf0f0f0f0f0f0f0f0ull) |
+             (((chars + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+internal inline u32
+__gz_csv_parse_8_digits(u64 chars) {
+    chars -= 0x3030303030303030ull;
+    chars = (chars*10) + (chars >> 8);
+    chars = (((chars & 0x000000ff000000ffull)*(100 + (1000000ull << 32))) +
+             (((chars >> 16) & 0x000000ff000000ffull)*(1 + (10000ull << 32)))) >> 32;
+    return (u32)chars;
+}
+
+/* NOTE(abid): Up to 19 significant digits are gathered into an integer and scaled by an exact power of ten.
+ *             When both are exact as floats that is a single rounding, i.e. the same as strtof. Otherwise it is
+ *             done in doubles and rounded twice, which only differs from strtof halfway between two floats.
+ *             Anything else (more digits, large exponents, inf and nan) goes through strtof. Returns the end of
+ *             the number, or NULL if there is none at `at`. */
+internal u8 *
+__gz_csv_parse_f32(u8 *at, u8 *end, f32 *result) {
+    u8 *begin = at;
+    bool is_negative = false;
+    if((at < end) && ((*at == '-') || (*at == '+'))) is_negative = (*at++ == '-');
+
+    u64 mantissa = 0;
+    u32 num_digits = 0;
+    i32 exponent = 0;
+    bool is_truncated = false;
+    bool has_digits = false;
+    for(bool is_fraction = false;; is_fraction = true) {
+        for(;;) {
+            u64 chars;
+            if((at + 8 <= end) && (num_digits + 8 <= 19) &&
+               (memcpy(&chars, at, sizeof(chars)), __gz_csv_is_8_digits(chars))) {
+                mantissa = mantissa*100000000ull + __gz_csv_parse_8_digits(chars);
+                if(mantissa) num_digits += 8;
+                if(is_fraction) exponent -= 8;
+                at += 8;
+                has_digits = true;
+                continue;
+            }
+            if((at >= end) || ((u8)(*at - '0') > 9)) break;
+            u32 digit = *at++ - '0';
+            has_digits = true;
+            if(num_digits < 19) {
+                mantissa = mantissa*10 + digit;
+                if(mantissa) ++num_digits;
+                if(is_fraction) --exponent;
+            } else {
+                is_truncated |= (digit != 0);
+                if(!is_fraction) ++exponent;
+            }
+        }
+        if(is_fraction || (at >= end) || (*at != '.')) break;
+        ++at;
+    }
+
+    if(has_digits && (at < end) && ((*at == 'e') || (*at == 'E'))) {
+        u8 *exponent_at = at + 1;
+        bool is_exponent_negative = false;
+        if((exponent_at < end) && ((*exponent_at == '-') || (*exponent_at == '+')))
+            is_exponent_negative = (*exponent_at++ == '-');
+        if((exponent_at < end) && ((u8)(*exponent_at - '0') <= 9)) {
+            i32 written_exponent = 0;
+            for(; (exponent_at < end) && ((u8)(*exponent_at - '0') <= 9); ++exponent_at) {
+                if(written_exponent < 100000) written_exponent = written_exponent*10 + (*exponent_at - '0');
+            }
+            exponent += is_exponent_negative ? -written_exponent : written_exponent;
+            at = exponent_at;
+        }
+    }
+
+    if(has_digits && !is_truncated && (mantissa <= (1ull << 53)) && (exponent >= -22) && (exponent <= 22)) {
+        f32 value;
+        if((mantissa <= (1ull << 24)) && (exponent >= -10) && (exponent <= 10)) {
+            value = exponent < 0 ? (f32)mantissa/(f32)__gzGLOBALPow10[-exponent]
+                                 : (f32)mantissa*(f32)__gzGLOBALPow10[exponent];
+        } else {
+            value = (f32)(exponent < 0 ? (f64)mantissa/__gzGLOBALPow10[-exponent]
+                                       : (f64)mantissa*__gzGLOBALPow10[exponent]);
+        }
+        *result = is_negative ? -value : value;
+        return at;
+    }
+
+    char number[GZ_CSV_MAX_NUMBER_LENGTH + 1];
+    usize length = 0;
+    while((begin + length < end) && (length < GZ_CSV_MAX_NUMBER_LENGTH) && begin[length] &&
+          strchr("+-.0123456789eEaAfFiInNtTyY", begin[length])) ++length;
+    memcpy(number, begin, length);
+    number[length] = 0;
+    char *number_end;
+    *result = strtof(number, &number_end);
+    if(number_end == number) return NULL;
+
+    return begin + (number_end - number);
+}
+
+internal u64
+__gz_csv_count_lines(u8 *begin, u8 *end) {
+    u64 result = 0;
+    u8 *at = begin;
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128i newline = _mm_set1_epi8('\n');
+    for(; at + 16 <= end; at += 16) {
+        __m128i chars = _mm_loadu_si128((__m128i *)at);
+        result += gz_popcount_u32((u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline)));
+    }
+#endif
+    for(; at < end; ++at) result += (*at == '\n');
+    /* NOTE(abid): Only the last line of the file can go without a newline. */
+    if((begin < end) && (end[-1] != '\n')) ++result;
+
+    return result;
+}
+
+internal void
+__gz_csv_count_task(void *data, u32 task_idx, u32 thread_idx) {
+    (void)thread_idx;
+    csv_job *job = (csv_job *)data;
+    job->chunk_rows[task_idx] = __gz_csv_count_lines(job->chunk_begins[task_idx], job->chunk_begins[task_idx+1]);
+}
+
+internal void
+__gz_csv_parse_task(void *data, u32 task_idx, u32 thread_idx) {
+    (void)thread_idx;
+    csv_job *job = (csv_job *)data;
+    csv_table *table = job->table;
+    u32 num_columns = table->num_input_columns + table->num_target_columns;
+    u8 *at = job->chunk_begins[task_idx];
+    u8 *end = job->chunk_begins[task_idx+1];
+    u64 row = job->chunk_rows[task_idx];
+
+    for(; at < end; ++row) {
+        f32 *input = table->inputs + row*table->num_input_columns;
+        f32 *target = table->targets ? table->targets + row*table->num_target_columns : NULL;
+        for(u32 column = 0; column < num_columns; ++column) {
+            while((at < end) && (*at == ' ')) ++at;
+            f32 value;
+            u8 *number_end = __gz_csv_parse_f32(at, end, &value);
+            assert(number_end, "csv row %llu, column %u is not a number", (unsigned long long)row, column);
+            if(column < table->num_input_columns) input[column] = value;
+            else target[column - table->num_input_columns] = value;
+
+            at = number_end;
+            while((at < end) && (*at == ' ')) ++at;
+            if(column + 1 < num_columns) {
+                assert((at < end) && (*at == (u8)job->options.delimiter), "csv row %llu has %u of %u columns",
+                       (unsigned long long)row, column+1, num_columns);
+                ++at;
+            }
+        }
+        if((at < end) && (*at == '\r')) ++at;
+        assert((at == end) || (*at == '\n'), "csv row %llu has more than %u columns", (unsigned long long)row,
+               num_columns);
+        ++at;
+    }
+
+    if(job->options.report_progress) {
+        u32 num_done = gz_atomic_add_u32(&job->num_chunks_done, 1) + 1;
+        if((u64)num_done*10/job->num_chunks != (u64)(num_done-1)*10/job->num_chunks)
+            printf("csv: %3u%%\n", (u32)((u64)num_done*100/job->num_chunks));
+    }
+}
+
+/* NOTE(abid): Maps the file and parses it on the thread pool, straight into streams in `arena`. The file is
+ *             unmapped again afterwards. */
+internal csv_table
+gz_csv_load(char *path, csv_options options, mem_arena *arena) {
+    csv_table result = {0};
+    mem_file_map file_map = gzPlatformFileMap(path);
+    assert(file_map.Ptr, "could not map csv file %s", path);
+    gzPlatformMemAdvise(file_map.Ptr, file_map.Size, mem_access_sequential);
+    u8 *file_begin = (u8 *)file_map.Ptr;
+    u8 *file_end = file_begin + file_map.Size;
+    result.num_bytes = file_map.Size;
+    f64 start = gz_time_seconds();
+
+    u8 *data_begin = file_begin;
+    if(options.has_header) {
+        u8 *newline = (u8 *)memchr(file_begin, '\n', file_map.Size);
+        data_begin = newline ? newline + 1 : file_end;
+    }
+    /* NOTE(abid): Blank lines at the end are not rows. */
+    while((file_end > data_begin) && ((file_end[-1] == '\n') || (file_end[-1] == '\r') || (file_end[-1] == ' ')))
+        --file_end;
+    u32 num_columns = 1;
+    for(u8 *at = data_begin; (at < file_end) && (*at != '\n'); ++at) num_columns += (*at == (u8)options.delimiter);
+    assert(data_begin < file_end, "csv file %s has no rows", path);
+    assert(options.num_target_columns < num_columns, "csv file has %u columns, %u of them can not be targets",
+           num_columns, options.num_target_columns);
+    result.num_input_columns = num_columns - options.num_target_columns;
+    result.num_target_columns = options.num_target_columns;
+
+    mem_arena *scratch = gz_thread_scratch_arena();
+    temp_memory temp = gz_mem_temp_begin(scratch);
+    csv_job job = {0};
+    job.options = options;
+    job.table = &result;
+    usize data_size = (usize)(file_end - data_begin);
+    job.num_chunks = (u32)((data_size + GZ_CSV_CHUNK_BYTES - 1)/GZ_CSV_CHUNK_BYTES);
+    job.chunk_begins = gzMemPushArray(scratch, u8 *, job.num_chunks + 1);
+    job.chunk_rows = gzMemPushArray(scratch, u64, job.num_chunks);
+    job.chunk_begins[0] = data_begin;
+    for(u32 idx = 1; idx < job.num_chunks; ++idx) {
+        u8 *at = data_begin + (usize)idx*GZ_CSV_CHUNK_BYTES;
+        if(at < job.chunk_begins[idx-1]) at = job.chunk_begins[idx-1];
+        else if(at[-1] != '\n') {
+            u8 *newline = (u8 *)memchr(at, '\n', (usize)(file_end - at));
+            at = newline ? newline + 1 : file_end;
+        }
+        job.chunk_begins[idx] = at;
+    }
+    job.chunk_begins[job.num_chunks] = file_end;
+
+    thread_pool *pool = gz_thread_pool_get();
+    gz_thread_pool_run(pool, __gz_csv_count_task, &job, job.num_chunks);
+    for(u32 idx = 0; idx < job.num_chunks; ++idx) {
+        u64 num_rows = job.chunk_rows[idx];
+        job.chunk_rows[idx] = result.num_rows;
+        result.num_rows += num_rows;
+    }
+    result.inputs = (f32 *)gzMemPushSizeAligned(arena, result.num_rows*result.num_input_columns*sizeof(f32), 64);
+    if(result.num_target_columns)
+        result.targets = (f32 *)gzMemPushSizeAligned(arena, result.num_rows*result.num_target_columns*sizeof(f32), 64);
+    result.split_seconds = gz_time_seconds() - start;
+
+    start = gz_time_seconds();
+    gz_thread_pool_run(pool, __gz_csv_parse_task, &job, job.num_chunks);
+    result.parse_seconds = gz_time_seconds() - start;
+
+    gz_mem_temp_end(temp);
+    gzPlatformFileUnmap(&file_map);
+    if(options.report_progress) {
+        printf("csv -> %llu rows of %u columns (%u targets), %.1f MB\n", (unsigned long long)result.num_rows,
+               num_columns, result.num_target_columns, (f64)result.num_bytes/gzMegabyte(1));
+        printf("    split: %8.3f s\n", result.split_seconds);
+        printf("    parse: %8.3f s, %.0f rows/s, %.1f MB/s\n\n", result.parse_seconds,
+               result.parse_seconds > 0.0 ? (f64)result.num_rows/result.parse_seconds : 0.0,
+               result.parse_seconds > 0.0 ? (f64)result.num_bytes/gzMegabyte(1)/result.parse_seconds : 0.0);
+    }
+
+    return result;
+}
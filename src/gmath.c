@@ -12,7 +12,137 @@ gz_clamp(f32 Value, f32 Min, f32 Max) {
     return ClampBelow > Max ? Max : ClampBelow;
 }
 
+internal inline u32
+gz_popcount_u32(u32 value) {
+    value = value - ((value >> 1) & 0x55555555u);
+    value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+    return (((value + (value >> 4)) & 0x0f0f0f0fu)*0x01010101u) >> 24;
+}
+
 internal inline f32 gz_logf(f32 value) { return logf(value); }
 internal inline f64 gz_log(f64 value) { return log(value); }
+internal inline f32 gz_sqrtf(f32 value) { return sqrtf(value); }
+
+/* NOTE(abid): A*B + C, fused where the target has FMA so that loops of it vectorize to FMA instructions. Without
+ *             it fmaf is a library call, so it is left to the compiler to contract. */
+#if defined(__FMA__) || defined(__AVX2__)
+#define gz_fmadd(A, B, C) fmaf((A), (B), (C))
+#else
+#define gz_fmadd(A, B, C) ((A)*(B) + (C))
+#endif
+
+/* NOTE(abid): bfloat16 is the upper half of an f32, rounded to nearest even. NaNs stay NaNs. */
+internal inline u16
+gz_f32_to_bf16(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if((bits & 0x7fffffffu) > 0x7f800000u) return (u16)((bits >> 16) | 0x40u);
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return (u16)(bits >> 16);
+}
 
+internal inline f32
+gz_bf16_to_f32(u16 value) {
+    u32 bits = (u32)value << 16;
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
 
+/* NOTE(abid): Copy with non-temporal stores, i.e. the destination does not go through the cache. Only worth it for
+ *             copies larger than the cache, which would otherwise evict everything else on the way. Call
+ *             `gz_stream_fence` before the destination is handed to another thread. */
+internal void
+gz_copy_stream_f32(f32 *dest, f32 *src, usize count) {
+#if defined(__SSE2__) || defined(_M_X64)
+    usize idx = 0;
+    for(; (idx < count) && ((uintptr)(dest + idx) & 15); ++idx) dest[idx] = src[idx];
+    for(; idx + 8 <= count; idx += 8) {
+        _mm_stream_ps(dest + idx, _mm_loadu_ps(src + idx));
+        _mm_stream_ps(dest + idx + 4, _mm_loadu_ps(src + idx + 4));
+    }
+    for(; idx < count; ++idx) dest[idx] = src[idx];
+#else
+    memcpy(dest, src, count*sizeof(f32));
+#endif
+}
+
+internal inline void
+gz_stream_fence() {
+#if defined(__SSE2__) || defined(_M_X64)
+    _mm_sfence();
+#endif
+}
+
+/* NOTE(abid): dest = src*scale + bias, e.g. pixels to normalized floats. 16 bytes at a time are widened to
+ *             32-bit integers and converted, which is exact for any byte. */
+internal void
+gz_convert_u8_f32(f32 *dest, u8 *src, usize count, f32 scale, f32 bias) {
+    usize idx = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128 scale_x4 = _mm_set1_ps(scale);
+    __m128 bias_x4 = _mm_set1_ps(bias);
+    __m128i zero = _mm_setzero_si128();
+    for(; idx + 16 <= count; idx += 16) {
+        __m128i bytes = _mm_loadu_si128((__m128i *)(src + idx));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128 x0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+        __m128 x1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+        __m128 x2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+        __m128 x3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+        _mm_storeu_ps(dest + idx, _mm_add_ps(_mm_mul_ps(x0, scale_x4), bias_x4));
+        _mm_storeu_ps(dest + idx + 4, _mm_add_ps(_mm_mul_ps(x1, scale_x4), bias_x4));
+        _mm_storeu_ps(dest + idx + 8, _mm_add_ps(_mm_mul_ps(x2, scale_x4), bias_x4));
+        _mm_storeu_ps(dest + idx + 12, _mm_add_ps(_mm_mul_ps(x3, scale_x4), bias_x4));
+    }
+#endif
+    for(; idx < count; ++idx) dest[idx] = (f32)src[idx]*scale + bias;
+}
+
+/* NOTE(abid): C += op(A)*op(B), where op(A) is MxK and op(B) is KxN. Every matrix is given by its storage and
+ *             the row/column strides of the stored (non-transposed) matrix. A transposed operand is the same
+ *             storage with its strides swapped, so nothing is ever materialised. The loop order is picked such
+ *             that the innermost loop runs over unit strides whenever the layout allows it. */
+internal void
+gz_gemm_f32(bool TransA, bool TransB, u32 M, u32 N, u32 K,
+            f32 *A, usize ARowStride, usize AColStride,
+            f32 *B, usize BRowStride, usize BColStride,
+            f32 *C, usize CRowStride, usize CColStride) {
+    if(TransA) { usize Temp = ARowStride; ARowStride = AColStride; AColStride = Temp; }
+    if(TransB) { usize Temp = BRowStride; BRowStride = BColStride; BColStride = Temp; }
+    /* NOTE(abid): Unit sized dims have a stride of 0, any stride works for them. */
+    if(K == 1) { AColStride = 1; BRowStride = 1; }
+    if(N == 1) { BColStride = 1; CColStride = 1; }
+
+    if((BColStride == 1) && (CColStride == 1)) {
+        /* NOTE(abid): Rows of op(B) are scaled and added to the rows of C. */
+        for(u32 I = 0; I < M; ++I) {
+            f32 *CRow = C + I*CRowStride;
+            for(u32 P = 0; P < K; ++P) {
+                f32 AValue = A[I*ARowStride + P*AColStride];
+                f32 *BRow = B + P*BRowStride;
+                for(u32 J = 0; J < N; ++J) CRow[J] += AValue*BRow[J];
+            }
+        }
+    } else if((AColStride == 1) && (BRowStride == 1)) {
+        /* NOTE(abid): Rows of op(A) against columns of op(B), both of them contiguous. */
+        for(u32 I = 0; I < M; ++I) {
+            f32 *ARow = A + I*ARowStride;
+            for(u32 J = 0; J < N; ++J) {
+                f32 *BCol = B + J*BColStride;
+                f32 Sum = 0.f;
+                for(u32 P = 0; P < K; ++P) Sum += ARow[P]*BCol[P];
+                C[I*CRowStride + J*CColStride] += Sum;
+            }
+        }
+    } else {
+        for(u32 I = 0; I < M; ++I) {
+            for(u32 J = 0; J < N; ++J) {
+                f32 Sum = 0.f;
+                for(u32 P = 0; P < K; ++P) Sum += A[I*ARowStride + P*AColStride]*B[P*BRowStride + J*BColStride];
+                C[I*CRowStride + J*CColStride] += Sum;
+            }
+        }
+    }
+}
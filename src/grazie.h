@@ -15,8 +15,24 @@
 #endif
 
 #ifdef GRAZIE_PLT_LINUX
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* NOTE(abid): For `sched_setaffinity` */
+#endif
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <time.h>
 #include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
 #endif
 
 #include <stdlib.h>
@@ -31,12 +47,16 @@
 #include "gmath.c"
 #include "rand.c"
 #include "memory.c"
+#include "thread.c"
 #include "tensor.c"
 #include "autograd.c"
+#include "planner.c"
 #include "loss.c"
 #include "optimizer.c"
 #include "module.c"
 #include "dataset.c"
+#include "loader.c"
+#include "trainer.c"
 
 #define GRAZIE_H
 #endif
@@ -0,0 +1,262 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 9:05:37 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#include "loader.h"
+
+/* NOTE(abid): How to use the loader:
+ *
+ *     dataset *sources[] = {&inputs, &targets};
+ *     dataset_loader *loader = gz_loader_create(sources, 2, 64, true, 3, 1, &arena);   <- triple buffered
+ *
+ *     for(u64 epoch = 0; epoch < num_epochs; ++epoch) {
+ *         for(u64 idx = 0; idx < gz_loader_num_batches(loader); ++idx) {
+ *             t32 **batch = gz_loader_next(loader);                                       <- valid until the next call
+ *             t32 *loss = ...forward on batch[0] against batch[1]...;
+ *         }
+ *     }
+ *     gz_loader_print(loader);
+ *     gz_loader_destroy(loader);
+ *
+ * The training loop always holds one slot, so `num_slots` slots keep `num_slots-1` batches ready ahead of it.
+ * Tickets are u32, i.e. a loader is good for 4G batches. */
+
+internal inline u64
+gz_loader_num_batches(dataset_loader *loader) { return loader->num_batches; }
+
+/* NOTE(abid): Sleeps until the sequence of the slot is `expected`, or until the loader quits. */
+internal inline bool
+__gz_loader_wait_slot(dataset_loader *loader, loader_slot *slot, u32 expected) {
+    for(;;) {
+        u32 sequence = gz_atomic_load_u32(&slot->sequence);
+        if(sequence == expected) return true;
+        if(gz_atomic_load_u32(&loader->should_quit)) return false;
+        gz_wait_u32(&slot->sequence, sequence);
+    }
+}
+
+internal inline void
+__gz_loader_publish_slot(loader_slot *slot, u32 sequence) {
+    gz_atomic_store_u32(&slot->sequence, sequence);
+    gz_wake_all_u32(&slot->sequence);
+}
+
+#ifdef GRAZIE_PLT_WIN
+internal DWORD WINAPI
+#endif
+#ifdef GRAZIE_PLT_LINUX
+internal void *
+#endif
+__gz_loader_producer_main(void *arg) {
+    loader_producer *producer = (loader_producer *)arg;
+    dataset_loader *loader = producer->loader;
+
+    while(!gz_atomic_load_u32(&loader->should_quit)) {
+        u32 ticket = gz_atomic_add_u32(&loader->next_ticket, 1);
+        loader_slot *slot = loader->slots + ticket % loader->num_slots;
+        if(!__gz_loader_wait_slot(loader, slot, ticket)) break;
+
+        f64 begin = gz_time_seconds();
+        dataset_sampler *sampler = loader->samplers + ((ticket/loader->num_batches) & 1);
+        u32 *indices = gz_dataset_sampler_indices(sampler, ticket % loader->num_batches);
+        loader->fill(loader->fill_context, indices, loader->batch_size, slot->batches);
+        slot->produce_seconds = gz_time_seconds() - begin;
+
+        __gz_loader_publish_slot(slot, ticket+1);
+    }
+
+    return 0;
+}
+
+/* NOTE(abid): Sets up the loader without any batches, those go into `slots[idx].batches[source_idx]` before
+ *             `gz_loader_start`. For sources that are not plain datasets, e.g. ones that convert on the way;
+ *             see `gz_loader_create` otherwise. */
+internal dataset_loader *
+gz_loader_allocate(loader_fill *fill, void *fill_context, u32 num_sources, u64 num_samples, u64 batch_size,
+                   bool shuffle, u32 num_slots, u32 num_producers, mem_arena *arena) {
+    assert(num_slots >= 2, "loader needs at least two slots, got %u", num_slots);
+    assert(num_producers > 0, "loader needs at least one producer");
+    dataset_loader *loader = gz_mem_push_struct(dataset_loader, arena);
+    memset(loader, 0, sizeof(dataset_loader));
+
+    loader->fill = fill;
+    loader->fill_context = fill_context;
+    loader->num_sources = num_sources;
+    loader->batch_size = batch_size;
+    loader->samplers[0] = gz_dataset_sampler_create(num_samples, batch_size, shuffle, arena);
+    loader->samplers[1] = gz_dataset_sampler_create(num_samples, batch_size, shuffle, arena);
+    loader->num_batches = gz_dataset_sampler_num_batches(loader->samplers);
+    /* NOTE(abid): Otherwise producers could be on two epochs ahead, which share an order. */
+    assert(num_slots <= loader->num_batches, "loader has %u slots, but only %llu batches per epoch", num_slots,
+           (unsigned long long)loader->num_batches);
+
+    loader->num_slots = num_slots;
+    loader->slots = (loader_slot *)gzMemPushSizeAligned(arena, num_slots*sizeof(loader_slot), 64);
+    for(u32 idx = 0; idx < num_slots; ++idx) {
+        loader->slots[idx].batches = gzMemPushArray(arena, t32 *, num_sources);
+        memset(loader->slots[idx].batches, 0, num_sources*sizeof(t32 *));
+        loader->slots[idx].sequence = idx;
+    }
+    loader->num_producers = num_producers;
+    loader->producers = gzMemPushArray(arena, loader_producer, num_producers);
+    memset(loader->producers, 0, num_producers*sizeof(loader_producer));
+
+    return loader;
+}
+
+internal void
+gz_loader_start(dataset_loader *loader) {
+    assert(!loader->is_started, "loader is already started");
+    for(u32 idx = 0; idx < loader->num_slots; ++idx) {
+        for(u32 source_idx = 0; source_idx < loader->num_sources; ++source_idx)
+            assert(loader->slots[idx].batches[source_idx], "slot %u has no batch for source %u", idx, source_idx);
+    }
+
+    loader->start_seconds = gz_time_seconds();
+    for(u32 idx = 0; idx < loader->num_producers; ++idx) {
+        loader_producer *producer = loader->producers + idx;
+        producer->loader = loader;
+#ifdef GRAZIE_PLT_WIN
+        producer->handle = CreateThread(NULL, 0, __gz_loader_producer_main, producer, 0, NULL);
+        assert(producer->handle, "could not create loader producer %u", idx);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+        i32 error = pthread_create(&producer->handle, NULL, __gz_loader_producer_main, producer);
+        assert(error == 0, "could not create loader producer %u, error %d", idx, error);
+#endif
+    }
+    loader->is_started = true;
+}
+
+internal void
+__gz_loader_gather(void *context, u32 *indices, u64 count, t32 **batches) {
+    dataset **sources = (dataset **)context;
+    /* NOTE(abid): The number of sources is not passed along, the source list is NULL terminated. */
+    for(u32 idx = 0; sources[idx]; ++idx) gz_dataset_gather(sources[idx], indices, count, batches[idx]);
+}
+
+/* NOTE(abid): Loader over datasets that are indexed by the same samples, e.g. inputs and targets. Batch `idx`
+ *             of a slot is gathered from `sources[idx]`. */
+internal dataset_loader *
+gz_loader_create(dataset **sources, u32 num_sources, u64 batch_size, bool shuffle, u32 num_slots,
+                 u32 num_producers, mem_arena *arena) {
+    assert(num_sources > 0, "loader needs at least one source");
+    u64 num_samples = gz_dataset_num_samples(sources[0]);
+    dataset **context = gzMemPushArray(arena, dataset *, num_sources+1);
+    for(u32 idx = 0; idx < num_sources; ++idx) {
+        assert(gz_dataset_num_samples(sources[idx]) == num_samples, "loader sources differ in their samples");
+        context[idx] = sources[idx];
+    }
+    context[num_sources] = NULL;
+
+    dataset_loader *loader = gz_loader_allocate(__gz_loader_gather, context, num_sources, num_samples, batch_size,
+                                                shuffle, num_slots, num_producers, arena);
+    for(u32 idx = 0; idx < num_slots; ++idx) {
+        for(u32 source_idx = 0; source_idx < num_sources; ++source_idx)
+            loader->slots[idx].batches[source_idx] = gz_dataset_batch_create(sources[source_idx], batch_size, arena);
+    }
+    gz_loader_start(loader);
+
+    return loader;
+}
+
+internal void
+__gz_loader_mnist_fill(void *context, u32 *indices, u64 count, t32 **batches) {
+    gz_mnist_gather((mnist_dataset *)context, indices, count, batches[0], batches[1]);
+}
+
+/* NOTE(abid): Batches of normalized f32 images (`batch[0]`) and their i32 labels (`batch[1]`), converted from
+ *             the mapped bytes on the producers. */
+internal dataset_loader *
+gz_loader_create_mnist(mnist_dataset *mnist, u64 batch_size, bool shuffle, u32 num_slots, u32 num_producers,
+                       mem_arena *arena) {
+    dataset_loader *loader = gz_loader_allocate(__gz_loader_mnist_fill, mnist, 2, mnist->num_samples, batch_size,
+                                                shuffle, num_slots, num_producers, arena);
+    for(u32 idx = 0; idx < num_slots; ++idx)
+        gz_mnist_batch_create(mnist, batch_size, loader->slots[idx].batches, loader->slots[idx].batches + 1, arena);
+    gz_loader_start(loader);
+
+    return loader;
+}
+
+/* NOTE(abid): The next batch, one tensor per source. Gives the previous one back to the producers, so its
+ *             tensors must not be used anymore (nor anything that still reads their data, e.g. a graph to
+ *             backprop through). Epochs follow each other without a break. */
+internal t32 **
+gz_loader_next(dataset_loader *loader) {
+    assert(loader->is_started, "loader is not started");
+    if(loader->is_holding) {
+        u32 held = loader->consumer_ticket++;
+        __gz_loader_publish_slot(loader->slots + held % loader->num_slots, held + loader->num_slots);
+    }
+
+    u32 ticket = loader->consumer_ticket;
+    loader_slot *slot = loader->slots + ticket % loader->num_slots;
+    if(gz_atomic_load_u32(&slot->sequence) != ticket+1) {
+        f64 begin = gz_time_seconds();
+        __gz_loader_wait_slot(loader, slot, ticket+1);
+        loader->stall_seconds += gz_time_seconds() - begin;
+        ++loader->num_stalls;
+    }
+    loader->is_holding = true;
+    ++loader->num_batches_taken;
+    loader->produce_seconds += slot->produce_seconds;
+
+    u64 epoch = ticket/loader->num_batches;
+    if((ticket % loader->num_batches == 0) && (epoch > 0))
+        gz_dataset_sampler_next_epoch(loader->samplers + ((epoch+1) & 1));
+
+    return slot->batches;
+}
+
+internal loader_stats
+gz_loader_stats(dataset_loader *loader) {
+    loader_stats result = {0};
+    result.num_batches = loader->num_batches_taken;
+    result.num_stalls = loader->num_stalls;
+    result.stall_seconds = loader->stall_seconds;
+    result.produce_seconds = loader->produce_seconds;
+    if(loader->is_started) result.elapsed_seconds = gz_time_seconds() - loader->start_seconds;
+
+    return result;
+}
+
+internal void
+gz_loader_print(dataset_loader *loader) {
+    loader_stats stats = gz_loader_stats(loader);
+    f64 stall_fraction = stats.elapsed_seconds > 0.0 ? stats.stall_seconds/stats.elapsed_seconds : 0.0;
+    printf("loader -> %llu batches taken, %u producers, %u slots\n", (unsigned long long)stats.num_batches,
+           loader->num_producers, loader->num_slots);
+    printf("    stalled:   %10.3f s in %llu waits (%.1f%% of %.3f s)%s\n", stats.stall_seconds,
+           (unsigned long long)stats.num_stalls, 100.0*stall_fraction, stats.elapsed_seconds,
+           stall_fraction > GZ_LOADER_INPUT_BOUND_FRACTION ? ", input-bound" : "");
+    printf("    producing: %10.3f ms per batch\n\n",
+           stats.num_batches ? 1000.0*stats.produce_seconds/stats.num_batches : 0.0);
+}
+
+/* NOTE(abid): Stops the producers, the batches stay in the arena the loader was made in. */
+internal void
+gz_loader_destroy(dataset_loader *loader) {
+    if(!loader->is_started) return;
+    gz_atomic_store_u32(&loader->should_quit, 1);
+    /* NOTE(abid): Producers only sleep on slots, and only while their sequence stays what they saw. */
+    for(u32 idx = 0; idx < loader->num_slots; ++idx) {
+        gz_atomic_add_u32(&loader->slots[idx].sequence, loader->num_slots);
+        gz_wake_all_u32(&loader->slots[idx].sequence);
+    }
+
+    for(u32 idx = 0; idx < loader->num_producers; ++idx) {
+#ifdef GRAZIE_PLT_WIN
+        WaitForSingleObject(loader->producers[idx].handle, INFINITE);
+        CloseHandle(loader->producers[idx].handle);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+        pthread_join(loader->producers[idx].handle, NULL);
+#endif
+    }
+    loader->is_started = false;
+}
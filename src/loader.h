@@ -0,0 +1,85 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 9:05:37 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#if !defined(LOADER_H)
+
+/* NOTE(abid): Fills `batches`, one tensor per source of the loader, with the samples of `indices`. Runs on a
+ *             producer thread, i.e. it must not touch anything the training loop writes (e.g. the grazie RNG)
+ *             and must not allocate from arenas the training loop uses. */
+typedef void loader_fill(void *context, u32 *indices, u64 count, t32 **batches);
+
+/* NOTE(abid): A slot of the ring. `sequence` is a futex that says whose turn it is: the producer of ticket `t`
+ *             waits for it to be `t`, gathers into the batches and stores `t+1`, which is what the training
+ *             loop waits for. Once the training loop is done with the batches it stores `t+num_slots`, the
+ *             next ticket of the slot. One cache line each. */
+typedef struct {
+    t32 **batches;
+    f64 produce_seconds; /* NOTE(abid): Of the batches in the slot, handed over along with them. */
+    u32 sequence;
+    u8 _padding[64 - sizeof(u32) - sizeof(f64) - sizeof(t32 **)];
+} loader_slot;
+
+struct dataset_loader;
+typedef struct {
+    struct dataset_loader *loader;
+#ifdef GRAZIE_PLT_WIN
+    HANDLE handle;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_t handle;
+#endif
+} loader_producer;
+
+/* NOTE(abid): Prefetches batches on producer threads, so that the training loop does not wait on gathers, page
+ *             faults of mapped datasets or conversions. Batches are numbered by tickets, the producers take
+ *             tickets off a counter and the training loop takes them in order, so batches come out in the same
+ *             order as with the samplers alone, no matter how many producers there are. The slots are
+ *             preallocated, handing a batch over is one store and one load of its sequence. */
+typedef struct dataset_loader {
+    loader_slot *slots;
+    u32 num_slots;
+    u32 num_sources;
+    u64 batch_size;
+    u64 num_batches; /* NOTE(abid): Per epoch. */
+
+    loader_fill *fill;
+    void *fill_context;
+    /* NOTE(abid): Orders of the even and the odd epochs. The training loop reshuffles the one of the next epoch
+     *             when it takes the first batch of an epoch, at which point no producer reads it anymore and
+     *             none starts to before the training loop gives back a slot. */
+    dataset_sampler samplers[2];
+
+    u32 next_ticket;     /* NOTE(abid): Taken by the producers. */
+    u32 consumer_ticket; /* NOTE(abid): The training loop's next, or the one it holds. */
+    bool is_holding;
+    u32 should_quit;
+
+    loader_producer *producers;
+    u32 num_producers;
+    bool is_started;
+
+    u64 num_batches_taken;
+    u64 num_stalls;
+    f64 stall_seconds;
+    f64 produce_seconds;
+    f64 start_seconds;
+} dataset_loader;
+
+typedef struct {
+    u64 num_batches;
+    u64 num_stalls;
+    f64 stall_seconds;    /* NOTE(abid): The training loop waited on the loader. */
+    f64 elapsed_seconds;  /* NOTE(abid): Since `gz_loader_start`. */
+    f64 produce_seconds;  /* NOTE(abid): Of the batches taken, summed over all producers. */
+} loader_stats;
+
+/* NOTE(abid): Above this fraction of the time waiting on batches, the job counts as input-bound. */
+#define GZ_LOADER_INPUT_BOUND_FRACTION 0.05
+
+#define LOADER_H
+#endif
@@ -63,10 +63,11 @@ _gz_loss_binary_cross_entropy(t32 *A, t32 *B, t32 *Result, reduce_method *Reduce
         *((f32 *)Result->Data.Ptr) = *((f32 *)Result->Data.Ptr) / ExpectedNumOps;
     }
 
-    Result->Header->DerivedOp.TensorOp = op_binary_loss_cross_entropy;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
-    Result->Header->DerivedOp.op_context = ReduceMethod;
+    if(__gz_record_op(Result, op_binary_loss_cross_entropy, A, B)) {
+        /* NOTE(abid): The target is taken as constant. */
+        Result->Header->ShouldGrad = A->Header->ShouldGrad;
+        Result->Header->DerivedOp.op_context = ReduceMethod;
+    }
 }
 
 /* TODO(abid): Maybe it is better to have two options, one for `reduce_none` and one for others. */
@@ -74,13 +75,13 @@ inline internal t32 *
 gz_loss_binary_cross_entropy(t32 *a, t32 *b, reduce_method method, mem_arena *arena) {
     t32 *result;
     if(method == reduce_none) {
-        result = _gzTensorAllocf32(a->Header->Sizes, a->Header->Dim, 0, 0, a->Header->ShouldGrad, false, arena);
+        result = _gzTensorAllocf32(a->Header->Sizes, a->Header->Dim, 0, 0, false, false, arena);
     } else {
         u32 shape1[] = {1};
-        result = _gzTensorAllocf32(shape1, 1, 0, 0, a->Header->ShouldGrad, false, arena);
+        result = _gzTensorAllocf32(shape1, 1, 0, 0, false, false, arena);
     }
 
-    reduce_method *method_context = gz_mem_push_struct(reduce_method, arena);
+    reduce_method *method_context = gz_mem_push_struct(reduce_method, gz_mem_arena_meta(arena));
     *method_context = method;
     _gz_loss_binary_cross_entropy(a, b, result, method_context);
 
@@ -9,41 +9,100 @@
 #include "grazie.h"
 
 inline internal void
-train_xor(dataset *Xs, dataset *ys, f32 learning_rate, mem_arena *arena) {
+train_xor(dataset *Xs, dataset *ys, f32 learning_rate) {
+    /* NOTE(abid): The parameters live in the model arena, everything of a step in the step arena. */
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+
     module *model[] = {
-        gz_module_linear(2, 10, arena),
-        gz_module_relu(arena),
-        gz_module_linear(10, 8, arena),
-        gz_module_relu(arena),
-        gz_module_linear(8,  1, arena),
-        gz_module_sigmoid(arena),
+        gz_module_linear(2, 10, model_arena),
+        gz_module_relu(model_arena),
+        gz_module_linear(10, 8, model_arena),
+        gz_module_relu(model_arena),
+        gz_module_linear(8,  1, model_arena),
+        gz_module_sigmoid(model_arena),
     };
-    tensor_list optim_list = gz_tensor_list_from_module_list(model, gz_array_length(model), arena);
+    tensor_list optim_list = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
 
     u32 num_epochs = 100;
     for(u32 epoch = 0; epoch < num_epochs; ++epoch) {
 
         for(u64 idx = 0; idx < Xs->length; ++idx) {
-            temp_memory train_session = gz_mem_temp_begin(arena);
-
             gz_grad_zero(optim_list);
             t32 *input = gz_dataset_index(Xs, idx);
             t32 *y = gz_dataset_index(ys, idx);
 
-            t32 *y_hat = gz_module_run_all(model, gz_array_length(model), input, arena);
+            t32 *y_hat = gz_module_run_all(model, gz_array_length(model), input, &step_arena);
 
-            t32 *loss = gz_loss_binary_cross_entropy(y_hat, y, reduce_mean, arena);
+            t32 *loss = gz_loss_binary_cross_entropy(y_hat, y, reduce_mean, &step_arena);
             printf("Loss: %f\n", *(f32 *)loss->Data.Ptr);
             gz_backprop(loss);
             gz_optim_sgd(optim_list, learning_rate);
 
-            gz_mem_temp_end(train_session);
+            gz_mem_arena_reset(&step_arena);
         }
     }
 }
 
-i32 main() {
+i32 test_csv_parse();
+i32 test_dataset_file();
+i32 test_loader_epochs();
+i32 test_meta_arena_and_shape_intern();
+i32 test_tensor_alignment_and_flat_params();
+i32 test_gradcheck_matmul();
+i32 test_gradcheck_broadcast();
+i32 test_backprop_many();
+i32 test_checkpoint_grads();
+i32 test_inference_mode();
+i32 test_backprop_view_of_leaf();
+i32 test_optim_sgd();
+i32 test_optim_adam();
+i32 test_optim_clip();
+i32 test_mem_plan_replay();
+i32 test_optim_attach_to_backprop();
+i32 test_data_parallel();
+#ifdef GRAZIE_PLT_LINUX
+i32 test_multi_process();
+#endif
+i32 bench_hogwild();
+i32 bench_mnist(char *images_path, char *labels_path);
+
+i32 main(i32 argc, char **argv) {
+    if((argc > 1) && !strcmp(argv[1], "test")) {
+        /* NOTE(abid): More than one thread even on a single core, or the parallel paths are never taken. */
+        gz_thread_pool_init(4);
+        i32 num_failed = 0;
+        num_failed += test_csv_parse();
+        num_failed += test_dataset_file();
+        num_failed += test_loader_epochs();
+        num_failed += test_meta_arena_and_shape_intern();
+        num_failed += test_tensor_alignment_and_flat_params();
+        num_failed += test_gradcheck_matmul();
+        num_failed += test_gradcheck_broadcast();
+        num_failed += test_backprop_many();
+        num_failed += test_checkpoint_grads();
+        num_failed += test_inference_mode();
+        num_failed += test_backprop_view_of_leaf();
+        num_failed += test_optim_sgd();
+        num_failed += test_optim_adam();
+        num_failed += test_optim_clip();
+        num_failed += test_mem_plan_replay();
+        num_failed += test_optim_attach_to_backprop();
+        num_failed += test_data_parallel();
+        /* NOTE(abid): ThreadSanitizer does not support threads in a child forked from a threaded process. */
+#if defined(GRAZIE_PLT_LINUX) && !defined(__SANITIZE_THREAD__)
+        num_failed += test_multi_process();
+        /* NOTE(abid): The workers left this process with a pool of their own size. */
+        gz_thread_pool_init(4);
+#endif
+        printf("%s\n", num_failed ? "TESTS FAILED" : "TESTS PASSED");
+        return num_failed;
+    }
+    if((argc > 1) && !strcmp(argv[1], "bench-hogwild")) return bench_hogwild();
+    if((argc > 3) && !strcmp(argv[1], "bench-mnist")) return bench_mnist(argv[2], argv[3]);
+
     mem_arena main_arena = gzMemArenaAllocate(gzMegabyte(100));
+    gz_mem_arena_split_meta(&main_arena, gzMegabyte(16));
 
     /* NOTE(abid): Input */
     f32 train_X[] = {
@@ -68,7 +127,7 @@ i32 main() {
     dataset y = gz_dataset_build(train_y, gz_array_length(train_y), batch_size, y_shape,
                                  gz_array_length(y_shape), &main_arena);
 
-    train_xor(&X, &y, learning_rate, &main_arena);
+    train_xor(&X, &y, learning_rate);
 
     // for(u64 idx = 0; idx < X.length; ++idx) {
     //     t32 *input = dataset_index(&X, idx);
@@ -100,6 +159,1354 @@ i32 test_loss_binary_cross_entropy() {
     return 0;
 }
 
+/* NOTE(abid): The csv number parser has to agree with strtof on every number, fast path or not, and the loader
+ *             has to get the same rows out of a file with a header, CRLF lines and no newline at the end. */
+i32 test_csv_parse() {
+    char *numbers[] = {
+        "0", "-0", "+7", ".5", "5.", "-123.456", "3.14159265", "16777217", "0.1", "2.5e3", "1E-7", "-4.2e+10",
+        "3.4028234e38", "1e39", "1.17549435e-38", "1e-45", "7e-39", "1e-50", "0.000000001234567", "6.02214076E23",
+        "12345678901234567890", "123456789012345678901234.5", "0.12345678901234567890123", "9999999999999999999.9",
+        "1.00000000000000000000000001", "00000000000000000000000012", "1.5e", "2e+", "inf", "-nan",
+    };
+    u32 num_mismatches = 0;
+    for(u32 idx = 0; idx < gz_array_length(numbers); ++idx) {
+        u8 *begin = (u8 *)numbers[idx];
+        f32 got = 0.f;
+        u8 *end = __gz_csv_parse_f32(begin, begin + strlen(numbers[idx]), &got);
+        char *expected_end;
+        f32 expected = strtof(numbers[idx], &expected_end);
+        bool is_same = (got == expected) || (isnan(got) && isnan(expected));
+        if(!end || !is_same || (signbit(got) != signbit(expected)) || ((char *)end != expected_end)) {
+            printf("csv: parsed \"%s\" as %.9g, strtof gives %.9g\n", numbers[idx], got, expected);
+            ++num_mismatches;
+        }
+    }
+
+    /* NOTE(abid): Random numbers in the formats that are common in csv files. */
+    u64 state = 88172645463325252ull;
+    for(u32 idx = 0; idx < 20000; ++idx) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        char number[64];
+        switch(idx % 5) {
+            case 0: snprintf(number, sizeof(number), "%.9g", (f64)((state >> 20) % 1000000)/7.0 - 5000.0); break;
+            case 1: snprintf(number, sizeof(number), "%.17g", (f64)(state >> 11)*0x1.0p-53); break;
+            case 2: snprintf(number, sizeof(number), "%e", (f64)(state >> 11)*0x1.0p-40); break;
+            case 3: snprintf(number, sizeof(number), "%.6f", -(f64)(state >> 11)*0x1.0p-53); break;
+            default: snprintf(number, sizeof(number), "%.2E", (f64)(state >> 40)); break;
+        }
+        f32 got = 0.f;
+        __gz_csv_parse_f32((u8 *)number, (u8 *)number + strlen(number), &got);
+        if(got != strtof(number, NULL)) {
+            if(num_mismatches < 8) printf("csv: parsed \"%s\" as %.9g, strtof gives %.9g\n", number, got,
+                                          strtof(number, NULL));
+            ++num_mismatches;
+        }
+    }
+
+    char *path = "test_csv_parse.csv";
+    char *rows[][3] = {
+        {"1.5", "-2e-3", "0"},
+        {"123456789012345678901234", "0.1", "1"},
+        {"-7", "3.4e38", "1"},
+    };
+    FILE *file = fopen(path, "wb");
+    assert(file, "could not write %s", path);
+    fprintf(file, "first,second,label\r\n");
+    for(u32 row = 0; row < gz_array_length(rows); ++row) {
+        fprintf(file, "%s,%s,%s%s", rows[row][0], rows[row][1], rows[row][2],
+                (row + 1 < gz_array_length(rows)) ? "\r\n" : "");
+    }
+    fclose(file);
+
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(1));
+    csv_options options = {',', true, 1, false};
+    csv_table table = gz_csv_load(path, options, &arena);
+    remove(path);
+    bool is_shape_ok = (table.num_rows == gz_array_length(rows)) && (table.num_input_columns == 2) &&
+                       (table.num_target_columns == 1);
+    for(u32 row = 0; is_shape_ok && (row < gz_array_length(rows)); ++row) {
+        for(u32 column = 0; column < 3; ++column) {
+            f32 got = (column < 2) ? table.inputs[row*2 + column] : table.targets[row];
+            if(got != strtof(rows[row][column], NULL)) {
+                printf("csv: row %u, column %u is %.9g, expected %s\n", row, column, got, rows[row][column]);
+                ++num_mismatches;
+            }
+        }
+    }
+    gz_mem_arena_release(&arena);
+
+    bool is_passed = is_shape_ok && !num_mismatches;
+    printf("csv parse: %u mismatches, %s\n", num_mismatches, is_passed ? "ok" : "FAILED");
+    return is_passed ? 0 : 1;
+}
+
+#ifdef GRAZIE_PLT_LINUX
+/* NOTE(abid): A bad file fails an assert, which exits, so it is opened in a child. */
+internal bool
+test_dataset_file_is_refused(char *path) {
+    fflush(stdout);
+    pid_t pid = fork();
+    assert(pid >= 0, "could not fork");
+    if(pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        mem_arena arena = gzMemArenaAllocate(gzMegabyte(1));
+        gz_dataset_open_mmap(path, 1, mem_access_normal, &arena);
+        _exit(0);
+    }
+    i32 status = 0;
+    waitpid(pid, &status, 0);
+    return !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+}
+#endif
+
+/* NOTE(abid): A dataset file mapped back has the batches of the stream it was written from. A file cut short
+ *             of its rows, or with a header whose sizes wrap around, must not be opened. */
+i32 test_dataset_file() {
+    char *path = "test_dataset_file.gzd";
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(4));
+    u64 shape[] = {3, 5};
+    u64 count = 101, row_elements = 15, batch_size = 4;
+    f32 *stream = gzMemPushArray(&arena, f32, count*row_elements);
+    for(u64 idx = 0; idx < count*row_elements; ++idx) stream[idx] = (f32)idx*0.5f - 100.f;
+    bool is_written = gz_dataset_file_write(path, stream, count, shape, gz_array_length(shape));
+    assert(is_written, "could not write %s", path);
+
+    dataset expected = gz_dataset_build(stream, count*row_elements, batch_size, shape, gz_array_length(shape), &arena);
+    dataset mapped = gz_dataset_open_mmap(path, batch_size, mem_access_sequential, &arena);
+    bool is_same = (mapped.length == expected.length) && (mapped.stride == expected.stride) &&
+                   !((usize)mapped.stream % GZ_TENSOR_DEFAULT_ALIGNMENT);
+    for(u64 idx = 0; is_same && (idx < mapped.length); ++idx) {
+        t32 *batch = gz_dataset_index(&mapped, idx);
+        t32 *expected_batch = gz_dataset_index(&expected, idx);
+        is_same &= (batch->Header->Dim == 3) && (batch->Header->Sizes[0] == batch_size) &&
+                   (batch->Header->Sizes[1] == shape[0]) && (batch->Header->Sizes[2] == shape[1]);
+        is_same &= !memcmp(batch->Data.Ptr, expected_batch->Data.Ptr, mapped.stride*sizeof(f32));
+    }
+    gz_dataset_close(&mapped);
+
+    bool is_refused = true;
+#ifdef GRAZIE_PLT_LINUX
+    usize file_size = GZ_DATASET_FILE_ALIGNMENT + count*row_elements*sizeof(f32);
+    is_refused &= !test_dataset_file_is_refused(path);
+    is_refused &= (truncate(path, file_size - sizeof(f32)) == 0) && test_dataset_file_is_refused(path);
+    is_refused &= (truncate(path, sizeof(dataset_file_header) - 1) == 0) && test_dataset_file_is_refused(path);
+
+    dataset_file_header header = {0};
+    header.magic = GZ_DATASET_FILE_MAGIC;
+    header.version = GZ_DATASET_FILE_VERSION;
+    header.dtype = dtype_f32;
+    header.dim = 2;
+    header.shape[0] = header.shape[1] = 1u << 31;
+    header.count = 1ull << 4; /* NOTE(abid): Makes 2^66 bytes, which wraps around to zero. */
+    header.data_offset = GZ_DATASET_FILE_ALIGNMENT;
+    FILE *file = fopen(path, "wb");
+    assert(file, "could not write %s", path);
+    is_refused &= (fwrite(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    is_refused &= (truncate(path, file_size) == 0) && test_dataset_file_is_refused(path);
+#endif
+    remove(path);
+    gz_mem_arena_release(&arena);
+
+    bool is_passed = is_same && is_refused;
+    printf("dataset file: %llu rows %s, bad files %s, %s\n", (unsigned long long)count,
+           is_same ? "round trip" : "DIFFER", is_refused ? "refused" : "NOT REFUSED", is_passed ? "ok" : "FAILED");
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Every epoch of a loader goes over every sample exactly once, in order without shuffling, and the
+ *             batches of all sources hold the same samples, whatever the number of producers and slots. */
+i32 test_loader_epochs() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(4));
+    u64 num_samples = 40, batch_size = 8, num_epochs = 4;
+    u64 input_shape[] = {2};
+    u64 target_shape[] = {1};
+    f32 *inputs = gzMemPushArray(&arena, f32, 2*num_samples);
+    f32 *targets = gzMemPushArray(&arena, f32, num_samples);
+    for(u64 idx = 0; idx < num_samples; ++idx) {
+        inputs[2*idx] = (f32)idx;
+        inputs[2*idx + 1] = -(f32)idx;
+        targets[idx] = (f32)idx;
+    }
+    dataset input_set = gz_dataset_build(inputs, 2*num_samples, 1, input_shape, 1, &arena);
+    dataset target_set = gz_dataset_build(targets, num_samples, 1, target_shape, 1, &arena);
+    dataset *sources[] = {&input_set, &target_set};
+    u32 *order = gzMemPushArray(&arena, u32, num_epochs*num_samples);
+    bool *is_seen = gzMemPushArray(&arena, bool, num_samples);
+
+    u32 num_failed = 0;
+    u32 configs[][2] = {{1, 2}, {3, 4}};
+    gzRandSeed(17);
+    for(u32 shuffle = 0; shuffle < 2; ++shuffle) {
+        for(u32 config_idx = 0; config_idx < gz_array_length(configs); ++config_idx) {
+            temp_memory temp = gz_mem_temp_begin(&arena);
+            dataset_loader *loader = gz_loader_create(sources, gz_array_length(sources), batch_size, shuffle,
+                                                      configs[config_idx][1], configs[config_idx][0], &arena);
+            bool is_permutation = (gz_loader_num_batches(loader)*batch_size == num_samples);
+            bool is_matched = true, is_in_order = true;
+            for(u64 epoch = 0; epoch < num_epochs; ++epoch) {
+                memset(is_seen, 0, num_samples*sizeof(bool));
+                for(u64 batch_idx = 0; batch_idx < gz_loader_num_batches(loader); ++batch_idx) {
+                    t32 **batches = gz_loader_next(loader);
+                    f32 *input = (f32 *)batches[0]->Data.Ptr, *target = (f32 *)batches[1]->Data.Ptr;
+                    for(u64 row = 0; row < batch_size; ++row) {
+                        u32 sample = (u32)target[row];
+                        is_matched &= (input[2*row] == target[row]) && (input[2*row + 1] == -target[row]);
+                        is_permutation &= (sample < num_samples) && !is_seen[sample];
+                        if(sample < num_samples) is_seen[sample] = true;
+                        u64 position = batch_idx*batch_size + row;
+                        is_in_order &= (sample == position);
+                        order[epoch*num_samples + position] = sample;
+                    }
+                }
+            }
+            gz_loader_destroy(loader);
+            gz_mem_temp_end(temp);
+
+            /* NOTE(abid): Shuffled epochs are all out of order and differ from each other, bar a 1/40! chance. */
+            bool is_order_ok = is_in_order;
+            if(shuffle) {
+                is_order_ok = !is_in_order;
+                for(u64 epoch = 1; epoch < num_epochs; ++epoch)
+                    is_order_ok &= (memcmp(order, order + epoch*num_samples, num_samples*sizeof(u32)) != 0);
+            }
+            bool is_passed = is_permutation && is_matched && is_order_ok;
+            printf("loader epochs (%s, %u producers, %u slots): %s, %s, %s, %s\n", shuffle ? "shuffled" : "sequential",
+                   configs[config_idx][0], configs[config_idx][1], is_permutation ? "permutations" : "NOT PERMUTATIONS",
+                   is_matched ? "sources matched" : "SOURCES MISMATCHED",
+                   is_order_ok ? (shuffle ? "reshuffled" : "in order") : "WRONG ORDER", is_passed ? "ok" : "FAILED");
+            num_failed += !is_passed;
+        }
+    }
+    gz_mem_arena_release(&arena);
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): A view of a leaf shares the grad of the leaf, so consumers of the view and consumers of the leaf
+ *             accumulate into the same buffer. Every mode must come out with the grads of the serial one. */
+i32 test_backprop_view_of_leaf() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(64));
+    gz_mem_arena_split_meta(&arena, gzMegabyte(4));
+    gzRandSeed(19);
+    u32 leaf_shape[] = {64, 64};
+    u32 view_shape[] = {32, 128};
+    u32 scalar_shape[] = {1};
+    t32 *leaf = gzTensorNormal(leaf_shape, 0, 1, true, &arena);
+    usize num_elements = leaf->Header->StorageNumElements;
+    f32 *expected = gzMemPushArray(&arena, f32, num_elements);
+
+    backprop_mode modes[] = {backprop_serial, backprop_parallel, backprop_deterministic};
+    f32 max_error = 0.f;
+    for(u32 mode_idx = 0; mode_idx < gz_array_length(modes); ++mode_idx) {
+        gz_backprop_set_mode(modes[mode_idx]);
+        for(u32 run = 0; run < 8; ++run) {
+            temp_memory graph = gz_mem_temp_begin(&arena);
+            memset(leaf->Grad.Ptr, 0, num_elements*sizeof(f32));
+            t32 *view = _gzNewView(leaf, view_shape, gz_array_length(view_shape), &arena);
+            t32 *leaf_sum = gzReduceSumAll(gz_sigmoid(leaf, &arena), &arena);
+            t32 *view_sum = gzReduceSumAll(gz_sigmoid(view, &arena), &arena);
+            t32 *other_view_sum = gzReduceSumAll(gz_relu(view, &arena), &arena);
+            t32 *partial = gz_tensor_empty(scalar_shape, f32, false, &arena);
+            gzAdd(leaf_sum, view_sum, partial);
+            t32 *total = gz_tensor_empty(scalar_shape, f32, false, &arena);
+            gzAdd(partial, other_view_sum, total);
+            gz_backprop(total);
+
+            f32 *grad = (f32 *)leaf->Grad.Ptr;
+            for(usize idx = 0; idx < num_elements; ++idx) {
+                if((mode_idx == 0) && (run == 0)) expected[idx] = grad[idx];
+                f32 error = fabsf(grad[idx] - expected[idx]);
+                if(error > max_error) max_error = error;
+            }
+            gz_mem_temp_end(graph);
+        }
+    }
+    gz_backprop_set_mode(backprop_serial);
+    gz_mem_arena_release(&arena);
+
+    bool is_passed = max_error < 1e-6f;
+    printf("view of leaf grads: max error %g, %s\n", max_error, is_passed ? "ok" : "FAILED");
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Without grad mode nothing is recorded, and the linear layers take a fused path that puts the
+ *             bias in first, so the output only matches up to rounding. A checkpointed forward must leave the
+ *             mode as it found it, in either mode. */
+i32 test_inference_mode() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(64));
+    gzRandSeed(29);
+    module *model[] = {
+        gz_module_linear(16, 16, &arena), gz_module_relu(&arena),
+        gz_module_linear(16, 16, &arena), gz_module_relu(&arena),
+        gz_module_linear(16, 16, &arena), gz_module_relu(&arena),
+        gz_module_linear(16, 4, &arena), gz_module_sigmoid(&arena),
+    };
+    u32 input_shape[] = {32, 16};
+    t32 *input = gzTensorNormal(input_shape, 0, 1, false, &arena);
+
+    usize used = arena.Used;
+    t32 *grad_output = gz_module_run_all(model, gz_array_length(model), input, &arena);
+    usize grad_bytes = arena.Used - used;
+    gz_module_run_all_checkpointed(model, gz_array_length(model), 2, input, &arena);
+    bool is_mode_kept = IS_GRAD_PRESERVE();
+
+    GRAD_PRESERVE(false);
+    used = arena.Used;
+    t32 *output = gz_module_run_all(model, gz_array_length(model), input, &arena);
+    usize inference_bytes = arena.Used - used;
+    t32 *checkpointed_output = gz_module_run_all_checkpointed(model, gz_array_length(model), 2, input, &arena);
+    is_mode_kept &= !IS_GRAD_PRESERVE();
+    GRAD_PRESERVE(true);
+
+    bool is_recorded = output->Header->HasAutograd || output->Header->ShouldGrad || output->Grad.Ptr;
+    f32 max_error = 0.f;
+    for(u32 idx = 0; idx < output->Header->StorageNumElements; ++idx) {
+        f32 error = fabsf(((f32 *)output->Data.Ptr)[idx] - ((f32 *)grad_output->Data.Ptr)[idx]);
+        error = fmaxf(error, fabsf(((f32 *)checkpointed_output->Data.Ptr)[idx] - ((f32 *)output->Data.Ptr)[idx]));
+        if(error > max_error) max_error = error;
+    }
+    gz_mem_arena_release(&arena);
+
+    bool is_passed = (max_error < 1e-5f) && !is_recorded && is_mode_kept && (inference_bytes < grad_bytes);
+    printf("inference mode: max error %g, %zu bytes vs %zu in grad mode, %s, mode %s, %s\n", max_error,
+           inference_bytes, grad_bytes, is_recorded ? "RECORDED" : "not recorded", is_mode_kept ? "kept" : "LOST",
+           is_passed ? "ok" : "FAILED");
+
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Every task interns the same layouts, none of which has been seen before, so some of them race to
+ *             add a layout while others look it up. */
+#define TEST_SHAPE_INTERN_LAYOUTS 64
+internal void
+test_shape_intern_task(void *data, u32 task_idx, u32 thread_idx) {
+    (void)thread_idx;
+    u32 **sizes = (u32 **)data + task_idx*TEST_SHAPE_INTERN_LAYOUTS;
+    for(u32 idx = 0; idx < TEST_SHAPE_INTERN_LAYOUTS; ++idx) {
+        u32 shape[] = {idx + 1, 5, 4093};
+        sizes[idx] = __gz_tensor_shape_intern(shape, NULL, gz_array_length(shape))->sizes;
+    }
+}
+
+/* NOTE(abid): The headers of tensors go to the metadata arena and their data to the arena itself, and tensors of
+ *             the same layout share one interned shape, no matter the arena or the thread they were made on. */
+i32 test_meta_arena_and_shape_intern() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(16));
+    gz_mem_arena_split_meta(&arena, gzMegabyte(4));
+    mem_arena other_arena = gzMemArenaAllocate(gzMegabyte(1));
+    u32 shape[] = {4, 8};
+    t32 *tensors[] = {
+        gz_tensor_zero(shape, f32, true, &arena),
+        gz_tensor_zero(shape, f32, true, &arena),
+        gz_tensor_zero(shape, f32, false, &other_arena),
+    };
+
+    bool is_split = true;
+    for(u32 idx = 0; idx < 2; ++idx) {
+        usize header = (usize)tensors[idx]->Header, data = (usize)tensors[idx]->Data.Ptr;
+        usize meta_begin = (usize)arena.Meta->Ptr, begin = (usize)arena.Ptr;
+        is_split &= (header >= meta_begin) && (header < meta_begin + arena.Meta->Used);
+        is_split &= (data >= begin) && (data < begin + arena.Used);
+    }
+    usize used = arena.Used, meta_used = arena.Meta->Used;
+    temp_memory temp = gz_mem_temp_begin(&arena);
+    t32 *sum = gz_tensor_empty(shape, f32, false, &arena);
+    gzAdd(tensors[0], tensors[1], sum);
+    gz_mem_temp_end(temp);
+    is_split &= (arena.Used == used) && (arena.Meta->Used == meta_used);
+
+    bool is_interned = (tensors[0]->Header->Sizes == tensors[1]->Header->Sizes) &&
+                       (tensors[0]->Header->Sizes == tensors[2]->Header->Sizes) &&
+                       (tensors[0]->Header->Strides == tensors[2]->Header->Strides);
+    u32 view_shape[] = {4, 8};
+    t32 *view = _gzNewView(tensors[0], view_shape, gz_array_length(view_shape), &arena);
+    gzTransposeInPlace(view, 0, 1);
+    is_interned &= (view->Header->Sizes != tensors[0]->Header->Sizes) && (view->Header->Sizes[0] == 8) &&
+                   (tensors[0]->Header->Sizes[0] == 4) && (tensors[0]->Header->Strides[0] == 8);
+
+    u32 num_tasks = 8;
+    u32 num_shapes = __gzGLOBALShapeTable.num_shapes;
+    u32 **sizes = gzMemPushArray(&arena, u32 *, num_tasks*TEST_SHAPE_INTERN_LAYOUTS);
+    gz_thread_pool_run(gz_thread_pool_get(), test_shape_intern_task, sizes, num_tasks);
+    bool is_shared = (__gzGLOBALShapeTable.num_shapes == num_shapes + TEST_SHAPE_INTERN_LAYOUTS);
+    for(u32 idx = 0; idx < num_tasks*TEST_SHAPE_INTERN_LAYOUTS; ++idx)
+        is_shared &= (sizes[idx] == sizes[idx % TEST_SHAPE_INTERN_LAYOUTS]);
+    gz_mem_arena_release(&other_arena);
+    gz_mem_arena_release(&arena);
+
+    bool is_passed = is_split && is_interned && is_shared;
+    printf("meta arena and shape interning: %s, %s, %s, %s\n", is_split ? "split" : "NOT SPLIT",
+           is_interned ? "interned" : "NOT INTERNED", is_shared ? "shared across threads" : "NOT SHARED",
+           is_passed ? "ok" : "FAILED");
+
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Data and grads start aligned whatever was pushed before them, and padded storage has a zero tail.
+ *             The params of a model arena form two flat slabs of one layout, back to back in module order. */
+i32 test_tensor_alignment_and_flat_params() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(4));
+    u32 shape[] = {3, 5};
+    bool is_aligned = true;
+    for(u32 idx = 0; idx < 4; ++idx) {
+        t32 *tensor = gz_tensor_empty(shape, f32, true, &arena);
+        is_aligned &= !((usize)tensor->Data.Ptr % GZ_TENSOR_DEFAULT_ALIGNMENT);
+        is_aligned &= !((usize)tensor->Grad.Ptr % GZ_TENSOR_DEFAULT_ALIGNMENT);
+        gzMemPushSize(&arena, 3);
+    }
+    gz_tensor_set_alignment(32, true);
+    t32 *padded = gz_tensor_empty(shape, f32, true, &arena);
+    gz_tensor_set_alignment(GZ_TENSOR_DEFAULT_ALIGNMENT, false);
+    is_aligned &= !((usize)padded->Data.Ptr % 32) && !((usize)padded->Grad.Ptr % 32);
+    is_aligned &= ((u8 *)padded->Grad.Ptr - (u8 *)padded->Data.Ptr) == GZ_TENSOR_VECTOR_BYTES;
+    is_aligned &= (((f32 *)padded->Data.Ptr)[15] == 0.f) && (((f32 *)padded->Grad.Ptr)[15] == 0.f);
+    gz_mem_arena_release(&arena);
+
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    module *model[] = {
+        gz_module_linear(7, 5, model_arena),
+        gz_module_relu(model_arena),
+        gz_module_linear(5, 3, model_arena),
+    };
+    tensor_list params = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
+    bool is_flat = (params.flat.length*sizeof(f32) == model_arena->Used) &&
+                   (model_arena->Grad->Used == model_arena->Used) &&
+                   (params.flat.data == (f32 *)model_arena->Ptr) && (params.flat.grad == (f32 *)model_arena->Grad->Ptr);
+    usize expected_offset = 0;
+    for(usize idx = 0; idx < params.used; ++idx) {
+        t32 *param = params.array[idx];
+        usize data_offset = (usize)((f32 *)param->Data.Ptr - params.flat.data);
+        usize grad_offset = (usize)((f32 *)param->Grad.Ptr - params.flat.grad);
+        is_flat &= (data_offset == expected_offset) && (grad_offset == expected_offset);
+        expected_offset += __gzTensorStorageBytes(param->Header->StorageNumElements*sizeof(f32))/sizeof(f32);
+    }
+    is_flat &= (expected_offset == params.flat.length);
+    tensor_list partial = gz_tensor_list_from_module_list(model, 1, model_arena);
+    is_flat &= (partial.flat.length == 0);
+    gz_mem_arena_release(model_arena);
+
+    bool is_passed = is_aligned && is_flat;
+    printf("tensor alignment and flat params: %s, %s, %s\n", is_aligned ? "aligned" : "NOT ALIGNED",
+           is_flat ? "flat" : "NOT FLAT", is_passed ? "ok" : "FAILED");
+
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): A binary op of two leaves, the shapes being the ones the op sees. A transposed leaf is allocated
+ *             with its last two dims swapped and then transposed in place, so the op sees it non-contiguous. */
+typedef void gradcheck_op(t32 *A, t32 *B, t32 *Result);
+typedef struct {
+    char *name;
+    u32 shapes[2][4];
+    u32 dims[2];
+    bool is_transposed[2];
+    u32 result_shape[4];
+    u32 result_dim;
+} gradcheck_case;
+
+internal f32
+gradcheck_loss(gradcheck_op *op, t32 **leaves, gradcheck_case *test_case, bool should_backprop, mem_arena *arena) {
+    temp_memory temp = gz_mem_temp_begin(arena);
+    t32 *result = _gz_tensor_empty(test_case->result_shape, test_case->result_dim, f32, false, arena);
+    op(leaves[0], leaves[1], result);
+    /* NOTE(abid): Through a sigmoid, so that every element of the result gets a grad of its own. */
+    t32 *loss = gzReduceSumAll(gz_sigmoid(result, arena), arena);
+    f32 value = *(f32 *)loss->Data.Ptr;
+    if(should_backprop) gz_backprop(loss);
+    gz_mem_temp_end(temp);
+
+    return value;
+}
+
+/* NOTE(abid): Central differences of the loss against the grads of a single backprop, for every element of
+ *             both leaves. Everything is in f32, hence the large step. Returns the largest relative error. */
+internal f32
+gradcheck(gradcheck_op *op, gradcheck_case *test_case, mem_arena *arena) {
+    temp_memory temp = gz_mem_temp_begin(arena);
+    t32 *leaves[2];
+    for(u32 leaf_idx = 0; leaf_idx < 2; ++leaf_idx) {
+        u32 dim = test_case->dims[leaf_idx];
+        u32 shape[4];
+        memcpy(shape, test_case->shapes[leaf_idx], dim*sizeof(u32));
+        if(test_case->is_transposed[leaf_idx]) {
+            shape[dim-2] = test_case->shapes[leaf_idx][dim-1];
+            shape[dim-1] = test_case->shapes[leaf_idx][dim-2];
+        }
+        leaves[leaf_idx] = _gzTensorNormal(shape, dim, 0, 0.5, true, arena);
+        if(test_case->is_transposed[leaf_idx]) gzTransposeInPlace(leaves[leaf_idx], -1, -2);
+        memset(leaves[leaf_idx]->Grad.Ptr, 0, leaves[leaf_idx]->Header->StorageNumElements*sizeof(f32));
+    }
+    gradcheck_loss(op, leaves, test_case, true, arena);
+
+    f32 step = 1e-2f;
+    f32 max_error = 0.f;
+    for(u32 leaf_idx = 0; leaf_idx < 2; ++leaf_idx) {
+        f32 *data = (f32 *)leaves[leaf_idx]->Data.Ptr;
+        f32 *grad = (f32 *)leaves[leaf_idx]->Grad.Ptr;
+        for(u32 idx = 0; idx < leaves[leaf_idx]->Header->StorageNumElements; ++idx) {
+            f32 value = data[idx];
+            data[idx] = value + step;
+            f32 loss_plus = gradcheck_loss(op, leaves, test_case, false, arena);
+            data[idx] = value - step;
+            f32 loss_minus = gradcheck_loss(op, leaves, test_case, false, arena);
+            data[idx] = value;
+
+            f32 numerical = (loss_plus - loss_minus)/(2.f*step);
+            f32 error = fabsf(numerical - grad[idx])/fmaxf(1e-2f, fabsf(numerical) + fabsf(grad[idx]));
+            if(error > max_error) max_error = error;
+        }
+    }
+    gz_mem_temp_end(temp);
+
+    return max_error;
+}
+
+/* NOTE(abid): Both operands of a matmul in every layout its backward has to handle. A vector operand is
+ *             treated as a column on the right and as a row on the left, and the batch dims of the smaller
+ *             operand are broadcast. */
+i32 test_gradcheck_matmul() {
+    gradcheck_case cases[] = {
+        { "matrix",               {{3, 4}, {4, 5}},       {2, 2}, {false, false}, {3, 5},    2 },
+        { "transposed",           {{3, 4}, {4, 5}},       {2, 2}, {true, true},   {3, 5},    2 },
+        { "transposed left",      {{2, 3, 4}, {2, 4, 5}}, {3, 3}, {true, false},  {2, 3, 5}, 3 },
+        { "vector right",         {{3, 4}, {4}},          {2, 1}, {false, false}, {3, 1},    2 },
+        { "vector left",          {{4}, {4, 5}},          {1, 2}, {false, false}, {1, 5},    2 },
+        { "batched",              {{2, 3, 4}, {2, 4, 5}}, {3, 3}, {false, false}, {2, 3, 5}, 3 },
+        { "broadcast batch",      {{2, 3, 4}, {4, 5}},    {3, 2}, {false, false}, {2, 3, 5}, 3 },
+        { "broadcast unit batch", {{1, 3, 4}, {2, 4, 5}}, {3, 3}, {false, false}, {2, 3, 5}, 3 },
+    };
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(16));
+    gzRandSeed(30);
+
+    u32 num_failed = 0;
+    for(u32 case_idx = 0; case_idx < gz_array_length(cases); ++case_idx) {
+        f32 error = gradcheck(gzMatMul, cases + case_idx, &arena);
+        bool is_passed = error < 2e-2f;
+        printf("gradcheck matmul (%s): max relative error %g, %s\n", cases[case_idx].name, error,
+               is_passed ? "ok" : "FAILED");
+        num_failed += !is_passed;
+    }
+    gz_mem_arena_release(&arena);
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): Broadcast of the leading and of a middle dim, of one operand or of both at once, where the grad
+ *             of a broadcast operand is the sum over the dims it was broadcast along. */
+i32 test_gradcheck_broadcast() {
+    gradcheck_case cases[] = {
+        { "leading",            {{3, 4, 5}, {4, 5}},    {3, 2}, {false, false}, {3, 4, 5}, 3 },
+        { "unit leading",       {{1, 4, 5}, {3, 4, 5}}, {3, 3}, {false, false}, {3, 4, 5}, 3 },
+        { "middle",             {{3, 4, 5}, {3, 1, 5}}, {3, 3}, {false, false}, {3, 4, 5}, 3 },
+        { "leading and middle", {{3, 1, 5}, {4, 5}},    {3, 2}, {false, false}, {3, 4, 5}, 3 },
+        { "non-contiguous",     {{3, 4, 5}, {1, 4, 5}}, {3, 3}, {false, true},  {3, 4, 5}, 3 },
+    };
+    gradcheck_op *ops[] = {gzAdd, gzMul};
+    char *op_names[] = {"add", "mul"};
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(16));
+    gzRandSeed(31);
+
+    u32 num_failed = 0;
+    for(u32 op_idx = 0; op_idx < gz_array_length(ops); ++op_idx) {
+        for(u32 case_idx = 0; case_idx < gz_array_length(cases); ++case_idx) {
+            f32 error = gradcheck(ops[op_idx], cases + case_idx, &arena);
+            bool is_passed = error < 2e-2f;
+            printf("gradcheck broadcast %s (%s): max relative error %g, %s\n", op_names[op_idx],
+                   cases[case_idx].name, error, is_passed ? "ok" : "FAILED");
+            num_failed += !is_passed;
+        }
+    }
+    gz_mem_arena_release(&arena);
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): Backprop of several roots at once against separate backprops of each root, on two heads over a
+ *             shared trunk. A root given twice is seeded twice, and a root that also feeds another root gets
+ *             its seed on top of the grad that comes down from the other. */
+i32 test_backprop_many() {
+    mem_arena arena = gzMemArenaAllocate(gzMegabyte(16));
+    gzRandSeed(33);
+    u32 input_shape[] = {16, 12}, trunk_shape[] = {12, 8}, head_shape[] = {8, 4};
+    u32 hidden_shape[] = {16, 8}, output_shape[] = {16, 4}, loss_shape[] = {1};
+    t32 *input = gzTensorNormal(input_shape, 0, 1, true, &arena);
+    t32 *trunk = gzTensorNormal(trunk_shape, 0, 0.5, true, &arena);
+    t32 *heads[] = {
+        gzTensorNormal(head_shape, 0, 0.5, true, &arena),
+        gzTensorNormal(head_shape, 0, 0.5, true, &arena),
+    };
+    t32 *leaves[] = {input, trunk, heads[0], heads[1]};
+
+    t32 *hidden = gz_tensor_empty(hidden_shape, f32, false, &arena);
+    gzMatMul(input, trunk, hidden);
+    t32 *features = gz_sigmoid(hidden, &arena);
+    t32 *target = gz_tensor_zero(output_shape, f32, false, &arena);
+    t32 *losses[2];
+    for(u32 head_idx = 0; head_idx < 2; ++head_idx) {
+        t32 *output = gz_tensor_empty(output_shape, f32, false, &arena);
+        gzMatMul(features, heads[head_idx], output);
+        losses[head_idx] = gz_loss_binary_cross_entropy(gz_sigmoid(output, &arena), target, reduce_mean, &arena);
+    }
+    t32 *total_loss = gz_tensor_empty(loss_shape, f32, false, &arena);
+    gzAdd(losses[0], losses[1], total_loss);
+
+    usize num_grads = 0;
+    for(u32 idx = 0; idx < gz_array_length(leaves); ++idx) num_grads += leaves[idx]->Header->StorageNumElements;
+    f32 *expected = gzMemPushArray(&arena, f32, num_grads);
+    f32 *grads = gzMemPushArray(&arena, f32, num_grads);
+
+    backprop_mode modes[] = {backprop_serial, backprop_parallel, backprop_deterministic};
+    u32 num_failed = 0;
+    for(u32 mode_idx = 0; mode_idx < gz_array_length(modes); ++mode_idx) {
+        gz_backprop_set_mode(modes[mode_idx]);
+        for(u32 variant = 0; variant < 3; ++variant) {
+            for(u32 pass = 0; pass < 2; ++pass) {
+                for(u32 idx = 0; idx < gz_array_length(leaves); ++idx)
+                    memset(leaves[idx]->Grad.Ptr, 0, leaves[idx]->Header->StorageNumElements*sizeof(f32));
+
+                if(pass == 0) {
+                    /* NOTE(abid): Every variant adds up to the first loss twice and the second once, except the
+                     *             last one, where the total loss adds one more of each. */
+                    gz_backprop(losses[0]);
+                    gz_backprop(losses[0]);
+                    gz_backprop(losses[1]);
+                    if(variant == 2) {
+                        gz_backprop(losses[0]);
+                        gz_backprop(losses[1]);
+                    }
+                } else if(variant == 0) {
+                    f32 weights[] = {2.f, 1.f};
+                    gz_backprop_many(losses, weights, 2);
+                } else if(variant == 1) {
+                    t32 *roots[] = {losses[0], losses[1], losses[0]};
+                    gz_backprop_many(roots, NULL, gz_array_length(roots));
+                } else {
+                    t32 *roots[] = {losses[0], total_loss, losses[1], losses[0]};
+                    gz_backprop_many(roots, NULL, gz_array_length(roots));
+                }
+
+                f32 *dest = pass ? grads : expected;
+                for(u32 idx = 0, grad_idx = 0; idx < gz_array_length(leaves); ++idx) {
+                    memcpy(dest + grad_idx, leaves[idx]->Grad.Ptr, leaves[idx]->Header->StorageNumElements*sizeof(f32));
+                    grad_idx += leaves[idx]->Header->StorageNumElements;
+                }
+            }
+
+            f32 max_error = 0.f;
+            for(usize idx = 0; idx < num_grads; ++idx) {
+                f32 error = fabsf(grads[idx] - expected[idx])/(fabsf(expected[idx]) + 1e-6f);
+                if(error > max_error) max_error = error;
+            }
+            bool is_passed = max_error < 1e-4f;
+            printf("backprop many (variant %u, mode %u): max relative error %g, %s\n", variant, mode_idx, max_error,
+                   is_passed ? "ok" : "FAILED");
+            num_failed += !is_passed;
+        }
+    }
+    gz_backprop_set_mode(backprop_serial);
+    gz_mem_arena_release(&arena);
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): The grads of a model run through checkpoints must be the ones of the plain run, in every backprop
+ *             mode. The input needs no grad, as with a batch of data, so the first segment is only reached
+ *             through its parameters. */
+i32 test_checkpoint_grads() {
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+    gzRandSeed(7);
+    module *model[] = {
+        gz_module_linear(4, 8, model_arena),
+        gz_module_relu(model_arena),
+        gz_module_linear(8, 8, model_arena),
+        gz_module_sigmoid(model_arena),
+        gz_module_linear(8, 1, model_arena),
+        gz_module_sigmoid(model_arena),
+    };
+    tensor_list params = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
+    u32 input_shape[] = {5, 4};
+    u32 target_shape[] = {5, 1};
+    t32 *input = gzTensorNormal(input_shape, 0, 1, false, model_arena);
+    f32 target_data[] = {0.f, 1.f, 1.f, 0.f, 1.f};
+    t32 *target = gz_tensor_from_array(target_shape, target_data, f32, false, model_arena);
+
+    usize num_grads = 0;
+    for(usize idx = 0; idx < params.used; ++idx) num_grads += params.array[idx]->Header->StorageNumElements;
+    f32 *expected = gzMemPushArray(model_arena, f32, num_grads);
+
+    backprop_mode modes[] = {backprop_serial, backprop_parallel, backprop_deterministic};
+    f32 max_error = 0.f;
+    for(u32 mode_idx = 0; mode_idx < gz_array_length(modes); ++mode_idx) {
+        gz_backprop_set_mode(modes[mode_idx]);
+        for(u32 is_checkpointed = 0; is_checkpointed < 2; ++is_checkpointed) {
+            gz_grad_zero(params);
+            t32 *y_hat = is_checkpointed
+                ? gz_module_run_all_checkpointed(model, gz_array_length(model), 2, input, &step_arena)
+                : gz_module_run_all(model, gz_array_length(model), input, &step_arena);
+            gz_backprop(gz_loss_binary_cross_entropy(y_hat, target, reduce_mean, &step_arena));
+
+            usize grad_idx = 0;
+            for(usize idx = 0; idx < params.used; ++idx) {
+                f32 *grad = (f32 *)params.array[idx]->Grad.Ptr;
+                for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++grad_idx) {
+                    if((mode_idx == 0) && !is_checkpointed) expected[grad_idx] = grad[jdx];
+                    f32 error = fabsf(grad[jdx] - expected[grad_idx])/(fabsf(expected[grad_idx]) + 1e-6f);
+                    if(error > max_error) max_error = error;
+                }
+            }
+            gz_mem_arena_reset(&step_arena);
+        }
+    }
+    gz_backprop_set_mode(backprop_serial);
+
+    bool is_passed = max_error < 1e-4f;
+    printf("checkpoint grads: max relative error %g, %s\n", max_error, is_passed ? "ok" : "FAILED");
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Plain SGD, momentum and nesterov momentum, all with decoupled weight decay, against a scalar
+ *             reference in f64. */
+i32 test_optim_sgd() {
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    gzRandSeed(13);
+    module *model[] = { gz_module_linear(6, 5, model_arena), gz_module_linear(5, 3, model_arena) };
+    tensor_list params = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
+
+    usize num_params = 0;
+    for(usize idx = 0; idx < params.used; ++idx) num_params += params.array[idx]->Header->StorageNumElements;
+    f32 *initial = gzMemPushArray(model_arena, f32, num_params);
+    f64 *expected = gzMemPushArray(model_arena, f64, num_params);
+    f64 *velocity = gzMemPushArray(model_arena, f64, num_params);
+    for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+        f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+        for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx) initial[param_idx++] = data[jdx];
+    }
+
+    char *names[] = {"sgd", "momentum", "nesterov"};
+    f32 lr = 0.05f, momentum = 0.9f, weight_decay = 0.01f;
+    u32 num_steps = 500;
+    u32 num_failed = 0;
+    for(u32 variant = 0; variant < gz_array_length(names); ++variant) {
+        f32 variant_momentum = variant ? momentum : 0.f;
+        bool is_nesterov = variant == 2;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                data[jdx] = initial[param_idx];
+                expected[param_idx] = initial[param_idx];
+                velocity[param_idx] = 0.0;
+            }
+        }
+        optimizer *optim = gz_optim_sgd_create(params, lr, variant_momentum, weight_decay, is_nesterov, model_arena);
+
+        for(u32 step = 1; step <= num_steps; ++step) {
+            for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+                f32 *grad = (f32 *)params.array[idx]->Grad.Ptr;
+                for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                    grad[jdx] = 0.1f*sinf((f32)(3*param_idx + step));
+
+                    f64 g = grad[jdx], update = g;
+                    if(variant) {
+                        velocity[param_idx] = variant_momentum*velocity[param_idx] + g;
+                        update = is_nesterov ? g + variant_momentum*velocity[param_idx] : velocity[param_idx];
+                    }
+                    expected[param_idx] = (1.0 - (f64)lr*weight_decay)*expected[param_idx] - lr*update;
+                }
+            }
+            gz_optim_step(optim);
+        }
+
+        f64 max_error = 0.0, max_distance = 0.0;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                max_error = fmax(max_error, fabs(data[jdx] - expected[param_idx]));
+                max_distance = fmax(max_distance, fabs(expected[param_idx] - initial[param_idx]));
+            }
+        }
+        f64 error = max_error/max_distance;
+        bool is_passed = error < 1e-3;
+        printf("optim %s: relative error %g, %s\n", names[variant], error, is_passed ? "ok" : "FAILED");
+        num_failed += !is_passed;
+    }
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): Adam and AdamW against a scalar reference in f64, with the first moment in f32 and in bf16. A
+ *             spike in the first step blows up the second moment, which must then decay under the small grads
+ *             that follow, or the steps would stay stunted for good. */
+i32 test_optim_adam() {
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    gzRandSeed(11);
+    module *model[] = { gz_module_linear(6, 5, model_arena), gz_module_linear(5, 3, model_arena) };
+    tensor_list params = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
+    assert(params.flat.length, "the test indexes the optimizer state by the flat offset");
+
+    usize num_params = 0;
+    for(usize idx = 0; idx < params.used; ++idx) num_params += params.array[idx]->Header->StorageNumElements;
+    f32 *initial = gzMemPushArray(model_arena, f32, num_params);
+    f64 *expected = gzMemPushArray(model_arena, f64, num_params);
+    f64 *moment1 = gzMemPushArray(model_arena, f64, num_params);
+    f64 *moment2 = gzMemPushArray(model_arena, f64, num_params);
+    for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+        f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+        for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx) initial[param_idx++] = data[jdx];
+    }
+
+    f32 lr = 0.01f, beta1 = 0.9f, beta2 = 0.999f, eps = 1e-8f, weight_decay = 0.05f;
+    u32 num_steps = 3000;
+    u32 num_failed = 0;
+    for(u32 variant = 0; variant < 4; ++variant) {
+        bool is_adamw = variant & 1;
+        bool is_bf16 = variant & 2;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                data[jdx] = initial[param_idx];
+                expected[param_idx] = initial[param_idx];
+                moment1[param_idx] = moment2[param_idx] = 0.0;
+            }
+        }
+        optimizer *optim = is_adamw
+            ? gz_optim_adamw_create(params, lr, beta1, beta2, eps, weight_decay, is_bf16, model_arena)
+            : gz_optim_adam_create(params, lr, beta1, beta2, eps, weight_decay, is_bf16, model_arena);
+
+        for(u32 step = 1; step <= num_steps; ++step) {
+            f64 bias_correction1 = 1.0 - pow(beta1, step);
+            f64 bias_correction2 = 1.0 - pow(beta2, step);
+            for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+                f32 *grad = (f32 *)params.array[idx]->Grad.Ptr;
+                for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                    grad[jdx] = (step == 1) ? 100.f : 0.01f*sinf((f32)(param_idx + step));
+
+                    f64 g = grad[jdx], p = expected[param_idx];
+                    if(is_adamw) p *= 1.0 - (f64)lr*weight_decay;
+                    else g += weight_decay*p;
+                    moment1[param_idx] = beta1*moment1[param_idx] + (1.0 - beta1)*g;
+                    moment2[param_idx] = beta2*moment2[param_idx] + (1.0 - beta2)*g*g;
+                    expected[param_idx] = p - lr*(moment1[param_idx]/bias_correction1)/
+                                          (sqrt(moment2[param_idx]/bias_correction2) + eps);
+                }
+            }
+            gz_optim_step(optim);
+        }
+
+        /* NOTE(abid): Errors are relative to how far the reference moved away from the initial params. */
+        f64 max_error = 0.0, max_distance = 0.0, max_moment2_error = 0.0;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+            usize state_offset = (usize)(data - params.flat.data);
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                max_error = fmax(max_error, fabs(data[jdx] - expected[param_idx]));
+                max_distance = fmax(max_distance, fabs(expected[param_idx] - initial[param_idx]));
+                f64 moment2_error = fabs(optim->moment2[state_offset + jdx] - moment2[param_idx])/moment2[param_idx];
+                max_moment2_error = fmax(max_moment2_error, moment2_error);
+            }
+        }
+        f64 error = max_error/max_distance;
+        bool is_passed = (error < (is_bf16 ? 2e-2 : 1e-3)) && (max_moment2_error < 1e-3);
+        printf("optim %s (%s moment1): relative error %g, moment2 error %g, %s\n", is_adamw ? "adamw" : "adam",
+               is_bf16 ? "bf16" : "f32", error, max_moment2_error, is_passed ? "ok" : "FAILED");
+        num_failed += !is_passed;
+    }
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): Global-norm clipping on SGD with momentum against a scalar reference in f64, with the grads
+ *             above the max norm on every other step. A step with a non-finite grad must leave everything as
+ *             it was. */
+i32 test_optim_clip() {
+    mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+    gzRandSeed(17);
+    module *model[] = { gz_module_linear(6, 5, model_arena), gz_module_linear(5, 3, model_arena) };
+    tensor_list params = gz_tensor_list_from_module_list(model, gz_array_length(model), model_arena);
+
+    usize num_params = 0;
+    for(usize idx = 0; idx < params.used; ++idx) num_params += params.array[idx]->Header->StorageNumElements;
+    f32 *initial = gzMemPushArray(model_arena, f32, num_params);
+    f64 *expected = gzMemPushArray(model_arena, f64, num_params);
+    f64 *velocity = gzMemPushArray(model_arena, f64, num_params);
+    for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+        f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+        for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+            initial[param_idx] = data[jdx];
+            expected[param_idx] = data[jdx];
+            velocity[param_idx] = 0.0;
+        }
+    }
+
+    f32 lr = 0.05f, momentum = 0.9f, max_norm = 0.5f;
+    optimizer *optim = gz_optim_sgd_create(params, lr, momentum, 0.f, false, model_arena);
+    gz_optim_set_clip(optim, max_norm);
+
+    u32 num_steps = 200;
+    f64 max_norm_error = 0.0;
+    for(u32 step = 1; step <= num_steps; ++step) {
+        f32 magnitude = (step & 1) ? 1.f : 0.01f;
+        f64 sum_squares = 0.0;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *grad = (f32 *)params.array[idx]->Grad.Ptr;
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                grad[jdx] = magnitude*sinf((f32)(5*param_idx + step));
+                sum_squares += (f64)grad[jdx]*grad[jdx];
+            }
+        }
+        f64 norm = sqrt(sum_squares);
+        f64 scale = (norm > max_norm) ? max_norm/(norm + 1e-6) : 1.0;
+        for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+            f32 *grad = (f32 *)params.array[idx]->Grad.Ptr;
+            for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+                velocity[param_idx] = momentum*velocity[param_idx] + scale*grad[jdx];
+                expected[param_idx] -= lr*velocity[param_idx];
+            }
+        }
+        gz_optim_step(optim);
+        max_norm_error = fmax(max_norm_error, fabs(optim->last_grad_norm - norm)/norm);
+    }
+
+    f64 max_error = 0.0, max_distance = 0.0;
+    for(usize idx = 0, param_idx = 0; idx < params.used; ++idx) {
+        f32 *data = (f32 *)params.array[idx]->Data.Ptr;
+        for(usize jdx = 0; jdx < params.array[idx]->Header->StorageNumElements; ++jdx, ++param_idx) {
+            max_error = fmax(max_error, fabs(data[jdx] - expected[param_idx]));
+            max_distance = fmax(max_distance, fabs(expected[param_idx] - initial[param_idx]));
+        }
+    }
+    f64 error = max_error/max_distance;
+
+    ((f32 *)params.array[0]->Grad.Ptr)[0] = NAN;
+    f32 first_param = ((f32 *)params.array[0]->Data.Ptr)[0];
+    bool is_stepped = gz_optim_step(optim);
+    bool is_skipped = !is_stepped && (optim->num_skipped_steps == 1) &&
+                      (((f32 *)params.array[0]->Data.Ptr)[0] == first_param);
+
+    bool is_passed = (error < 1e-3) && (max_norm_error < 1e-5) && is_skipped;
+    printf("optim clip: relative error %g, norm error %g, non-finite step %s, %s\n", error, max_norm_error,
+           is_skipped ? "skipped" : "NOT SKIPPED", is_passed ? "ok" : "FAILED");
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Replaying a memory plan only moves buffers around, so every step has to match the same step
+ *             without a plan bit for bit, the capture included. Both models take an optimizer step after each
+ *             backprop, so that the replays run on parameters the capture never saw. */
+i32 test_mem_plan_replay() {
+    u32 input_shape[] = {8, 3};
+    u32 target_shape[] = {8, 1};
+    mem_arena data_arena = gzMemArenaAllocate(gzMegabyte(1));
+    gzRandSeed(7);
+    t32 *input = gzTensorNormal(input_shape, 0, 1, false, &data_arena);
+    t32 *target = gz_tensor_zero(target_shape, f32, false, &data_arena);
+    for(u32 idx = 0; idx < target_shape[0]; idx += 2) ((f32 *)target->Data.Ptr)[idx] = 1.f;
+
+    mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+    mem_arena plan_arena = gzMemArenaAllocate(gzMegabyte(16));
+    mem_plan *plan = gz_mem_plan_allocate(1024, &plan_arena);
+    mem_arena *model_arenas[2];
+    module *models[2][6];
+    tensor_list params[2];
+    optimizer *optims[2];
+    for(u32 model_idx = 0; model_idx < 2; ++model_idx) {
+        mem_arena *model_arena = model_arenas[model_idx] = gz_model_arena_create(gzMegabyte(16));
+        module **model = models[model_idx];
+        model[0] = gz_module_linear(3, 16, model_arena);
+        model[1] = gz_module_relu(model_arena);
+        model[2] = gz_module_linear(16, 8, model_arena);
+        model[3] = gz_module_sigmoid(model_arena);
+        model[4] = gz_module_linear(8, 1, model_arena);
+        model[5] = gz_module_sigmoid(model_arena);
+        params[model_idx] = gz_tensor_list_from_module_list(model, 6, model_arena);
+        optims[model_idx] = gz_optim_sgd_create(params[model_idx], 0.1f, 0.9f, 0.f, false, model_arena);
+        gz_grad_zero(params[model_idx]);
+    }
+    memcpy(params[1].flat.data, params[0].flat.data, params[0].flat.length*sizeof(f32));
+
+    u32 num_steps = 4;
+    u32 num_mismatches = 0;
+    for(u32 step = 0; step < num_steps; ++step) {
+        t32 *loss = gz_loss_binary_cross_entropy(gz_module_run_all(models[0], 6, input, &step_arena), target,
+                                                 reduce_mean, &step_arena);
+        f32 expected_loss = *(f32 *)loss->Data.Ptr;
+        gz_backprop(loss);
+        gz_optim_step(optims[0]);
+        gz_grad_zero(params[0]);
+        gz_mem_arena_reset(&step_arena);
+
+        if(step == 0) gz_mem_plan_capture_begin(plan, &step_arena);
+        else gz_mem_plan_replay_begin(plan);
+        loss = gz_loss_binary_cross_entropy(gz_module_run_all(models[1], 6, input, &step_arena), target,
+                                            reduce_mean, &step_arena);
+        if(step == 0) gz_mem_plan_capture_end(plan, loss);
+        gz_backprop(loss);
+        f32 planned_loss = *(f32 *)loss->Data.Ptr;
+        if(step != 0) gz_mem_plan_replay_end(plan);
+        gz_optim_step(optims[1]);
+        gz_grad_zero(params[1]);
+        gz_mem_arena_reset(&step_arena);
+
+        num_mismatches += (memcmp(&expected_loss, &planned_loss, sizeof(f32)) != 0);
+        num_mismatches += (memcmp(params[0].flat.data, params[1].flat.data, params[0].flat.length*sizeof(f32)) != 0);
+    }
+    gz_mem_arena_release(model_arenas[0]);
+    gz_mem_arena_release(model_arenas[1]);
+    gz_mem_arena_release(&plan_arena);
+    gz_mem_arena_release(&step_arena);
+    gz_mem_arena_release(&data_arena);
+
+    bool is_passed = num_mismatches == 0;
+    printf("memory plan replay: %u steps, %u mismatches, %s\n", num_steps, num_mismatches, is_passed ? "ok" : "FAILED");
+
+    return is_passed ? 0 : 1;
+}
+
+/* NOTE(abid): Stepping from the grad hooks during backprop has to end up with the parameters of stepping after
+ *             it, in every backprop mode. The updates of the hooks must not change a parameter while a backward op
+ *             still reads it, e.g. the matmul that passes the grad on to the input of a layer. */
+i32 test_optim_attach_to_backprop() {
+    u32 input_shape[] = {16, 8};
+    u32 target_shape[] = {16, 1};
+    mem_arena data_arena = gzMemArenaAllocate(gzMegabyte(1));
+    gzRandSeed(23);
+    t32 *input = gzTensorNormal(input_shape, 0, 1, false, &data_arena);
+    t32 *target = gz_tensor_zero(target_shape, f32, false, &data_arena);
+    for(u32 idx = 0; idx < target_shape[0]; idx += 2) ((f32 *)target->Data.Ptr)[idx] = 1.f;
+
+    backprop_mode modes[] = {backprop_serial, backprop_parallel, backprop_deterministic};
+    u32 num_failed = 0;
+    for(u32 mode_idx = 0; mode_idx < gz_array_length(modes); ++mode_idx) {
+        for(u32 is_adamw = 0; is_adamw < 2; ++is_adamw) {
+            gz_backprop_set_mode(modes[mode_idx]);
+            mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+            mem_arena *model_arenas[2];
+            module *models[2][6];
+            tensor_list params[2];
+            optimizer *optims[2];
+            for(u32 model_idx = 0; model_idx < 2; ++model_idx) {
+                mem_arena *model_arena = model_arenas[model_idx] = gz_model_arena_create(gzMegabyte(16));
+                module **model = models[model_idx];
+                model[0] = gz_module_linear(8, 64, model_arena);
+                model[1] = gz_module_relu(model_arena);
+                model[2] = gz_module_linear(64, 32, model_arena);
+                model[3] = gz_module_sigmoid(model_arena);
+                model[4] = gz_module_linear(32, 1, model_arena);
+                model[5] = gz_module_sigmoid(model_arena);
+                params[model_idx] = gz_tensor_list_from_module_list(model, 6, model_arena);
+                optims[model_idx] = is_adamw
+                    ? gz_optim_adamw_create(params[model_idx], 0.01f, 0.9f, 0.999f, 1e-8f, 0.01f, false, model_arena)
+                    : gz_optim_sgd_create(params[model_idx], 0.05f, 0.9f, 0.01f, true, model_arena);
+                gz_grad_zero(params[model_idx]);
+            }
+            memcpy(params[1].flat.data, params[0].flat.data, params[0].flat.length*sizeof(f32));
+            gz_optim_attach_to_backprop(optims[1], model_arenas[1]);
+
+            for(u32 step = 0; step < 20; ++step) {
+                for(u32 model_idx = 0; model_idx < 2; ++model_idx) {
+                    t32 *y_hat = gz_module_run_all(models[model_idx], 6, input, &step_arena);
+                    gz_backprop(gz_loss_binary_cross_entropy(y_hat, target, reduce_mean, &step_arena));
+                    if(model_idx == 0) {
+                        gz_optim_step(optims[0]);
+                        gz_grad_zero(params[0]);
+                    }
+                    gz_mem_arena_reset(&step_arena);
+                }
+            }
+
+            f32 max_error = 0.f;
+            bool are_grads_zero = true;
+            for(usize idx = 0; idx < params[0].flat.length; ++idx) {
+                f32 error = fabsf(params[0].flat.data[idx] - params[1].flat.data[idx]);
+                if(error > max_error) max_error = error;
+                are_grads_zero &= (params[1].flat.grad[idx] == 0.f);
+            }
+            gz_optim_detach_from_backprop(optims[1]);
+            gz_mem_arena_release(&step_arena);
+            gz_mem_arena_release(model_arenas[0]);
+            gz_mem_arena_release(model_arenas[1]);
+
+            bool is_passed = (max_error < 1e-6f) && are_grads_zero;
+            printf("optim attached (%s, mode %u): max error %g, grads %s, %s\n", is_adamw ? "adamw" : "sgd",
+                   mode_idx, max_error, are_grads_zero ? "zeroed" : "NOT ZEROED", is_passed ? "ok" : "FAILED");
+            num_failed += !is_passed;
+        }
+    }
+    gz_backprop_set_mode(backprop_serial);
+    gz_mem_arena_release(&data_arena);
+
+    return num_failed ? 1 : 0;
+}
+
+/* NOTE(abid): Data-parallel steps against plain steps of a single model on the same batches. The rows do not
+ *             split evenly among 3 or 4 replicas, and with 16 some replicas get no rows at all. The grads are
+ *             summed in another order, hence the tolerance. */
+i32 test_data_parallel() {
+    u32 num_rows = 11;
+    u32 input_shape[] = {num_rows, 2};
+    u32 target_shape[] = {num_rows, 1};
+    mem_arena data_arena = gzMemArenaAllocate(gzMegabyte(1));
+    t32 *input = gz_tensor_zero(input_shape, f32, false, &data_arena);
+    t32 *target = gz_tensor_zero(target_shape, f32, false, &data_arena);
+    for(u32 idx = 0; idx < num_rows; ++idx) {
+        u32 a = idx & 1, b = (idx >> 1) & 1;
+        ((f32 *)input->Data.Ptr)[2*idx] = (f32)a;
+        ((f32 *)input->Data.Ptr)[2*idx + 1] = (f32)b;
+        ((f32 *)target->Data.Ptr)[idx] = (f32)(a ^ b);
+    }
+
+    u32 replica_counts[] = {1, 3, 4, 16};
+    u32 num_failed = 0;
+    for(u32 count_idx = 0; count_idx < gz_array_length(replica_counts); ++count_idx) {
+        mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+        mem_arena *model_arenas[2];
+        module *models[2][6];
+        tensor_list params[2];
+        optimizer *optims[2];
+        for(u32 model_idx = 0; model_idx < 2; ++model_idx) {
+            mem_arena *model_arena = model_arenas[model_idx] = gz_model_arena_create(gzMegabyte(16));
+            module **model = models[model_idx];
+            model[0] = gz_module_linear(2, 64, model_arena);
+            model[1] = gz_module_relu(model_arena);
+            model[2] = gz_module_linear(64, 32, model_arena);
+            model[3] = gz_module_relu(model_arena);
+            model[4] = gz_module_linear(32, 1, model_arena);
+            model[5] = gz_module_sigmoid(model_arena);
+            params[model_idx] = gz_tensor_list_from_module_list(model, 6, model_arena);
+            optims[model_idx] = gz_optim_adam_create(params[model_idx], 0.01f, 0.9f, 0.999f, 1e-8f, 0.f, false,
+                                                     model_arena);
+        }
+        memcpy(params[1].flat.data, params[0].flat.data, params[0].flat.length*sizeof(f32));
+        gz_grad_zero(params[0]);
+        data_parallel *trainer = gz_data_parallel_create(models[1], 6, model_arenas[1], optims[1],
+                                                         replica_counts[count_idx], gz_loss_binary_cross_entropy,
+                                                         reduce_mean, gzMegabyte(64));
+
+        f32 loss = 0.f, parallel_loss = 0.f;
+        for(u32 step = 0; step < 30; ++step) {
+            t32 *y_hat = gz_module_run_all(models[0], 6, input, &step_arena);
+            t32 *loss_tensor = gz_loss_binary_cross_entropy(y_hat, target, reduce_mean, &step_arena);
+            loss = *(f32 *)loss_tensor->Data.Ptr;
+            gz_backprop(loss_tensor);
+            gz_optim_step(optims[0]);
+            gz_grad_zero(params[0]);
+            gz_mem_arena_reset(&step_arena);
+
+            parallel_loss = gz_data_parallel_step(trainer, input, target);
+        }
+
+        /* NOTE(abid): Every replica must have been handed the stepped parameters, and be left without grads. */
+        f32 max_error = fabsf(loss - parallel_loss);
+        bool are_grads_zero = true;
+        for(u32 replica_idx = 0; replica_idx < trainer->num_replicas; ++replica_idx) {
+            tensor_list replica_params = trainer->replicas[replica_idx].params;
+            for(usize idx = 0; idx < params[0].flat.length; ++idx) {
+                f32 error = fabsf(params[0].flat.data[idx] - replica_params.flat.data[idx]);
+                if(error > max_error) max_error = error;
+                are_grads_zero &= (replica_params.flat.grad[idx] == 0.f);
+            }
+        }
+        gz_data_parallel_destroy(trainer);
+        gz_mem_arena_release(&step_arena);
+        gz_mem_arena_release(model_arenas[0]);
+        gz_mem_arena_release(model_arenas[1]);
+
+        bool is_passed = (max_error < 1e-4f) && are_grads_zero;
+        printf("data parallel (%u replicas, %u rows): max error %g, grads %s, %s\n", replica_counts[count_idx],
+               num_rows, max_error, are_grads_zero ? "zeroed" : "NOT ZEROED", is_passed ? "ok" : "FAILED");
+        num_failed += !is_passed;
+    }
+    gz_mem_arena_release(&data_arena);
+
+    return num_failed ? 1 : 0;
+}
+
+#ifdef GRAZIE_PLT_LINUX
+/* NOTE(abid): Multi-process steps against plain steps of a single model, like `test_data_parallel`. Only this
+ *             process gets back from `gz_multi_process_destroy`, so the workers are gone before anything is
+ *             printed, and none of them may be left to reap afterwards. */
+i32 test_multi_process() {
+    u32 num_rows = 11;
+    u32 input_shape[] = {num_rows, 2};
+    u32 target_shape[] = {num_rows, 1};
+    mem_arena data_arena = gzMemArenaAllocate(gzMegabyte(1));
+    t32 *input = gz_tensor_zero(input_shape, f32, false, &data_arena);
+    t32 *target = gz_tensor_zero(target_shape, f32, false, &data_arena);
+    for(u32 idx = 0; idx < num_rows; ++idx) {
+        u32 a = idx & 1, b = (idx >> 1) & 1;
+        ((f32 *)input->Data.Ptr)[2*idx] = (f32)a;
+        ((f32 *)input->Data.Ptr)[2*idx + 1] = (f32)b;
+        ((f32 *)target->Data.Ptr)[idx] = (f32)(a ^ b);
+    }
+
+    u32 worker_counts[] = {2, 3};
+    u32 num_failed = 0;
+    for(u32 count_idx = 0; count_idx < gz_array_length(worker_counts); ++count_idx) {
+        mem_arena step_arena = gz_mem_step_arena(gzMegabyte(64), gzMegabyte(2));
+        mem_arena *model_arenas[2];
+        module *models[2][6];
+        tensor_list params[2];
+        optimizer *optims[2];
+        for(u32 model_idx = 0; model_idx < 2; ++model_idx) {
+            mem_arena *model_arena = model_arenas[model_idx] = gz_model_arena_create(gzMegabyte(16));
+            module **model = models[model_idx];
+            model[0] = gz_module_linear(2, 64, model_arena);
+            model[1] = gz_module_relu(model_arena);
+            model[2] = gz_module_linear(64, 32, model_arena);
+            model[3] = gz_module_relu(model_arena);
+            model[4] = gz_module_linear(32, 1, model_arena);
+            model[5] = gz_module_sigmoid(model_arena);
+            params[model_idx] = gz_tensor_list_from_module_list(model, 6, model_arena);
+            optims[model_idx] = gz_optim_adam_create(params[model_idx], 0.01f, 0.9f, 0.999f, 1e-8f, 0.f, false,
+                                                     model_arena);
+        }
+        memcpy(params[1].flat.data, params[0].flat.data, params[0].flat.length*sizeof(f32));
+        gz_grad_zero(params[0]);
+        fflush(stdout);
+        multi_process *trainer = gz_multi_process_create(models[1], 6, model_arenas[1], optims[1],
+                                                         worker_counts[count_idx], gz_loss_binary_cross_entropy,
+                                                         reduce_mean, gzMegabyte(64));
+
+        f32 loss = 0.f, parallel_loss = 0.f;
+        for(u32 step = 0; step < 30; ++step) {
+            t32 *y_hat = gz_module_run_all(models[0], 6, input, &step_arena);
+            t32 *loss_tensor = gz_loss_binary_cross_entropy(y_hat, target, reduce_mean, &step_arena);
+            loss = *(f32 *)loss_tensor->Data.Ptr;
+            gz_backprop(loss_tensor);
+            gz_optim_step(optims[0]);
+            gz_grad_zero(params[0]);
+            gz_mem_arena_reset(&step_arena);
+
+            parallel_loss = gz_multi_process_step(trainer, input, target);
+        }
+
+        f32 max_error = fabsf(loss - parallel_loss);
+        bool are_grads_zero = true;
+        for(usize idx = 0; idx < params[0].flat.length; ++idx) {
+            f32 error = fabsf(params[0].flat.data[idx] - params[1].flat.data[idx]);
+            if(error > max_error) max_error = error;
+            are_grads_zero &= (params[1].flat.grad[idx] == 0.f);
+        }
+        gz_multi_process_destroy(trainer);
+        bool are_workers_gone = true;
+        for(u32 rank = 1; rank < trainer->num_workers; ++rank)
+            are_workers_gone &= (waitpid(trainer->children[rank], NULL, WNOHANG) == -1);
+        gz_mem_arena_release(&step_arena);
+        gz_mem_arena_release(model_arenas[0]);
+        gz_mem_arena_release(model_arenas[1]);
+
+        bool is_passed = (max_error < 1e-4f) && are_grads_zero && are_workers_gone;
+        printf("multi process (%u workers, %u rows): max error %g, grads %s, workers %s, %s\n",
+               worker_counts[count_idx], num_rows, max_error, are_grads_zero ? "zeroed" : "NOT ZEROED",
+               are_workers_gone ? "gone" : "LEFT OVER", is_passed ? "ok" : "FAILED");
+        num_failed += !is_passed;
+    }
+    gz_mem_arena_release(&data_arena);
+
+    return num_failed ? 1 : 0;
+}
+#endif
+
+/* NOTE(abid): Throughput of hogwild over the number of workers, on sparse inputs (a few active features out of
+ *             many), so that the grads of the first layer rarely collide. */
+i32 bench_hogwild() {
+    u64 num_features = 4096;
+    u64 num_active = 4;
+    u64 num_samples = 8192;
+    mem_arena main_arena = gzMemArenaAllocate(gzMegabyte(256));
+    gz_mem_arena_split_meta(&main_arena, gzMegabyte(16));
+
+    f32 *samples = gzMemPushArray(&main_arena, f32, num_samples*num_features);
+    f32 *labels = gzMemPushArray(&main_arena, f32, num_samples);
+    memset(samples, 0, num_samples*num_features*sizeof(f32));
+    gzRandSeed(42);
+    for(u64 idx = 0; idx < num_samples; ++idx) {
+        u64 parity = 0;
+        for(u64 jdx = 0; jdx < num_active; ++jdx) {
+            u64 feature = gzRandRangeU64(0, num_features);
+            samples[idx*num_features + feature] = 1.f;
+            parity ^= feature & 1;
+        }
+        labels[idx] = (f32)parity;
+    }
+    u64 X_shape[] = {num_features};
+    u64 y_shape[] = {1};
+    dataset X = gz_dataset_build(samples, num_samples*num_features, 1, X_shape, gz_array_length(X_shape), &main_arena);
+    dataset y = gz_dataset_build(labels, num_samples, 1, y_shape, gz_array_length(y_shape), &main_arena);
+
+    u32 num_cores = gz_thread_num_cores();
+    f64 base_throughput = 0.0;
+    for(u32 num_workers = 1; num_workers <= num_cores; num_workers *= 2) {
+        gz_thread_pool_init(num_workers);
+        mem_arena *model_arena = gz_model_arena_create(gzMegabyte(16));
+        module *model[] = {
+            gz_module_linear((u32)num_features, 16, model_arena),
+            gz_module_sigmoid(model_arena),
+            gz_module_linear(16, 1, model_arena),
+            gz_module_sigmoid(model_arena),
+        };
+        hogwild *trainer = gz_hogwild_create(model, gz_array_length(model), model_arena, num_workers,
+                                             gz_loss_binary_cross_entropy, reduce_mean, 0.01f, gzMegabyte(64));
+
+        f64 start = gz_time_seconds();
+        f32 loss = gz_hogwild_run(trainer, &X, &y, 2);
+        f64 throughput = 2.0*(f64)num_samples/(gz_time_seconds() - start);
+        if(num_workers == 1) base_throughput = throughput;
+        printf("workers %2u: %10.0f samples/s, speedup %.2fx, loss %f\n", num_workers, throughput,
+               throughput/base_throughput, loss);
+
+        gz_hogwild_destroy(trainer);
+        gz_mem_arena_release(model_arena);
+    }
+    gz_mem_arena_release(&main_arena);
+
+    return 0;
+}
+
+/* NOTE(abid): Throughput of the MNIST data path, i.e. shuffled batches converted from the mapped bytes, once on
+ *             the calling thread and then through the loader with more and more producers. The files are the
+ *             uncompressed ones, e.g. "data/train-images-idx3-ubyte" and "data/train-labels-idx1-ubyte". */
+i32 bench_mnist(char *images_path, char *labels_path) {
+    u64 batch_size = 64;
+    u32 num_epochs = 4;
+    mem_arena main_arena = gzMemArenaAllocate(gzMegabyte(64));
+    gz_mem_arena_split_meta(&main_arena, gzMegabyte(4));
+
+    mnist_dataset mnist = gz_mnist_open(images_path, labels_path, mem_access_random);
+    printf("mnist: %llu images of %ux%u\n", (unsigned long long)mnist.num_samples, mnist.images.shape[1],
+           mnist.images.shape[2]);
+
+    dataset_sampler sampler = gz_dataset_sampler_create(mnist.num_samples, batch_size, true, &main_arena);
+    t32 *images, *labels;
+    gz_mnist_batch_create(&mnist, batch_size, &images, &labels, &main_arena);
+    u64 num_batches = gz_dataset_sampler_num_batches(&sampler);
+    f64 start = gz_time_seconds();
+    for(u32 epoch = 0; epoch < num_epochs; ++epoch) {
+        for(u64 idx = 0; idx < num_batches; ++idx)
+            gz_mnist_gather(&mnist, gz_dataset_sampler_indices(&sampler, idx), batch_size, images, labels);
+        gz_dataset_sampler_next_epoch(&sampler);
+    }
+    f64 base_throughput = (f64)(num_epochs*num_batches*batch_size)/(gz_time_seconds() - start);
+    printf("synchronous:  %10.0f samples/s\n", base_throughput);
+
+    for(u32 num_producers = 1; num_producers <= gz_thread_num_cores(); num_producers *= 2) {
+        temp_memory temp = gz_mem_temp_begin(&main_arena);
+        dataset_loader *loader = gz_loader_create_mnist(&mnist, batch_size, true, 3, num_producers, &main_arena);
+        num_batches = gz_loader_num_batches(loader);
+        start = gz_time_seconds();
+        for(u64 idx = 0; idx < num_epochs*num_batches; ++idx) gz_loader_next(loader);
+        f64 throughput = (f64)(num_epochs*num_batches*batch_size)/(gz_time_seconds() - start);
+        printf("producers %2u: %10.0f samples/s, %.2fx\n", num_producers, throughput, throughput/base_throughput);
+        gz_loader_print(loader);
+        gz_loader_destroy(loader);
+        gz_mem_temp_end(temp);
+    }
+    gz_mnist_close(&mnist);
+    gz_mem_arena_release(&main_arena);
+
+    return 0;
+}
+
 #if 0
     u32 InputShape[] = {5, 7};
     f32 InputData[] = {
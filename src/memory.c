@@ -37,22 +37,215 @@ gzPlatoformMemAllocate(usize Size) {
     return Result;
 }
 
+/* NOTE(abid): Address space only, nothing can be touched before it is committed. */
+internal void *
+gzPlatformMemReserve(usize Size, u32 Flags) {
+    void *Result = NULL;
+
+#ifdef GRAZIE_PLT_WIN
+    /* TODO(abid): Large pages on windows have to be committed up front and need a privilege, so the huge page
+     *             flags are ignored for now. */
+    (void)Flags;
+    Result = VirtualAlloc(NULL, Size, MEM_RESERVE, PAGE_NOACCESS);
+    if(Result == NULL) {
+        GetLastError();
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    i32 MapFlags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    Result = MAP_FAILED;
+    /* NOTE(abid): Huge TLB pages are reserved for the whole range at once, without the reservation a fault
+     *             with the huge page pool empty would be a SIGBUS instead of a failed map. */
+    if(Flags & mem_arena_flag_huge_tlb)
+        Result = mmap(NULL, Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(Result == MAP_FAILED) {
+        /* NOTE(abid): One huge page extra, so the range can start on a huge page boundary. */
+        usize HugeSize = GZ_MEM_COMMIT_GRANULARITY;
+        u8 *Base = (u8 *)mmap(NULL, Size + HugeSize, PROT_NONE, MapFlags, -1, 0);
+        if(Base == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        usize Skip = (HugeSize - ((usize)Base & (HugeSize-1))) & (HugeSize-1);
+        if(Skip) munmap(Base, Skip);
+        munmap(Base + Skip + Size, HugeSize - Skip);
+        Result = Base + Skip;
+        if(Flags & mem_arena_flag_huge_pages) madvise(Result, Size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return Result;
+}
+
+internal void
+gzPlatformMemCommit(void *Ptr, usize Size) {
+#ifdef GRAZIE_PLT_WIN
+    void *Result = VirtualAlloc(Ptr, Size, MEM_COMMIT, PAGE_READWRITE);
+    assert(Result, "could not commit %zu bytes of arena memory", Size);
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    i32 Error = mprotect(Ptr, Size, PROT_READ | PROT_WRITE);
+    assert(Error == 0, "could not commit %zu bytes of arena memory", Size);
+#endif
+}
+
+internal void
+gzPlatformMemDecommit(void *Ptr, usize Size) {
+#ifdef GRAZIE_PLT_WIN
+    VirtualFree(Ptr, Size, MEM_DECOMMIT);
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    madvise(Ptr, Size, MADV_DONTNEED);
+    mprotect(Ptr, Size, PROT_NONE);
+#endif
+}
+
+/* NOTE(abid): Gives back memory that was allocated or reserved, the whole of it at once. */
+internal void
+gzPlatformMemRelease(void *Ptr, usize Size) {
+#ifdef GRAZIE_PLT_WIN
+    (void)Size;
+    VirtualFree(Ptr, 0, MEM_RELEASE);
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    munmap(Ptr, Size);
+#endif
+}
+
+/* NOTE(abid): Returns a map with a NULL `Ptr` if the file cannot be opened or is empty. */
+internal mem_file_map
+gzPlatformFileMap(char *Path) {
+    mem_file_map Result = {0};
+
+#ifdef GRAZIE_PLT_WIN
+    Result.File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(Result.File == INVALID_HANDLE_VALUE) return Result;
+    LARGE_INTEGER FileSize;
+    if(!GetFileSizeEx(Result.File, &FileSize) || !FileSize.QuadPart) {
+        CloseHandle(Result.File);
+        return Result;
+    }
+    Result.Mapping = CreateFileMappingA(Result.File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(Result.Mapping) Result.Ptr = MapViewOfFile(Result.Mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!Result.Ptr) {
+        if(Result.Mapping) CloseHandle(Result.Mapping);
+        CloseHandle(Result.File);
+        return Result;
+    }
+    Result.Size = (usize)FileSize.QuadPart;
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    i32 File = open(Path, O_RDONLY);
+    if(File < 0) return Result;
+    struct stat Stat;
+    if((fstat(File, &Stat) == 0) && (Stat.st_size > 0)) {
+        void *Ptr = mmap(NULL, (usize)Stat.st_size, PROT_READ, MAP_SHARED, File, 0);
+        if(Ptr != MAP_FAILED) {
+            Result.Ptr = Ptr;
+            Result.Size = (usize)Stat.st_size;
+        }
+    }
+    /* NOTE(abid): The mapping keeps the file alive on its own. */
+    close(File);
+#endif
+
+    return Result;
+}
+
+internal void
+gzPlatformFileUnmap(mem_file_map *Map) {
+    if(!Map->Ptr) return;
+#ifdef GRAZIE_PLT_WIN
+    UnmapViewOfFile(Map->Ptr);
+    CloseHandle(Map->Mapping);
+    CloseHandle(Map->File);
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    munmap(Map->Ptr, Map->Size);
+#endif
+    Map->Ptr = NULL;
+    Map->Size = 0;
+}
+
+/* NOTE(abid): Tells the system how the range is going to be read, i.e. how far ahead to read from disk. */
+internal void
+gzPlatformMemAdvise(void *Ptr, usize Size, mem_access Access) {
+#ifdef GRAZIE_PLT_WIN
+    /* TODO(abid): PrefetchVirtualMemory for sequential access. */
+    (void)Ptr; (void)Size; (void)Access;
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+    /* NOTE(abid): madvise wants a page aligned start. */
+    usize PageSize = (usize)sysconf(_SC_PAGESIZE);
+    usize Skip = (usize)Ptr & (PageSize-1);
+    i32 Advice = MADV_NORMAL;
+    if(Access == mem_access_sequential) Advice = MADV_SEQUENTIAL;
+    else if(Access == mem_access_random) Advice = MADV_RANDOM;
+    madvise((u8 *)Ptr - Skip, Size + Skip, Advice);
+#endif
+}
+
 internal mem_arena
 gzMemArenaAllocate(usize BytesToAllocate) {
     mem_arena Arena = {0};
     Arena.Size = BytesToAllocate;
     Arena.Ptr = gzPlatoformMemAllocate(Arena.Size);
     Arena.Used = 0;
+    Arena.Committed = Arena.Size;
+
+    return Arena;
+}
+
+/* NOTE(abid): Arena that can be sized to the worst case, only what is pushed is committed. `HighWater` is
+ *             how much stays committed after temp memory ends, everything above it is decommitted. */
+internal mem_arena
+gz_mem_arena_reserve(usize BytesToReserve, usize HighWater, u32 Flags) {
+    mem_arena Arena = {0};
+    usize Granularity = GZ_MEM_COMMIT_GRANULARITY;
+    Arena.Size = (BytesToReserve + Granularity - 1) & ~(Granularity - 1);
+    Arena.Flags = Flags | mem_arena_flag_reserve;
+    Arena.Ptr = gzPlatformMemReserve(Arena.Size, Arena.Flags);
+    Arena.HighWater = HighWater;
 
     return Arena;
 }
 
+internal void
+__gz_mem_arena_commit(mem_arena *Arena, usize UsedBytes) {
+    usize Granularity = GZ_MEM_COMMIT_GRANULARITY;
+    usize NewCommitted = (UsedBytes + Granularity - 1) & ~(Granularity - 1);
+    if(NewCommitted > Arena->Size) NewCommitted = Arena->Size;
+    gzPlatformMemCommit((u8 *)Arena->Ptr + Arena->Committed, NewCommitted - Arena->Committed);
+    Arena->Committed = NewCommitted;
+}
+
+internal void
+__gz_mem_arena_decommit(mem_arena *Arena) {
+    usize Granularity = GZ_MEM_COMMIT_GRANULARITY;
+    usize Keep = (Arena->Used > Arena->HighWater) ? Arena->Used : Arena->HighWater;
+    Keep = (Keep + Granularity - 1) & ~(Granularity - 1);
+    if(Keep >= Arena->Committed) return;
+    gzPlatformMemDecommit((u8 *)Arena->Ptr + Keep, Arena->Committed - Keep);
+    Arena->Committed = Keep;
+}
+
 inline internal temp_memory
 gz_mem_temp_begin(mem_arena *Arena) {
     temp_memory Result = {0};
 
     Result.Arena = Arena;
     Result.Used = Arena->Used;
+    if(Arena->Meta) Result.MetaUsed = Arena->Meta->Used;
+    if(Arena->Grad) Result.GradUsed = Arena->Grad->Used;
+    if(Arena->State) Result.StateUsed = Arena->State->Used;
 
     ++Arena->TempCount;
 
@@ -66,6 +259,19 @@ gz_mem_temp_end(temp_memory TempMem) {
     assert(Arena->TempCount > 0, "no temp memory registered for it to end");
     Arena->Used = TempMem.Used;
     --Arena->TempCount;
+    if((Arena->Flags & mem_arena_flag_reserve) && (Arena->Committed > Arena->HighWater)) __gz_mem_arena_decommit(Arena);
+    if(Arena->Meta) {
+        assert(Arena->Meta->Used >= TempMem.MetaUsed, "something was freed when it shouldn't have been");
+        Arena->Meta->Used = TempMem.MetaUsed;
+    }
+    if(Arena->Grad) {
+        assert(Arena->Grad->Used >= TempMem.GradUsed, "something was freed when it shouldn't have been");
+        Arena->Grad->Used = TempMem.GradUsed;
+    }
+    if(Arena->State) {
+        assert(Arena->State->Used >= TempMem.StateUsed, "something was freed when it shouldn't have been");
+        Arena->State->Used = TempMem.StateUsed;
+    }
 }
 
 internal inline usize
@@ -81,13 +287,78 @@ gzMemAligmentOffset(mem_arena *Arena, usize Alignment) {
 	return AlignmentOffset;
 }
 
-#define gz_mem_push_struct(Type, Arena) (Type *)gzMemPushSize(Arena, sizeof(Type))
-#define gzMemPushArray(Arena, Type, Count) (Type *)gzMemPushSize(Arena, (Count)*sizeof(Type))
 internal void *
 gzMemPushSize(mem_arena *Arena, usize Size) {
     assert(Arena->Used + Size < Arena->Size, "not enough arena memory");
+    if(Arena->Used + Size > Arena->Committed) __gz_mem_arena_commit(Arena, Arena->Used + Size);
     void *Result = (u8 *)Arena->Ptr + Arena->Used;
     Arena->Used += Size;
 
     return Result;
 }
+
+/* NOTE(abid): Structs and arrays start on the natural alignment of their type (at most 8 bytes), so that
+ *             nothing pushed before them can leave them misaligned. */
+#define __GZ_MEM_ALIGNMENT_OF(TypeSize) ((TypeSize) >= 8 ? 8 : ((TypeSize) >= 4 ? 4 : ((TypeSize) >= 2 ? 2 : 1)))
+#define gz_mem_push_struct(Type, Arena) (Type *)gzMemPushSizeAligned(Arena, sizeof(Type), __GZ_MEM_ALIGNMENT_OF(sizeof(Type)))
+#define gzMemPushArray(Arena, Type, Count) \
+    (Type *)gzMemPushSizeAligned(Arena, (Count)*sizeof(Type), __GZ_MEM_ALIGNMENT_OF(sizeof(Type)))
+internal inline void *
+gzMemPushSizeAligned(mem_arena *Arena, usize Size, usize Alignment) {
+    usize AlignmentOffset = gzMemAligmentOffset(Arena, Alignment);
+    if(AlignmentOffset) gzMemPushSize(Arena, AlignmentOffset);
+    return gzMemPushSize(Arena, Size);
+}
+
+/* NOTE(abid): Gives `Arena` a metadata arena of its own, reserved up front and committed as it grows. The
+ *             arena struct of it sits at the start of its own memory. */
+internal void
+gz_mem_arena_split_meta(mem_arena *Arena, usize MetaBytes) {
+    assert(!Arena->Meta, "arena already has a metadata arena");
+    mem_arena Meta = gz_mem_arena_reserve(MetaBytes + sizeof(mem_arena), 0, 0);
+    mem_arena *Result = gz_mem_push_struct(mem_arena, &Meta);
+    *Result = Meta;
+    Arena->Meta = Result;
+}
+
+/* NOTE(abid): Where the metadata of things pushed to `Arena` goes, i.e. `Arena` itself if it has no split. */
+internal inline mem_arena *
+gz_mem_arena_meta(mem_arena *Arena) { return Arena->Meta ? Arena->Meta : Arena; }
+
+/* NOTE(abid): Forgets everything pushed to `Arena` and its companions, e.g. the activations of one step. */
+internal void
+gz_mem_arena_reset(mem_arena *Arena) {
+    assert(Arena->TempCount == 0, "cannot reset an arena inside of temp memory");
+    Arena->Used = 0;
+    if((Arena->Flags & mem_arena_flag_reserve) && (Arena->Committed > Arena->HighWater)) __gz_mem_arena_decommit(Arena);
+    if(Arena->Meta) Arena->Meta->Used = sizeof(mem_arena);
+    if(Arena->Grad) Arena->Grad->Used = 0;
+    if(Arena->State) Arena->State->Used = 0;
+}
+
+/* NOTE(abid): Gives the memory of `Arena` and its companions back to the system. Nothing pushed to it can be
+ *             used afterwards, and neither can `Arena` itself if it lives in its own metadata arena, as the one
+ *             of `gz_model_arena_create` does. */
+internal void
+gz_mem_arena_release(mem_arena *Arena) {
+    assert(Arena->TempCount == 0, "cannot release an arena inside of temp memory");
+    mem_arena Released = *Arena;
+    if(Released.Grad) gz_mem_arena_release(Released.Grad);
+    if(Released.State) gz_mem_arena_release(Released.State);
+    gzPlatformMemRelease(Released.Ptr, Released.Size);
+    /* NOTE(abid): Last, since the companions and maybe `Arena` itself sit in the metadata arena. */
+    if(Released.Meta) {
+        mem_arena Meta = *Released.Meta;
+        gzPlatformMemRelease(Meta.Ptr, Meta.Size);
+    }
+}
+
+/* NOTE(abid): Arena for what only lives for one step (activations, their grads and headers), reset with
+ *             `gz_mem_arena_reset`. `HighWater` is how much stays committed between steps. */
+internal mem_arena
+gz_mem_step_arena(usize BytesToReserve, usize HighWater) {
+    mem_arena Arena = gz_mem_arena_reserve(BytesToReserve, HighWater, mem_arena_flag_huge_pages);
+    gz_mem_arena_split_meta(&Arena, BytesToReserve/8);
+
+    return Arena;
+}
@@ -8,18 +8,63 @@
 
 #if !defined(MEMORY_H)
 
-typedef struct {
+/* NOTE(abid): Arenas made by `gz_mem_arena_reserve` only reserve their address range up front and commit
+ *             it as they grow. Huge pages are either asked for (transparent huge pages) or forced with
+ *             MAP_HUGETLB, which falls back to normal pages if the system has none set aside. */
+typedef enum {
+    mem_arena_flag_reserve = 1 << 0,
+    mem_arena_flag_huge_pages = 1 << 1,
+    mem_arena_flag_huge_tlb = 1 << 2,
+} mem_arena_flag;
+
+/* NOTE(abid): Commits happen in steps of this, which is also the size of a huge page. */
+#define GZ_MEM_COMMIT_GRANULARITY gzMegabyte(2)
+
+typedef struct mem_arena {
     usize Used;
     usize Size;
     void *Ptr;
     
     u32 TempCount;
+
+    u32 Flags;
+    usize Committed;
+    /* NOTE(abid): Committed memory above this is given back to the system when temp memory ends. */
+    usize HighWater;
+
+    /* NOTE(abid): Optional companion for small bookkeeping (e.g. tensor headers), so that bulk data pushed
+     *             to this arena stays densely packed. It lives and dies with this arena. */
+    struct mem_arena *Meta;
+    /* NOTE(abid): Optional companion that takes the grads of tensors pushed to this arena, with the same
+     *             offsets as their data. The data and the grads then form two flat buffers of one layout. */
+    struct mem_arena *Grad;
+    /* NOTE(abid): Optional companion for per-parameter optimizer state (e.g. momentum), in the layout of the data. */
+    struct mem_arena *State;
 } mem_arena;
 
 typedef struct {
     mem_arena *Arena;
     usize Used;
+    usize MetaUsed;
+    usize GradUsed;
+    usize StateUsed;
 } temp_memory;
 
+/* NOTE(abid): A whole file mapped read-only, its pages come straight out of the page cache. */
+typedef struct {
+    void *Ptr;
+    usize Size;
+#ifdef GRAZIE_PLT_WIN
+    HANDLE File;
+    HANDLE Mapping;
+#endif
+} mem_file_map;
+
+typedef enum {
+    mem_access_normal = 0,
+    mem_access_sequential,
+    mem_access_random,
+} mem_access;
+
 #define MEMORY_H
 #endif
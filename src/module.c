@@ -8,9 +8,28 @@
 
 #include "module.h"
 
+/* NOTE(abid): Arena for the parameters (and optimizer state) of a model, which live as long as it does. The data
+ *             of everything pushed to it sits back to back in one aligned slab, i.e. `Ptr` up to `Used`. The grads
+ *             form a second slab of the same layout in `Grad`, and headers, modules and lists go to `Meta`. The
+ *             optimizer state goes to `State`, see `gz_optim_sgd_create`. */
+internal mem_arena *
+gz_model_arena_create(usize ParamBytes) {
+    mem_arena Params = gz_mem_arena_reserve(ParamBytes, 0, mem_arena_flag_huge_pages);
+    gz_mem_arena_split_meta(&Params, GZ_MODEL_META_SIZE);
+
+    mem_arena *Result = gz_mem_push_struct(mem_arena, Params.Meta);
+    *Result = Params;
+    Result->Grad = gz_mem_push_struct(mem_arena, Params.Meta);
+    *Result->Grad = gz_mem_arena_reserve(ParamBytes, 0, mem_arena_flag_huge_pages);
+    Result->State = gz_mem_push_struct(mem_arena, Params.Meta);
+    *Result->State = gz_mem_arena_reserve(GZ_MODEL_STATE_FACTOR*ParamBytes, 0, mem_arena_flag_huge_pages);
+
+    return Result;
+}
+
 internal module *
 gz_module_linear(u32 InDim, u32 OutDim, mem_arena *Arena) {
-    module *Module = gz_mem_push_struct(module, Arena);
+    module *Module = gz_mem_push_struct(module, gz_mem_arena_meta(Arena));
     Module->type = module_linear;
 
     u32 WShape[] = {1, OutDim, InDim};
@@ -42,7 +61,7 @@ gz_module_linear(u32 InDim, u32 OutDim, mem_arena *Arena) {
 
 internal module *
 gz_module_sigmoid(mem_arena *arena) {
-    module *mod = gz_mem_push_struct(module, arena);
+    module *mod = gz_mem_push_struct(module, gz_mem_arena_meta(arena));
     mod->type = module_sigmoid;
 
     return mod;
@@ -50,12 +69,34 @@ gz_module_sigmoid(mem_arena *arena) {
 
 internal module *
 gz_module_relu(mem_arena *arena) {
-    module *mod = gz_mem_push_struct(module, arena);
+    module *mod = gz_mem_push_struct(module, gz_mem_arena_meta(arena));
     mod->type = module_relu;
 
     return mod;
 }
 
+/* NOTE(abid): Copy of the module with its own parameters in `arena`. Cloning the modules of a model in order
+ *             into a fresh model arena gives the same flat layout as the original. */
+internal module *
+gz_module_clone(module *source, mem_arena *arena) {
+    module *result = gz_mem_push_struct(module, gz_mem_arena_meta(arena));
+    result->type = source->type;
+    if(!source->weights.used) return result;
+
+    result->weights = gz_tensor_list_allocate(source->weights.used, arena);
+    for(usize idx = 0; idx < source->weights.used; ++idx) {
+        t32 *weight = source->weights.array[idx];
+        assert(weight->Header->IsContiguous && (weight->Data.DType == dtype_f32), "can only clone contiguous f32 weights");
+        t32 *copy = _gzTensorAllocf32(weight->Header->Sizes, weight->Header->Dim, 0, 0, weight->Header->ShouldGrad,
+                                      false, arena);
+        memcpy(copy->Data.Ptr, (f32 *)weight->Data.Ptr + weight->Header->Offset,
+               weight->Header->StorageNumElements*sizeof(f32));
+        gz_tensor_list_add(copy, &result->weights);
+    }
+
+    return result;
+}
+
 internal t32 *
 gz_module_run(module *module, t32 *input, mem_arena *arena) {
     t32 *result = NULL;
@@ -72,14 +113,29 @@ gz_module_run(module *module, t32 *input, mem_arena *arena) {
             u32 in_dim = input->Header->Sizes[1];
             u32 out_dim = w->Header->Sizes[1];
 
+            if(!IS_GRAD_PRESERVE()) {
+                /* NOTE(abid): Nothing is recorded, so the bias is put in the result first and x*W^T is
+                 *             accumulated on top of it. No intermediate and no extra pass over the result. */
+                u32 result_shape[] = {batch_size, out_dim};
+                result = gz_tensor_empty(result_shape, f32, false, arena);
+                for(u32 idx = 0; idx < batch_size; ++idx)
+                    memcpy((f32 *)result->Data.Ptr + idx*out_dim, b->Data.Ptr, out_dim*sizeof(f32));
+
+                gz_gemm_f32(false, true, batch_size, out_dim, in_dim,
+                            (f32 *)input->Data.Ptr, GetStrideR(input, 1), GetStrideR(input, 0),
+                            (f32 *)w->Data.Ptr, GetStrideR(w, 1), GetStrideR(w, 0),
+                            (f32 *)result->Data.Ptr, out_dim, 1);
+                break;
+            }
+
             u32 wx_shape[] = {batch_size, out_dim, 1};
-            t32 *wx = gz_tensor_empty(wx_shape, f32, true, arena);
+            t32 *wx = gz_tensor_empty(wx_shape, f32, false, arena);
             u32 input_view_shape[] = {batch_size, in_dim, 1};
             t32 *input_view = _gzNewView(input, input_view_shape, gz_array_length(input_view_shape), arena);
             gzMatMul(w, input_view, wx);
 
             u32 result_shape[] = {batch_size, out_dim};
-            result = gz_tensor_empty(result_shape, f32, true, arena);
+            result = gz_tensor_empty(result_shape, f32, false, arena);
             gzAdd(gz_trim_trailing_unit_size(wx, arena), b, result);
         } break;
         case module_sigmoid: { result = gz_sigmoid(input, arena); } break;
@@ -98,3 +154,83 @@ gz_module_run_all(module **modules, u64 module_length, t32 *input, mem_arena *ar
 
     return result;
 }
+
+/* NOTE(abid): Shape of the module output, without running it. */
+internal u32
+__gz_module_output_shape(module *module, u32 *shape, u32 dim) {
+    switch(module->type) {
+        case module_linear: {
+            assert(dim == 2, "expected input dim to be 2");
+            shape[1] = module->weights.array[0]->Header->Sizes[1];
+        } break;
+        case module_sigmoid:
+        case module_relu: break;
+        default: assert(0, "invalid code path"); break;
+    }
+
+    return dim;
+}
+
+internal t32 *
+__gz_module_run_segment(void *context, t32 *input, mem_arena *arena) {
+    module_segment *segment = (module_segment *)context;
+    return gz_module_run_all(segment->modules, segment->length, input, arena);
+}
+
+/* NOTE(abid): Same as `gz_module_run_all`, except that only the outputs of every `segment_length` modules are
+ *             kept. Each segment is run without recording its ops, and its forward is done once more during
+ *             backprop, one segment at a time. With `segment_length` of 0, sqrt(module_length) is used, so
+ *             roughly 2*sqrt(N) activations are alive at the same time instead of N. The last segment is
+ *             recorded as usual, since backprop needs its activations right away. */
+internal t32 *
+gz_module_run_all_checkpointed(module **modules, u64 module_length, u64 segment_length,
+                               t32 *input, mem_arena *arena) {
+    if(!IS_GRAD_PRESERVE()) return gz_module_run_all(modules, module_length, input, arena);
+    if(segment_length == 0) segment_length = (u64)ceil(sqrt((f64)module_length));
+
+    t32 *result = input;
+    u64 start = 0;
+    for(; start + segment_length < module_length; start += segment_length) {
+        u32 shape[GZ_TENSOR_MAX_DIMS];
+        u32 dim = result->Header->Dim;
+        memcpy(shape, result->Header->Sizes, dim*sizeof(u32));
+
+        bool should_grad = result->Header->ShouldGrad;
+        for(u64 idx = start; idx < start + segment_length; ++idx) {
+            dim = __gz_module_output_shape(modules[idx], shape, dim);
+            for(usize jdx = 0; jdx < modules[idx]->weights.used; ++jdx)
+                should_grad |= modules[idx]->weights.array[jdx]->Header->ShouldGrad;
+        }
+
+        module_segment *segment = gz_mem_push_struct(module_segment, gz_mem_arena_meta(arena));
+        segment->modules = modules + start;
+        segment->length = segment_length;
+        checkpoint_info *info = gz_mem_push_struct(checkpoint_info, gz_mem_arena_meta(arena));
+        info->forward = __gz_module_run_segment;
+        info->context = segment;
+        info->arena = arena;
+        t32 *checkpoint = _gzTensorAllocf32(shape, dim, 0, 0, false, false, arena);
+
+        /* NOTE(abid): Nothing of the segment but its output survives. */
+        temp_memory segment_memory = gz_mem_temp_begin(arena);
+        mem_plan *plan = __gzGLOBALMemPlan;
+        __gzGLOBALMemPlan = NULL;
+        GRAD_PRESERVE(false);
+
+        t32 *output = gz_module_run_all(segment->modules, segment->length, result, arena);
+        assert(gzIsShapeEqual(output->Header, checkpoint->Header), "checkpoint shape mismatch");
+        memcpy(checkpoint->Data.Ptr, output->Data.Ptr, output->Header->StorageNumElements*sizeof(f32));
+
+        GRAD_PRESERVE(true);
+        __gzGLOBALMemPlan = plan;
+        gz_mem_temp_end(segment_memory);
+
+        checkpoint->Header->ShouldGrad = should_grad;
+        checkpoint->Header->DerivedOp.TensorOp = op_unary_checkpoint;
+        checkpoint->Header->DerivedOp.Operands[0] = result;
+        checkpoint->Header->DerivedOp.op_context = info;
+        result = checkpoint;
+    }
+
+    return gz_module_run_all(modules + start, module_length - start, result, arena);
+}
@@ -20,5 +20,16 @@ typedef struct {
     module_type type;
 } module;
 
+typedef struct {
+    module **modules;
+    u64 length;
+} module_segment;
+
+/* NOTE(abid): Reserved for the modules, headers and lists of a model arena, only what is used is committed. */
+#define GZ_MODEL_META_SIZE gzMegabyte(64)
+/* NOTE(abid): Room for optimizer state, in parameter bytes (e.g. two moments of Adam and a momentum). Reserved,
+ *             not committed. */
+#define GZ_MODEL_STATE_FACTOR 4
+
 #define MODULE_H
 #endif
@@ -38,6 +38,11 @@ T32ToggleOptimWatch(bool Start) {
 
 internal inline void
 gz_grad_zero(tensor_list TensorList) {
+    if(TensorList.flat.length) {
+        memset(TensorList.flat.grad, 0, TensorList.flat.length*sizeof(f32));
+        return;
+    }
+
     for(u32 TensorIdx = 0; TensorIdx < TensorList.used; ++TensorIdx) {
         t32 *Tensor = TensorList.array[TensorIdx];
         for(usize DataIdx = 0; DataIdx < Tensor->Header->StorageNumElements; ++DataIdx) {
@@ -46,28 +51,382 @@ gz_grad_zero(tensor_list TensorList) {
     }
 }
 
+internal inline u32
+__gz_optim_num_chunks(flat_params *Params) {
+    return (u32)((Params->length + GZ_OPTIM_CHUNK_ELEMENTS - 1)/GZ_OPTIM_CHUNK_ELEMENTS);
+}
+
+/* NOTE(abid): The elements [Begin, End) of the chunk of a flat optimizer pass. */
+internal inline void
+__gz_optim_chunk(flat_params *Params, u32 ChunkIdx, usize *Begin, usize *End) {
+    *Begin = (usize)ChunkIdx*GZ_OPTIM_CHUNK_ELEMENTS;
+    *End = *Begin + GZ_OPTIM_CHUNK_ELEMENTS;
+    if(*End > Params->length) *End = Params->length;
+}
+
+/* NOTE(abid): Elements of state a tensor of a non-flat list takes. */
+internal inline usize
+__gz_optim_state_length(t32 *Tensor) {
+    usize Lanes = GZ_TENSOR_VECTOR_BYTES/sizeof(f32);
+    return (Tensor->Header->StorageNumElements + Lanes - 1) & ~(Lanes - 1);
+}
+
+internal usize
+__gz_optim_total_state(tensor_list *Params) {
+    if(Params->flat.length) return Params->flat.length;
+    usize Result = 0;
+    for(usize Idx = 0; Idx < Params->used; ++Idx) Result += __gz_optim_state_length(Params->array[Idx]);
+
+    return Result;
+}
+
+/* NOTE(abid): Zeroed state, in the state arena if `Arena` is a model arena. */
+internal void *
+__gz_optim_push_state(mem_arena *Arena, usize Bytes) {
+    mem_arena *StateArena = Arena->State ? Arena->State : Arena;
+    assert(!StateArena->Grad, "optimizer state cannot go to the data of a model arena");
+    void *Result = gzMemPushSizeAligned(StateArena, Bytes, GZ_TENSOR_VECTOR_BYTES);
+    memset(Result, 0, Bytes);
+
+    return Result;
+}
+
+/* NOTE(abid): Decay, momentum, Nesterov lookahead and step in one pass, i.e. every element is read and written
+ *             once. The branches are outside of the loops so that each loop vectorizes. */
 internal void
-gz_optim_sgd(tensor_list TensorList, f32 LearningRate) {
-    /* TODO(Abid): Add nesterov momentum as well as weight decay. */
+__gz_optim_sgd_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    optim_job *Job = (optim_job *)Data;
+    optimizer *Optim = Job->optim;
+    usize Begin, End;
+    __gz_optim_chunk(&Job->params, TaskIdx, &Begin, &End);
 
-    for(u32 TensorIdx = 0; TensorIdx < TensorList.used; ++TensorIdx) {
-        t32 *Tensor = TensorList.array[TensorIdx];
-        size_t NumData = Tensor->Header->StorageNumElements;
-        size_t Offset = 0;
-        for(size_t OpNum = 1; OpNum <= NumData; ++OpNum) {
-            *((f32 *)Tensor->Data.Ptr + Offset) -= LearningRate * (*((f32 *)Tensor->Grad.Ptr + Offset));
-            i32 DimMaxNumSoFar = 1;
-            for(i32 DimIdx = 1; DimIdx <= (i32)Tensor->Header->Dim; ++DimIdx) {
-                DimMaxNumSoFar *= Tensor->Header->Sizes[Tensor->Header->Dim-DimIdx];
-                if(OpNum % DimMaxNumSoFar == 0) {
-                    Offset -= Tensor->Header->Strides[Tensor->Header->Dim-DimIdx] *
-                              (Tensor->Header->Sizes[Tensor->Header->Dim-DimIdx]-1);
-                    continue;
-                }
-                Offset += Tensor->Header->Strides[Tensor->Header->Dim-DimIdx];
-                break;
-            }
+    f32 *ParamData = Job->params.data;
+    f32 *ParamGrad = Job->params.grad;
+    f32 LearningRate = Optim->learning_rate;
+    f32 Decay = 1.f - LearningRate*Optim->weight_decay;
+    f32 GradScale = Job->grad_scale;
+    if(!Optim->velocity) {
+        for(usize Idx = Begin; Idx < End; ++Idx)
+            ParamData[Idx] = Decay*ParamData[Idx] - LearningRate*(GradScale*ParamGrad[Idx]);
+        return;
+    }
+
+    f32 *Velocity = Optim->velocity + Job->state_offset;
+    f32 Momentum = Optim->momentum;
+    if(Optim->nesterov) {
+        for(usize Idx = Begin; Idx < End; ++Idx) {
+            f32 Grad = GradScale*ParamGrad[Idx];
+            f32 NewVelocity = Momentum*Velocity[Idx] + Grad;
+            Velocity[Idx] = NewVelocity;
+            ParamData[Idx] = Decay*ParamData[Idx] - LearningRate*(Grad + Momentum*NewVelocity);
+        }
+    } else {
+        for(usize Idx = Begin; Idx < End; ++Idx) {
+            f32 NewVelocity = Momentum*Velocity[Idx] + GradScale*ParamGrad[Idx];
+            Velocity[Idx] = NewVelocity;
+            ParamData[Idx] = Decay*ParamData[Idx] - LearningRate*NewVelocity;
+        }
+    }
+}
+
+/* NOTE(abid): Moments, bias correction, decay and step in one pass. With the bias corrections folded into
+ *             `step_size` and `inv_sqrt_bias_correction2` the update is
+ *                 p = decay*p - step_size*m/(sqrt(v)*inv_sqrt_bias_correction2 + epsilon),
+ *             where Adam adds `weight_decay*p` to the grad instead of decaying p. */
+#define __GZ_ADAM_LOOP(LOAD_MOMENT1, STORE_MOMENT1) \
+    for(usize Idx = Begin; Idx < End; ++Idx) { \
+        f32 Param = ParamData[Idx]; \
+        f32 Grad = gz_fmadd(GradDecay, Param, GradScale*ParamGrad[Idx]); \
+        f32 Moment1 = gz_fmadd(Beta1, LOAD_MOMENT1(Moment1s[Idx]), OneMinusBeta1*Grad); \
+        f32 Moment2 = gz_fmadd(Beta2, Moment2s[Idx], OneMinusBeta2*Grad*Grad); \
+        Moment1s[Idx] = STORE_MOMENT1(Moment1); \
+        Moment2s[Idx] = Moment2; \
+        f32 Denominator = gz_fmadd(gz_sqrtf(Moment2), InvSqrtBiasCorrection2, Epsilon); \
+        ParamData[Idx] = gz_fmadd(-StepSize, Moment1/Denominator, Decay*Param); \
+    }
+#define __GZ_ADAM_F32(X) (X)
+
+internal void
+__gz_optim_adam_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    optim_job *Job = (optim_job *)Data;
+    optimizer *Optim = Job->optim;
+    usize Begin, End;
+    __gz_optim_chunk(&Job->params, TaskIdx, &Begin, &End);
+
+    f32 *ParamData = Job->params.data;
+    f32 *ParamGrad = Job->params.grad;
+    bool IsDecoupled = Optim->kind == optim_kind_adamw;
+    f32 Decay = IsDecoupled ? 1.f - Optim->learning_rate*Optim->weight_decay : 1.f;
+    f32 GradDecay = IsDecoupled ? 0.f : Optim->weight_decay;
+    f32 Beta1 = Optim->beta1;
+    f32 Beta2 = Optim->beta2;
+    f32 OneMinusBeta1 = 1.f - Beta1;
+    f32 OneMinusBeta2 = 1.f - Beta2;
+    f32 Epsilon = Optim->epsilon;
+    f32 StepSize = Job->step_size;
+    f32 InvSqrtBiasCorrection2 = Job->inv_sqrt_bias_correction2;
+    f32 GradScale = Job->grad_scale;
+    f32 *Moment2s = Optim->moment2 + Job->state_offset;
+    if(Optim->moments_bf16) {
+        u16 *Moment1s = (u16 *)Optim->moment1 + Job->state_offset;
+        __GZ_ADAM_LOOP(gz_bf16_to_f32, gz_f32_to_bf16);
+    } else {
+        f32 *Moment1s = (f32 *)Optim->moment1 + Job->state_offset;
+        __GZ_ADAM_LOOP(__GZ_ADAM_F32, __GZ_ADAM_F32);
+    }
+}
+#undef __GZ_ADAM_F32
+#undef __GZ_ADAM_LOOP
+
+/* NOTE(abid): A flat list is one pass over its buffers, otherwise every tensor is a pass of its own. Either way
+ *             the pass is split into chunks for the thread pool, so only large ranges run in parallel. */
+internal void
+__gz_optim_run(optimizer *Optim, thread_task *Task, optim_job Job) {
+    tensor_list *Params = &Optim->params;
+    thread_pool *Pool = gz_thread_pool_get();
+    Job.optim = Optim;
+    if(Params->flat.length) {
+        Job.params = Params->flat;
+        gz_thread_pool_run(Pool, Task, &Job, __gz_optim_num_chunks(&Job.params));
+        return;
+    }
+
+    Job.chunk_offset = 0;
+
+    for(usize Idx = 0; Idx < Params->used; ++Idx) {
+        t32 *Tensor = Params->array[Idx];
+        assert(Tensor->Header->IsContiguous && (Tensor->Data.DType == dtype_f32),
+               "optimizer needs contiguous f32 parameters");
+        if(Tensor->Grad.Ptr) {
+            Job.params.data = (f32 *)Tensor->Data.Ptr + Tensor->Header->Offset;
+            Job.params.grad = (f32 *)Tensor->Grad.Ptr + Tensor->Header->Offset;
+            Job.params.length = Tensor->Header->StorageNumElements;
+            gz_thread_pool_run(Pool, Task, &Job, __gz_optim_num_chunks(&Job.params));
+            Job.chunk_offset += __gz_optim_num_chunks(&Job.params);
+        }
+        Job.state_offset += __gz_optim_state_length(Tensor);
+    }
+}
+
+/* NOTE(abid): Sum of squares of the grads of a chunk, over a few lanes so that the loop vectorizes. */
+internal void
+__gz_optim_norm_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    optim_job *Job = (optim_job *)Data;
+    usize Begin, End;
+    __gz_optim_chunk(&Job->params, TaskIdx, &Begin, &End);
+
+    f32 *ParamGrad = Job->params.grad;
+    f32 Lanes[GZ_OPTIM_NORM_LANES] = {0};
+    usize Idx = Begin;
+    for(; Idx + GZ_OPTIM_NORM_LANES <= End; Idx += GZ_OPTIM_NORM_LANES) {
+        for(u32 Lane = 0; Lane < GZ_OPTIM_NORM_LANES; ++Lane) Lanes[Lane] += ParamGrad[Idx+Lane]*ParamGrad[Idx+Lane];
+    }
+    f64 Sum = 0.0;
+    for(; Idx < End; ++Idx) Sum += (f64)ParamGrad[Idx]*ParamGrad[Idx];
+    for(u32 Lane = 0; Lane < GZ_OPTIM_NORM_LANES; ++Lane) Sum += Lanes[Lane];
+    Job->partials[Job->chunk_offset + TaskIdx] = Sum;
+}
+
+internal usize
+__gz_optim_total_chunks(tensor_list *Params) {
+    if(Params->flat.length) return __gz_optim_num_chunks(&Params->flat);
+    usize Result = 0;
+    for(usize Idx = 0; Idx < Params->used; ++Idx) {
+        t32 *Tensor = Params->array[Idx];
+        flat_params Range = {0};
+        Range.length = Tensor->Header->StorageNumElements;
+        if(Tensor->Grad.Ptr) Result += __gz_optim_num_chunks(&Range);
+    }
+
+    return Result;
+}
+
+/* NOTE(abid): Global L2 norm of the grads of the optimizer, which is a read of every grad. */
+internal f32
+gz_optim_grad_norm(optimizer *Optim) {
+    mem_arena *Scratch = gz_thread_scratch_arena();
+    temp_memory Partials = gz_mem_temp_begin(Scratch);
+    usize NumChunks = __gz_optim_total_chunks(&Optim->params);
+    optim_job Job = {0};
+    Job.partials = gzMemPushArray(Scratch, f64, NumChunks + 1);
+    __gz_optim_run(Optim, __gz_optim_norm_task, Job);
+
+    f64 SumSquares = 0.0;
+    for(usize Idx = 0; Idx < NumChunks; ++Idx) SumSquares += Job.partials[Idx];
+    gz_mem_temp_end(Partials);
+
+    return (f32)sqrt(SumSquares);
+}
+
+/* NOTE(abid): Clips the grads to `MaxNorm` by their global norm on every step, zero turns it off. Not while
+ *             attached to backprop, where the grads are never all there at once. */
+internal void
+gz_optim_set_clip(optimizer *Optim, f32 MaxNorm) {
+    assert(MaxNorm >= 0.f, "max grad norm cannot be negative, got %f", MaxNorm);
+    assert(!Optim->is_attached || (MaxNorm == 0.f),
+           "global-norm clipping cannot be used with per-parameter updates, detach from backprop first");
+    Optim->max_grad_norm = MaxNorm;
+}
+
+/* NOTE(abid): The state is taken from `Arena`, which should be the model arena of the parameters. A momentum of
+ *             zero is plain SGD and takes no state. */
+internal optimizer *
+gz_optim_sgd_create(tensor_list Params, f32 LearningRate, f32 Momentum, f32 WeightDecay, bool Nesterov,
+                    mem_arena *Arena) {
+    assert(!Nesterov || (Momentum > 0.f), "nesterov momentum needs a momentum above zero");
+    optimizer *Result = gz_mem_push_struct(optimizer, gz_mem_arena_meta(Arena));
+    memset(Result, 0, sizeof(optimizer));
+    Result->kind = optim_kind_sgd;
+    Result->params = Params;
+    Result->learning_rate = LearningRate;
+    Result->weight_decay = WeightDecay;
+    Result->momentum = Momentum;
+    Result->nesterov = Nesterov;
+    if(Momentum != 0.f) Result->velocity = (f32 *)__gz_optim_push_state(Arena, __gz_optim_total_state(&Params)*sizeof(f32));
+
+    return Result;
+}
+
+internal optimizer *
+__gz_optim_adam_create(optim_kind Kind, tensor_list Params, f32 LearningRate, f32 Beta1, f32 Beta2, f32 Epsilon,
+                       f32 WeightDecay, bool MomentsBf16, mem_arena *Arena) {
+    assert((Beta1 >= 0.f) && (Beta1 < 1.f) && (Beta2 >= 0.f) && (Beta2 < 1.f), "adam betas must be in [0, 1)");
+    optimizer *Result = gz_mem_push_struct(optimizer, gz_mem_arena_meta(Arena));
+    memset(Result, 0, sizeof(optimizer));
+    Result->kind = Kind;
+    Result->params = Params;
+    Result->learning_rate = LearningRate;
+    Result->weight_decay = WeightDecay;
+    Result->beta1 = Beta1;
+    Result->beta2 = Beta2;
+    Result->epsilon = Epsilon;
+    Result->moments_bf16 = MomentsBf16;
+    usize NumStates = __gz_optim_total_state(&Params);
+    Result->moment1 = __gz_optim_push_state(Arena, NumStates*(MomentsBf16 ? sizeof(u16) : sizeof(f32)));
+    Result->moment2 = (f32 *)__gz_optim_push_state(Arena, NumStates*sizeof(f32));
+
+    return Result;
+}
+
+/* NOTE(abid): `WeightDecay` is added to the grad (L2), as in the original Adam. */
+internal optimizer *
+gz_optim_adam_create(tensor_list Params, f32 LearningRate, f32 Beta1, f32 Beta2, f32 Epsilon, f32 WeightDecay,
+                     bool MomentsBf16, mem_arena *Arena) {
+    return __gz_optim_adam_create(optim_kind_adam, Params, LearningRate, Beta1, Beta2, Epsilon, WeightDecay,
+                                  MomentsBf16, Arena);
+}
+
+/* NOTE(abid): `WeightDecay` decays the parameters directly. */
+internal optimizer *
+gz_optim_adamw_create(tensor_list Params, f32 LearningRate, f32 Beta1, f32 Beta2, f32 Epsilon, f32 WeightDecay,
+                      bool MomentsBf16, mem_arena *Arena) {
+    return __gz_optim_adam_create(optim_kind_adamw, Params, LearningRate, Beta1, Beta2, Epsilon, WeightDecay,
+                                  MomentsBf16, Arena);
+}
+
+internal void
+__gz_optim_adam_bias_correction(optimizer *Optim, u64 Step, optim_job *Job) {
+    f64 BiasCorrection1 = 1.0 - pow(Optim->beta1, (f64)Step);
+    f64 BiasCorrection2 = 1.0 - pow(Optim->beta2, (f64)Step);
+    Job->step_size = (f32)(Optim->learning_rate/BiasCorrection1);
+    Job->inv_sqrt_bias_correction2 = (f32)(1.0/sqrt(BiasCorrection2));
+}
+
+/* NOTE(abid): With clipping on, the grads are read twice: once for the norm and once in the update, where they
+ *             are scaled on the fly. Returns false if the step was skipped for a non-finite norm. */
+internal bool
+gz_optim_step(optimizer *Optim) {
+    optim_job Job = {0};
+    Job.grad_scale = 1.f;
+    if(Optim->max_grad_norm > 0.f) {
+        f32 Norm = gz_optim_grad_norm(Optim);
+        Optim->last_grad_norm = Norm;
+        if(!isfinite(Norm)) {
+            ++Optim->num_skipped_steps;
+            return false;
         }
+        if(Norm > Optim->max_grad_norm) Job.grad_scale = Optim->max_grad_norm/(Norm + 1e-6f);
+    }
+
+    switch(Optim->kind) {
+        case optim_kind_sgd: { __gz_optim_run(Optim, __gz_optim_sgd_task, Job); } break;
+        case optim_kind_adam:
+        case optim_kind_adamw: {
+            __gz_optim_adam_bias_correction(Optim, ++Optim->step, &Job);
+            __gz_optim_run(Optim, __gz_optim_adam_task, Job);
+        } break;
+        default: assert(0, "invalid code path"); break;
+    }
+
+    return true;
+}
+
+/* NOTE(abid): Update of a single parameter as soon as backprop is done with its grad, while the grad is
+ *             still in cache. The grad is zeroed right after, ready for the next backprop. */
+internal void
+__gz_optim_hook(t32 *Tensor, void *Context) {
+    optim_hook *Hook = (optim_hook *)Context;
+    optimizer *Optim = Hook->optim;
+    optim_job Job = {0};
+    Job.optim = Optim;
+    Job.grad_scale = 1.f;
+    Job.state_offset = Hook->state_offset;
+    Job.params.data = (f32 *)Tensor->Data.Ptr + Tensor->Header->Offset;
+    Job.params.grad = (f32 *)Tensor->Grad.Ptr + Tensor->Header->Offset;
+    Job.params.length = Tensor->Header->StorageNumElements;
+
+    thread_task *Task = __gz_optim_sgd_task;
+    if(Optim->kind != optim_kind_sgd) {
+        __gz_optim_adam_bias_correction(Optim, ++Hook->step, &Job);
+        Task = __gz_optim_adam_task;
+    }
+    gz_thread_pool_run(gz_thread_pool_get(), Task, &Job, __gz_optim_num_chunks(&Job.params));
+    memset(Job.params.grad, 0, Job.params.length*sizeof(f32));
+}
 
+/* NOTE(abid): Opt-in, from now on every backprop steps the optimizer by itself, one parameter at a time as
+ *             their grads become final, and leaves the grads zeroed. Neither `gz_optim_step` nor
+ *             `gz_grad_zero` is to be called anymore. Global-norm clipping needs all grads at once, so it
+ *             cannot be used this way. A parameter used both inside a checkpoint and outside of it would be
+ *             updated before its grad is complete, so it is not supported either. */
+internal void
+gz_optim_attach_to_backprop(optimizer *Optim, mem_arena *Arena) {
+    assert(Optim->max_grad_norm == 0.f, "global-norm clipping cannot be used with per-parameter updates");
+    assert(!Optim->is_attached, "optimizer is already attached to backprop");
+    tensor_list *Params = &Optim->params;
+    usize StateOffset = 0;
+    for(usize Idx = 0; Idx < Params->used; ++Idx) {
+        t32 *Tensor = Params->array[Idx];
+        assert(Tensor->Header->IsContiguous && (Tensor->Data.DType == dtype_f32),
+               "optimizer needs contiguous f32 parameters");
+        if(Tensor->Grad.Ptr) {
+            optim_hook *Hook = gz_mem_push_struct(optim_hook, gz_mem_arena_meta(Arena));
+            Hook->optim = Optim;
+            /* NOTE(abid): A flat list keeps its state at the offsets of the data. */
+            Hook->state_offset = Params->flat.length ? (usize)((f32 *)Tensor->Data.Ptr - Params->flat.data) : StateOffset;
+            Hook->step = Optim->step;
+            gz_grad_hook_register(Tensor, __gz_optim_hook, Hook, Arena);
+        }
+        StateOffset += __gz_optim_state_length(Tensor);
     }
+    Optim->is_attached = true;
+}
+
+internal void
+gz_optim_detach_from_backprop(optimizer *Optim) {
+    for(usize Idx = 0; Idx < Optim->params.used; ++Idx) gz_grad_hook_remove(Optim->params.array[Idx]);
+    Optim->is_attached = false;
+}
+
+/* NOTE(abid): Plain SGD without any state. */
+internal void
+gz_optim_sgd(tensor_list TensorList, f32 LearningRate) {
+    optimizer Optim = {0};
+    Optim.kind = optim_kind_sgd;
+    Optim.params = TensorList;
+    Optim.learning_rate = LearningRate;
+    gz_optim_step(&Optim);
 }
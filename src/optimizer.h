@@ -8,8 +8,78 @@
 
 #if !defined(OPTIMIZER_H)
 
+/* NOTE(abid): Flat optimizer passes are split into chunks of this many elements, one task each. A multiple
+ *             of 16 so that every chunk starts on a 64 byte boundary. */
+#define GZ_OPTIM_CHUNK_ELEMENTS (1 << 14)
 
+typedef enum {
+    optim_kind_sgd,
+    optim_kind_adam,
+    optim_kind_adamw,
+} optim_kind;
 
+/* NOTE(abid): An optimizer over a tensor list. Per-parameter state has the layout of the flat parameters if the
+ *             list is flat, otherwise it holds the tensors of the list back to back, each rounded up to a vector. */
+typedef struct {
+    optim_kind kind;
+    tensor_list params;
+    f32 learning_rate;
+    /* NOTE(abid): Decoupled, i.e. the parameter itself decays instead of adding to the grad. */
+    f32 weight_decay;
+
+    f32 momentum;
+    bool nesterov;
+    f32 *velocity;
+
+    /* NOTE(abid): Adam keeps its weight decay in the grad, AdamW decouples it. */
+    f32 beta1;
+    f32 beta2;
+    f32 epsilon;
+    u64 step;
+    /* NOTE(abid): The first moment is f32, or bf16 (u16) to cut the state by a quarter. The second moment is
+     *             always f32: with beta2 close to one every step moves it by less than half a bf16 ulp, so
+     *             rounded to bf16 it could never decay after a large grad. */
+    bool moments_bf16;
+    void *moment1;
+    f32 *moment2;
+
+    /* NOTE(abid): Clipping by the global L2 norm of the grads, off at zero. Steps with a non-finite norm are
+     *             skipped and counted. */
+    f32 max_grad_norm;
+    f32 last_grad_norm;
+    u64 num_skipped_steps;
+
+    /* NOTE(abid): Set while the optimizer steps from the grad hooks, see `gz_optim_attach_to_backprop`. */
+    bool is_attached;
+} optimizer;
+
+/* NOTE(abid): One contiguous range of parameters, `state_offset` is where its state starts. */
+typedef struct {
+    optimizer *optim;
+    flat_params params;
+    usize state_offset;
+
+    /* NOTE(abid): Per-step constants of Adam, see `__gz_optim_adam_task`. */
+    f32 step_size;
+    f32 inv_sqrt_bias_correction2;
+    /* NOTE(abid): Applied to every grad inside the update, i.e. the clipping. */
+    f32 grad_scale;
+
+    /* NOTE(abid): For the norm pass, one partial sum per chunk over all ranges, `chunk_offset` being the first
+     *             chunk of the current range. Summed in chunk order so the norm does not depend on the threads. */
+    f64 *partials;
+    usize chunk_offset;
+} optim_job;
+
+#define GZ_OPTIM_NORM_LANES 8
+
+/* NOTE(abid): Context of the grad hook of one parameter, see `gz_optim_attach_to_backprop`. Adam counts its
+ *             steps per parameter here, since there is no single point where the whole step happens. */
+typedef struct {
+    optimizer *optim;
+    usize state_offset;
+    u64 step;
+} optim_hook;
 
 #define OPTIMIZER_H
 #endif
@@ -0,0 +1,304 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 10:42:17 AM                                        |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#include "planner.h"
+
+/* NOTE(abid): How to use the planner:
+ *
+ *     mem_plan *plan = gz_mem_plan_allocate(1024, &plan_arena);
+ *
+ *     gz_mem_plan_capture_begin(plan, &step_arena);     <- dry-run step
+ *     t32 *loss = ...forward...;
+ *     gz_mem_plan_capture_end(plan, loss);               <- lifetimes, offsets and the slab
+ *     gz_backprop(loss);
+ *     gz_mem_plan_print(plan);
+ *
+ *     gz_mem_plan_replay_begin(plan);                    <- every following step
+ *     t32 *loss = ...same forward...;
+ *     gz_backprop(loss);
+ *     gz_mem_plan_replay_end(plan);
+ *
+ * While replaying, the values of intermediate tensors are only valid for as long as the plan needs
+ * them, i.e. after the step only the root, the leaves and their grads can be read. */
+
+internal mem_plan *
+gz_mem_plan_allocate(u32 max_tensors, mem_arena *arena) {
+    mem_plan *plan = gz_mem_push_struct(mem_plan, arena);
+    memset(plan, 0, sizeof(mem_plan));
+
+    plan->arena = arena;
+    plan->max_tensors = max_tensors;
+    plan->tensors = gzMemPushArray(arena, t32 *, max_tensors);
+    plan->data_bytes = gzMemPushArray(arena, usize, max_tensors);
+    plan->data_offsets = gzMemPushArray(arena, usize, max_tensors);
+    plan->grad_offsets = gzMemPushArray(arena, usize, max_tensors);
+    /* NOTE(abid): At most one data and one grad buffer per tensor. */
+    plan->buffers = gzMemPushArray(arena, mem_plan_buffer, 2*max_tensors);
+
+    return plan;
+}
+
+internal void
+gz_mem_plan_capture_begin(mem_plan *plan, mem_arena *step_arena) {
+    assert(!__gzGLOBALMemPlan, "another memory plan is already active");
+    assert(IS_GRAD_PRESERVE(), "memory plan can only be captured in grad mode");
+    plan->state = mem_plan_capturing;
+    plan->num_tensors = 0;
+    plan->num_buffers = 0;
+    plan->num_grad_buffers = 0;
+    plan->is_address_ordered = true;
+    plan->slab = NULL;
+
+    plan->step_arena = step_arena;
+    if(step_arena) plan->step_arena_used = step_arena->Used;
+    __gzGLOBALMemPlan = plan;
+}
+
+/* NOTE(abid): The tensor that actually owns the data, views only borrow it. */
+internal inline t32 *
+__gz_mem_plan_data_owner(t32 *tensor) {
+    while(gz_tensor_op(tensor) == op_unary_view) tensor = tensor->Header->DerivedOp.Operands[0];
+    return tensor;
+}
+
+internal inline void
+__gz_mem_plan_extend(mem_plan *plan, u32 *death, t32 *tensor, u32 step) {
+    u32 idx = __gz_mem_plan_find(plan, __gz_mem_plan_data_owner(tensor), plan->num_tensors);
+    if((idx != (u32)-1) && (death[idx] < step)) death[idx] = step;
+}
+
+/* NOTE(abid): Which data the backward of an op reads, this has to be kept in sync with `gz_backprop`. */
+internal void
+__gz_mem_plan_backward_reads(mem_plan *plan, u32 *death, t32 *tensor, bool *needs_grad, u32 step) {
+    t32 **operands = tensor->Header->DerivedOp.Operands;
+    switch(tensor->Header->DerivedOp.TensorOp) {
+        case op_unary_sigmoid: { __gz_mem_plan_extend(plan, death, tensor, step); } break;
+        case op_unary_relu:
+        case op_unary_checkpoint: { __gz_mem_plan_extend(plan, death, operands[0], step); } break;
+        case op_binary_mul:
+        case op_binary_matmul: {
+            if(needs_grad[0]) __gz_mem_plan_extend(plan, death, operands[1], step);
+            if(needs_grad[1]) __gz_mem_plan_extend(plan, death, operands[0], step);
+        } break;
+        case op_binary_div: {
+            if(needs_grad[0] || needs_grad[1]) __gz_mem_plan_extend(plan, death, operands[1], step);
+            if(needs_grad[1]) __gz_mem_plan_extend(plan, death, operands[0], step);
+        } break;
+        case op_binary_loss_cross_entropy: {
+            __gz_mem_plan_extend(plan, death, operands[0], step);
+            __gz_mem_plan_extend(plan, death, operands[1], step);
+        } break;
+        default: break;
+    }
+}
+
+internal int
+__gz_mem_plan_compare_size(const void *a, const void *b) {
+    usize size_a = ((mem_plan_buffer *)a)->size;
+    usize size_b = ((mem_plan_buffer *)b)->size;
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+/* NOTE(abid): Greedy by size. The largest buffers are placed first, each one at the lowest offset that does
+ *             not collide with an already placed buffer whose lifetime overlaps with it. */
+internal usize
+__gz_mem_plan_assign_offsets(mem_plan_buffer *buffers, u32 num_buffers, mem_arena *scratch) {
+    usize result = 0;
+    qsort(buffers, num_buffers, sizeof(mem_plan_buffer), __gz_mem_plan_compare_size);
+
+    temp_memory temp = gz_mem_temp_begin(scratch);
+    mem_plan_buffer **live = gzMemPushArray(scratch, mem_plan_buffer *, num_buffers);
+
+    for(u32 idx = 0; idx < num_buffers; ++idx) {
+        mem_plan_buffer *buffer = buffers + idx;
+
+        /* NOTE(abid): Collect the placed buffers that are alive at the same time, sorted by offset. */
+        u32 num_live = 0;
+        for(u32 jdx = 0; jdx < idx; ++jdx) {
+            mem_plan_buffer *other = buffers + jdx;
+            if((other->birth > buffer->death) || (other->death < buffer->birth)) continue;
+
+            u32 insert = num_live++;
+            while(insert && (live[insert-1]->offset > other->offset)) { live[insert] = live[insert-1]; --insert; }
+            live[insert] = other;
+        }
+
+        usize offset = 0;
+        for(u32 jdx = 0; jdx < num_live; ++jdx) {
+            if(live[jdx]->offset >= offset + buffer->size) break;
+            usize end = live[jdx]->offset + live[jdx]->size;
+            if(end > offset) offset = end;
+        }
+        buffer->offset = offset;
+        if(offset + buffer->size > result) result = offset + buffer->size;
+    }
+    gz_mem_temp_end(temp);
+
+    return result;
+}
+
+internal void
+gz_mem_plan_capture_end(mem_plan *plan, t32 *root) {
+    assert(plan->state == mem_plan_capturing, "memory plan is not capturing");
+    __gzGLOBALMemPlan = NULL;
+    plan->state = mem_plan_idle;
+    if(plan->step_arena) plan->arena_bytes = plan->step_arena->Used - plan->step_arena_used;
+
+    mem_arena *arena = plan->arena;
+    temp_memory temp = gz_mem_temp_begin(arena);
+
+    u32 num_tensors = plan->num_tensors;
+    u32 *data_death = gzMemPushArray(arena, u32, num_tensors);
+    u32 *grad_birth = gzMemPushArray(arena, u32, num_tensors);
+    u32 *grad_death = gzMemPushArray(arena, u32, num_tensors);
+    t32 **stack = gzMemPushArray(arena, t32 *, num_tensors+1);
+
+    /* NOTE(abid): Forward steps, data lives at least until the last op that reads it. */
+    for(u32 idx = 0; idx < num_tensors; ++idx) {
+        t32 *tensor = plan->tensors[idx];
+        data_death[idx] = idx;
+        grad_birth[idx] = (u32)-1;
+        grad_death[idx] = 0;
+        plan->data_offsets[idx] = GZ_MEM_PLAN_NONE;
+        plan->grad_offsets[idx] = GZ_MEM_PLAN_NONE;
+
+        tensor_op op = gz_tensor_op(tensor);
+        /* NOTE(abid): Leaves made during the step belong to the user, they stay for the whole step. */
+        if(op == op_none) data_death[idx] = (u32)-1;
+        else {
+            u32 num_operands = ((op > op_unary_begin) && (op < op_unary_end)) ? 1 : 2;
+            for(u32 jdx = 0; jdx < num_operands; ++jdx)
+                __gz_mem_plan_extend(plan, data_death, tensor->Header->DerivedOp.Operands[jdx], idx);
+        }
+    }
+    u32 root_idx = __gz_mem_plan_find(plan, root, num_tensors);
+    if(root_idx != (u32)-1) data_death[root_idx] = (u32)-1;
+
+    /* NOTE(abid): Backward steps, walk the graph exactly the way `gz_backprop` does. */
+    u32 step = num_tensors;
+    if(root->Header->ShouldGrad) {
+        u32 top = 0;
+        stack[top++] = root;
+        while(top) {
+            t32 *tensor = stack[--top];
+            if(__gzIsLeaf(tensor)) continue;
+            u32 num_operands = __gzNumGradOperands(tensor->Header->DerivedOp.TensorOp);
+            for(u32 idx = 0; idx < num_operands; ++idx) {
+                t32 *operand = tensor->Header->DerivedOp.Operands[idx];
+                if(!__gzNeedsGrad(operand)) continue;
+                if(operand->Header->BackwardRefCount++ == 0 && !__gzIsLeaf(operand)) {
+                    assert(top < num_tensors+1, "graph has non-leaf tensors that were not captured");
+                    stack[top++] = operand;
+                }
+            }
+        }
+
+        if(root_idx != (u32)-1) grad_birth[root_idx] = step;
+        stack[top++] = root;
+        while(top) {
+            t32 *tensor = stack[--top];
+            u32 tensor_idx = __gz_mem_plan_find(plan, tensor, num_tensors);
+            if(tensor_idx != (u32)-1) grad_death[tensor_idx] = step;
+
+            t32 **operands = tensor->Header->DerivedOp.Operands;
+            u32 num_operands = __gzNumGradOperands(tensor->Header->DerivedOp.TensorOp);
+            bool needs_grad[2] = { __gzNeedsGrad(operands[0]), (num_operands > 1) && __gzNeedsGrad(operands[1]) };
+            __gz_mem_plan_backward_reads(plan, data_death, tensor, needs_grad, step);
+
+            for(u32 idx = 0; idx < num_operands; ++idx) {
+                if(!needs_grad[idx]) continue;
+                t32 *operand = operands[idx];
+                u32 operand_idx = __gz_mem_plan_find(plan, operand, num_tensors);
+                if((operand_idx != (u32)-1) && (grad_birth[operand_idx] > step)) grad_birth[operand_idx] = step;
+
+                if(--operand->Header->BackwardRefCount == 0 && !__gzIsLeaf(operand)) stack[top++] = operand;
+            }
+            ++step;
+        }
+    }
+    u32 end_step = step;
+
+    /* NOTE(abid): Gather the buffers. A view hands its grad over to its operand, so it may live as long as that one. */
+    mem_plan_buffer *buffers = plan->buffers;
+    u32 num_buffers = 0;
+    plan->naive_bytes = 0;
+    for(u32 idx = 0; idx < num_tensors; ++idx) {
+        t32 *tensor = plan->tensors[idx];
+        usize alignment_mask = GZ_MEM_PLAN_ALIGNMENT-1;
+        if(plan->data_bytes[idx]) {
+            mem_plan_buffer *buffer = buffers + num_buffers++;
+            buffer->size = (plan->data_bytes[idx] + alignment_mask) & ~alignment_mask;
+            buffer->birth = idx;
+            buffer->death = (data_death[idx] > end_step) ? end_step : data_death[idx];
+            buffer->tensor_idx = idx;
+            buffer->is_grad = false;
+            plan->naive_bytes += buffer->size;
+        }
+
+        bool has_transient_grad = (grad_birth[idx] != (u32)-1) && !__gzIsLeaf(tensor) && !tensor->Grad.Ptr;
+        if(has_transient_grad) {
+            if(tensor->Header->DerivedOp.TensorOp == op_unary_view) {
+                u32 operand_idx = __gz_mem_plan_find(plan, tensor->Header->DerivedOp.Operands[0], num_tensors);
+                if((operand_idx != (u32)-1) && (grad_death[operand_idx] > grad_death[idx]))
+                    grad_death[idx] = grad_death[operand_idx];
+            }
+            mem_plan_buffer *buffer = buffers + num_buffers++;
+            buffer->size = (tensor->Header->StorageNumElements*sizeof(f32) + alignment_mask) & ~alignment_mask;
+            buffer->birth = grad_birth[idx];
+            buffer->death = grad_death[idx];
+            buffer->tensor_idx = idx;
+            buffer->is_grad = true;
+            plan->naive_bytes += buffer->size;
+            ++plan->num_grad_buffers;
+        }
+    }
+    plan->num_buffers = num_buffers;
+
+    plan->planned_bytes = __gz_mem_plan_assign_offsets(buffers, num_buffers, arena);
+    for(u32 idx = 0; idx < num_buffers; ++idx) {
+        mem_plan_buffer *buffer = buffers + idx;
+        if(buffer->is_grad) plan->grad_offsets[buffer->tensor_idx] = buffer->offset;
+        else plan->data_offsets[buffer->tensor_idx] = buffer->offset;
+    }
+    gz_mem_temp_end(temp);
+
+    /* NOTE(abid): The slab outlives the scratch above, so it is pushed after it is gone. */
+    gzMemPushSize(arena, gzMemAligmentOffset(arena, GZ_MEM_PLAN_ALIGNMENT));
+    plan->slab = (u8 *)gzMemPushSize(arena, plan->planned_bytes);
+}
+
+internal void
+gz_mem_plan_replay_begin(mem_plan *plan) {
+    assert(!__gzGLOBALMemPlan, "another memory plan is already active");
+    assert(plan->slab, "memory plan must be captured before it is replayed");
+    plan->state = mem_plan_replaying;
+    plan->replay_idx = 0;
+    plan->is_address_ordered = true;
+    __gzGLOBALMemPlan = plan;
+}
+
+internal void
+gz_mem_plan_replay_end(mem_plan *plan) {
+    assert(plan->state == mem_plan_replaying, "memory plan is not replaying");
+    assert(plan->replay_idx == plan->num_tensors, "replayed %u tensors, but %u were captured",
+           plan->replay_idx, plan->num_tensors);
+    plan->state = mem_plan_idle;
+    __gzGLOBALMemPlan = NULL;
+}
+
+internal void
+gz_mem_plan_print(mem_plan *plan) {
+    f64 to_kb = 1.0/1024.0;
+    printf("memory plan -> %u tensors, %u buffers (%u activations, %u grads)\n", plan->num_tensors,
+           plan->num_buffers, plan->num_buffers - plan->num_grad_buffers, plan->num_grad_buffers);
+    printf("    naive:   %10.2f KB (every buffer alive for the whole step)\n", plan->naive_bytes*to_kb);
+    if(plan->step_arena)
+        printf("    arena:   %10.2f KB (used by the captured forward, including tensor metadata)\n", plan->arena_bytes*to_kb);
+    printf("    planned: %10.2f KB (%.1f%% of naive)\n\n", plan->planned_bytes*to_kb,
+           plan->naive_bytes ? 100.0*plan->planned_bytes/plan->naive_bytes : 0.0);
+}
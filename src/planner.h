@@ -0,0 +1,129 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 10:42:17 AM                                        |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#if !defined(PLANNER_H)
+
+/* NOTE(abid): A memory plan is made from one captured step. Every tensor allocated during the capture
+ *             is recorded in order, its data (and its transient grad) gets a lifetime, and all of these
+ *             buffers are packed into one slab. When the same step is replayed, the tensors take their
+ *             data and grads from the slab instead of the arena or the grad pool. */
+typedef enum {
+    mem_plan_idle = 0,
+    mem_plan_capturing,
+    mem_plan_replaying,
+} mem_plan_state;
+
+#define GZ_MEM_PLAN_NONE ((usize)-1)
+#define GZ_MEM_PLAN_ALIGNMENT 64
+
+typedef struct {
+    usize size;
+    usize offset;
+    /* NOTE(abid): Lifetime in steps, forward steps are the allocation order of the tensors and backward
+     *             steps come after, in the order `gz_backprop` visits the tensors. Both ends are inclusive. */
+    u32 birth;
+    u32 death;
+    u32 tensor_idx;
+    bool is_grad;
+} mem_plan_buffer;
+
+typedef struct {
+    mem_plan_state state;
+
+    /* NOTE(abid): Tensors in allocation order, during replay these are overwritten with the replayed ones. */
+    t32 **tensors;
+    usize *data_bytes;
+    u32 num_tensors;
+    u32 max_tensors;
+    u32 replay_idx;
+    bool is_address_ordered;
+
+    usize *data_offsets;
+    usize *grad_offsets;
+    mem_plan_buffer *buffers;
+    u32 num_buffers;
+    u32 num_grad_buffers;
+
+    u8 *slab;
+    usize planned_bytes;
+    usize naive_bytes;
+    usize arena_bytes;
+
+    mem_arena *arena;
+    mem_arena *step_arena;
+    usize step_arena_used;
+} mem_plan;
+
+global_var mem_plan *__gzGLOBALMemPlan = NULL;
+
+internal inline bool
+__gz_mem_plan_is_replaying() { return __gzGLOBALMemPlan && (__gzGLOBALMemPlan->state == mem_plan_replaying); }
+
+/* NOTE(abid): Called for every tensor that is allocated. While capturing, the tensor is recorded, while
+ *             replaying, it returns the planned data storage (NULL when the tensor has no data of its own). */
+internal inline void *
+__gz_mem_plan_on_alloc(t32 *tensor, usize data_bytes) {
+    mem_plan *plan = __gzGLOBALMemPlan;
+    void *result = NULL;
+    if(!plan) return result;
+
+    if(plan->state == mem_plan_capturing) {
+        assert(plan->num_tensors < plan->max_tensors, "memory plan capture is full, %u tensors", plan->max_tensors);
+        if(plan->num_tensors && (plan->tensors[plan->num_tensors-1] > tensor)) plan->is_address_ordered = false;
+        plan->tensors[plan->num_tensors] = tensor;
+        plan->data_bytes[plan->num_tensors] = data_bytes;
+        ++plan->num_tensors;
+    } else if(plan->state == mem_plan_replaying) {
+        u32 idx = plan->replay_idx++;
+        assert((idx < plan->num_tensors) && (plan->data_bytes[idx] == data_bytes),
+               "replayed step does not match the captured one at tensor %u", idx);
+        if(idx && (plan->tensors[idx-1] > tensor)) plan->is_address_ordered = false;
+        plan->tensors[idx] = tensor;
+        if(data_bytes) result = plan->slab + plan->data_offsets[idx];
+    }
+
+    return result;
+}
+
+internal inline u32
+__gz_mem_plan_find(mem_plan *plan, t32 *tensor, u32 num_tensors) {
+    if(plan->is_address_ordered) {
+        u32 low = 0, high = num_tensors;
+        while(low < high) {
+            u32 mid = low + (high-low)/2;
+            if(plan->tensors[mid] < tensor) low = mid+1;
+            else high = mid;
+        }
+        if((low < num_tensors) && (plan->tensors[low] == tensor)) return low;
+    } else {
+        for(u32 idx = 0; idx < num_tensors; ++idx) if(plan->tensors[idx] == tensor) return idx;
+    }
+
+    return (u32)-1;
+}
+
+/* NOTE(abid): Planned grad storage of the tensor while replaying, NULL if it should come from the grad pool. */
+internal inline f32 *
+__gz_mem_plan_grad_for(t32 *tensor) {
+    if(!__gz_mem_plan_is_replaying()) return NULL;
+    mem_plan *plan = __gzGLOBALMemPlan;
+
+    u32 idx = __gz_mem_plan_find(plan, tensor, plan->replay_idx);
+    if((idx == (u32)-1) || (plan->grad_offsets[idx] == GZ_MEM_PLAN_NONE)) return NULL;
+
+    return (f32 *)(plan->slab + plan->grad_offsets[idx]);
+}
+
+internal inline bool
+__gz_mem_plan_owns(void *ptr) {
+    mem_plan *plan = __gzGLOBALMemPlan;
+    return plan && plan->slab && ((u8 *)ptr >= plan->slab) && ((u8 *)ptr < plan->slab + plan->planned_bytes);
+}
+
+#define PLANNER_H
+#endif
@@ -15,9 +15,118 @@
 
 #include "tensor.h"
 #include "module.h"
+#include "planner.h"
+
+/* NOTE(abid): Bytes of a data or grad buffer, so the buffer after it starts aligned as well. */
+internal inline usize
+__gzTensorStorageBytes(usize Bytes) {
+    usize Multiple = __gzGLOBALTensorAlloc.alignment;
+    if(__gzGLOBALTensorAlloc.pad_to_vector && (Multiple < GZ_TENSOR_VECTOR_BYTES)) Multiple = GZ_TENSOR_VECTOR_BYTES;
+    return (Bytes + Multiple - 1) & ~(Multiple - 1);
+}
+
+internal inline usize
+gz_dtype_size(tensor_dtype DType) {
+    switch(DType) {
+        case dtype_f32: return sizeof(f32);
+        case dtype_i32: return sizeof(i32);
+        default: assert(0, "invalid code path"); return 0;
+    }
+}
+
+/* NOTE(abid): Applies to the tensors allocated afterwards, `Alignment` must be a power of two. */
+internal void
+gz_tensor_set_alignment(u32 Alignment, bool PadToVector) {
+    assert(Alignment && !(Alignment & (Alignment - 1)), "tensor alignment must be a power of two, got %u", Alignment);
+    __gzGLOBALTensorAlloc.alignment = Alignment;
+    __gzGLOBALTensorAlloc.pad_to_vector = PadToVector;
+}
+
+internal void
+gzCalculateStride(u32 *Strides, u32 *Sizes, u32 Dim) {
+    /* NOTE(Abid): Calculate the strides given the tensor shape */
+    for(u32 Idx = 0; Idx < Dim; ++Idx) {
+        if(Sizes[Idx] == 1) {
+            Strides[Idx] = 0;
+            continue;
+        } else Strides[Idx] = 1;
+        for(u32 Jdx = Idx+1; Jdx < Dim; ++Jdx) {
+            Strides[Idx] *= Sizes[Jdx];
+        }
+    }
+}
+
+internal inline tensor_shape *
+__gz_tensor_shape_find(tensor_shape *Shape, u32 Hash, u32 *Sizes, u32 *Strides, u32 Dim) {
+    for(; Shape; Shape = Shape->next) {
+        if((Shape->hash == Hash) && (Shape->dim == Dim) &&
+           !memcmp(Shape->sizes, Sizes, Dim*sizeof(u32)) && !memcmp(Shape->strides, Strides, Dim*sizeof(u32))) break;
+    }
+    return Shape;
+}
 
-/* NOTE(Abid): The minimum allocated space for Stride/Shape is 2*sizeof(u32),
- *             Since, it will ease up the math computations and allow reshape ops */
+/* NOTE(abid): The interned sizes and strides of the given layout, contiguous strides are computed when
+ *             `Strides` is NULL. Shapes are never freed, the number of distinct layouts of a program is small,
+ *             so only the first tensor of a layout ever takes the lock. */
+internal tensor_shape *
+__gz_tensor_shape_intern(u32 *Sizes, u32 *Strides, u32 Dim) {
+    assert(Dim <= GZ_TENSOR_MAX_DIMS, "tensor dim %u is above the maximum of %u", Dim, GZ_TENSOR_MAX_DIMS);
+    u32 ContiguousStrides[GZ_TENSOR_MAX_DIMS];
+    if(!Strides) {
+        gzCalculateStride(ContiguousStrides, Sizes, Dim);
+        Strides = ContiguousStrides;
+    }
+
+    /* NOTE(abid): FNV-1a over the dim, sizes and strides. */
+    u32 Hash = 2166136261u;
+    Hash = (Hash ^ Dim)*16777619u;
+    for(u32 Idx = 0; Idx < Dim; ++Idx) {
+        Hash = (Hash ^ Sizes[Idx])*16777619u;
+        Hash = (Hash ^ Strides[Idx])*16777619u;
+    }
+
+    tensor_shape_table *Table = &__gzGLOBALShapeTable;
+    tensor_shape **Bucket = Table->buckets + (Hash & (GZ_TENSOR_SHAPE_BUCKETS-1));
+    tensor_shape *Head = (tensor_shape *)gz_atomic_load_ptr(Bucket);
+    tensor_shape *Result = __gz_tensor_shape_find(Head, Hash, Sizes, Strides, Dim);
+    if(Result) return Result;
+
+    gz_spin_lock(&Table->lock);
+    if(!Table->arena.Ptr) Table->arena = gz_mem_arena_reserve(GZ_TENSOR_SHAPE_ARENA_SIZE, 0, 0);
+    /* NOTE(abid): Someone may have added it in the meantime. */
+    tensor_shape *NewHead = *Bucket;
+    Result = __gz_tensor_shape_find(NewHead, Hash, Sizes, Strides, Dim);
+    if(!Result) {
+        u32 NumEntries = (Dim < 2) ? 2 : Dim;
+        Result = gz_mem_push_struct(tensor_shape, &Table->arena);
+        Result->hash = Hash;
+        Result->dim = Dim;
+        Result->sizes = gzMemPushArray(&Table->arena, u32, 2*NumEntries);
+        Result->strides = Result->sizes + NumEntries;
+        memset(Result->sizes, 0, 2*NumEntries*sizeof(u32));
+        memcpy(Result->sizes, Sizes, Dim*sizeof(u32));
+        memcpy(Result->strides, Strides, Dim*sizeof(u32));
+        Result->next = NewHead;
+        gz_atomic_store_ptr(Bucket, Result);
+        ++Table->num_shapes;
+    }
+    gz_spin_unlock(&Table->lock);
+
+    return Result;
+}
+
+internal inline void
+__gz_tensor_set_shape(tensor_header *Header, u32 *Sizes, u32 *Strides, u32 Dim) {
+    tensor_shape *Shape = __gz_tensor_shape_intern(Sizes, Strides, Dim);
+    Header->Sizes = Shape->sizes;
+    Header->Strides = Shape->strides;
+    Header->Dim = Dim;
+}
+
+/* NOTE(abid): The t32 and its header go to the metadata arena of `Arena` (see `gz_mem_arena_split_meta`),
+ *             the data and grad to `Arena` itself, so that the data of consecutive ops sits back to back.
+ *             If `Arena` has a grad arena, the grad goes there instead at the same offset as the data, which
+ *             is why room for it is taken there even when the tensor has no grad. */
 /* TODO(Abid): It doesn't make sense to have f32/i32 TYPE allocation here. We can have byte-sized
  *              allocation instead, where the tensor is allocated based on how many bytes each
  *              element will get. In this case both f32 and i32 takes 4 bytes. */
@@ -29,55 +138,64 @@
     for (u32 i = 0; i < ShapeLength; ++i) { DataSize *= Shape[i]; } \
     assert(DataSize != 0, "wrong shape given, cannot be zero"); \
     \
-    u32 AllocShapeLength = ShapeLength; \
-    if(ShapeLength == 1) ++AllocShapeLength;\
-    size_t FinalSize = sizeof(t32) + \
-                       sizeof(tensor_header) + \
-                       3*AllocShapeLength*sizeof(u32) + /* For Stride, Shape, SizesAccessPtr */ \
-                       2*sizeof(t32 *) + /*  For tensor operands */ \
-                       DataSize*sizeof(TYPE) + \
-                       (i32)StoreGrad*DataSize*sizeof(f32); /* StoreGrad for backprop */ \
+    /* NOTE(abid): While replaying a memory plan, the data lives in the slab of the plan. */ \
+    bool IsDataPlanned = __gz_mem_plan_is_replaying(); \
+    /* NOTE(abid): Outside of grad mode there is no grad, no operand(s) and no autograd part of the header. */ \
+    bool HasAutograd = IS_GRAD_PRESERVE(); \
+    bool HasGrad = StoreGrad && HasAutograd; \
+    size_t HeaderSize = HasAutograd ? sizeof(tensor_header) : GZ_TENSOR_HEADER_NO_AUTOGRAD_SIZE; \
+    size_t FinalSize = sizeof(t32) + HeaderSize; \
+    size_t DataBytes = __gzTensorStorageBytes(DataSize*sizeof(TYPE)); \
+    size_t GradBytes = __gzTensorStorageBytes(DataSize*sizeof(f32)); /* StoreGrad for backprop */ \
+    mem_arena *GradArena = Arena->Grad; \
+    assert(!GradArena || (!IsDataPlanned && (DataBytes == GradBytes)), "tensor does not fit the grad arena"); \
+    size_t StorageBytes = (IsDataPlanned ? 0 : DataBytes) + ((HasGrad && !GradArena) ? GradBytes : 0); \
     \
     /* NOTE(Abid): Memory mapping */ \
-    Result = (t32 *)gzMemPushSize(Arena, FinalSize); \
+    Result = (t32 *)gzMemPushSizeAligned(gz_mem_arena_meta(Arena), FinalSize, sizeof(void *)); \
+    void *Storage = NULL; \
+    if(StorageBytes) Storage = gzMemPushSizeAligned(Arena, StorageBytes, __gzGLOBALTensorAlloc.alignment); \
+    void *SeparateGrad = NULL; \
+    if(GradArena) { \
+        SeparateGrad = gzMemPushSizeAligned(GradArena, GradBytes, __gzGLOBALTensorAlloc.alignment); \
+        assert((u8 *)SeparateGrad - (u8 *)GradArena->Ptr == (u8 *)Storage - (u8 *)Arena->Ptr, \
+               "grad arena out of step with its data arena"); \
+        if(!HasGrad) memset(SeparateGrad, 0, GradBytes); \
+    } \
     Result->Header = (tensor_header *)(Result+1); \
     assert(Result->Header, "storage memory cannot be allocated"); \
-    Result->Header->Sizes = (u32 *)(Result->Header+1); \
-    Result->Header->Strides = (u32 *)(Result->Header->Sizes + AllocShapeLength); \
-    Result->Header->AccessSizes = (u32 *)(Result->Header->Strides + AllocShapeLength); \
     Result->Data.DType = dtype_##TYPE; \
     Result->Grad.DType = dtype_f32; \
     Result->Header->IsContiguous = true; \
     Result->Header->StorageNumElements = DataSize; \
     /* NOTE(Abid): Setting whether to compute the backward pass or not */ \
-    Result->Header->ShouldGrad = IS_GRAD_PRESERVE(); \
-    Result->Header->DerivedOp.TensorOp = op_none; \
-    Result->Header->DerivedOp.op_context = NULL;  \
-    \
-    Result->Header->DerivedOp.Operands = (t32 **)(Result->Header->AccessSizes + AllocShapeLength); \
-    Result->Data.Ptr = (void *)((t32 **)Result->Header->DerivedOp.Operands + 2); /* 2 operands by default */ \
-    if(StoreGrad) { \
-        Result->Grad.Ptr = ((TYPE *)Result->Data.Ptr) + DataSize; \
-        memset(Result->Grad.Ptr, 0, DataSize*sizeof(TYPE)); \
+    Result->Header->ShouldGrad = HasGrad; \
+    Result->Header->HasAutograd = HasAutograd; \
+    if(HasAutograd) { \
+        Result->Header->IsGradTransient = false; \
+        Result->Header->BackwardRefCount = 0; \
+        Result->Header->BackwardLock = 0; \
+        Result->Header->BackwardReaders = 0; \
+        Result->Header->GradHook = NULL; \
+        Result->Header->DerivedOp.TensorOp = op_none; \
+        Result->Header->DerivedOp.op_context = NULL;  \
+        Result->Header->DerivedOp.Operands[0] = Result->Header->DerivedOp.Operands[1] = NULL; \
+    } \
+    void *PlannedData = __gz_mem_plan_on_alloc(Result, DataSize*sizeof(TYPE)); \
+    Result->Data.Ptr = PlannedData ? PlannedData : Storage; \
+    if(HasGrad) { \
+        if(SeparateGrad) Result->Grad.Ptr = SeparateGrad; \
+        else Result->Grad.Ptr = PlannedData ? Storage : (void *)((u8 *)Storage + DataBytes); \
+        memset(Result->Grad.Ptr, 0, GradBytes); \
         \
     } \
     else Result->Grad.Ptr = NULL; \
+    if(!PlannedData && (DataBytes > DataSize*sizeof(TYPE))) \
+        memset((TYPE *)Result->Data.Ptr + DataSize, 0, DataBytes - DataSize*sizeof(TYPE)); \
     \
     /* NOTE(Abid): Setting Default Values */ \
     Result->Header->Offset = 0; \
-    Result->Header->Dim = ShapeLength; \
-    memcpy(Result->Header->Sizes, Shape, AllocShapeLength*sizeof(u32)); \
-    \
-    /* NOTE(Abid): Calculate the strides given the tensor shape */      \
-    for(u32 Idx = 0; Idx < Result->Header->Dim; ++Idx) {                \
-        if(Result->Header->Sizes[Idx] == 1) {                           \
-            Result->Header->Strides[Idx] = 0;                           \
-            continue;                                                   \
-        } else Result->Header->Strides[Idx] = 1;                        \
-        for(u32 Jdx = Idx+1; Jdx < Result->Header->Dim; ++Jdx) {        \
-            Result->Header->Strides[Idx] *= Result->Header->Sizes[Jdx]; \
-        }                                                               \
-    }                                                                   \
+    __gz_tensor_set_shape(Result->Header, Shape, NULL, ShapeLength); \
     \
     if(Data) { \
         /* NOTE(Abid): Check if the DataLength makes sense with the shape */ \
@@ -93,27 +211,13 @@
     _gzTensorAlloc##TYPE(Shape, gz_array_length(Shape), Data, gz_array_length(Data), ShouldGrad, false, Arena)
 
 #define _gz_tensor_empty(Shape, ShapeLength, TYPE, ShouldGrad, Arena) \
-    _gzTensorAlloc##TYPE(Shape, ShapeLength, 0, 0, false, ShouldGrad, Arena)
+    _gzTensorAlloc##TYPE(Shape, ShapeLength, 0, 0, ShouldGrad, false, Arena)
 #define gz_tensor_empty(Shape, TYPE, ShouldGrad, Arena) _gz_tensor_empty(Shape, gz_array_length(Shape), TYPE, ShouldGrad, Arena)
 
 #define _gz_tensor_zero(Shape, ShapeLength, TYPE, ShouldGrad, Arena) \
-    _gzTensorAlloc##TYPE(Shape, ShapeLength, 0, 0, true, ShouldGrad, Arena)
+    _gzTensorAlloc##TYPE(Shape, ShapeLength, 0, 0, ShouldGrad, true, Arena)
 #define gz_tensor_zero(Shape, TYPE, ShouldGrad, Arena) _gz_tensor_zero(Shape, gz_array_length(Shape), TYPE, ShouldGrad, Arena)
 
-internal void
-gzCalculateStride(u32 *Strides, u32 *Sizes, u32 Dim) {
-    /* NOTE(Abid): Calculate the strides given the tensor shape */
-    for(u32 Idx = 0; Idx < Dim; ++Idx) {
-        if(Sizes[Idx] == 1) {
-            Strides[Idx] = 0;
-            continue;
-        } else Strides[Idx] = 1;
-        for(u32 Jdx = Idx+1; Jdx < Dim; ++Jdx) {
-            Strides[Idx] *= Sizes[Jdx];
-        }
-    }
-}
-
 internal inline t32 *
 _gzTensorAllocf32(u32 *Shape, u32 ShapeLength, f32 *Data, size_t DataLength, bool ShouldGrad, bool ShouldZero, mem_arena *Arena)
 { __ALLOC_TENSOR_DTYPE(f32, ShouldGrad, Arena); }
@@ -124,108 +228,49 @@ _gzTensorAlloci32(u32 *Shape, u32 ShapeLength, i32 *Data, size_t DataLength, boo
 
 #define __TO_TENSOR_TYPE(type) dtype_##type; 
 
+/* NOTE(abid): Husks are never part of a graph, so they go without the autograd part of the header. */
+internal inline t32 *
+__gz_tensor_alloc_husk(u32 *Shape, u32 ShapeLength, mem_arena *Arena) {
+    usize DataSize = 1;
+    for(u32 Idx = 0; Idx < ShapeLength; ++Idx) DataSize *= Shape[Idx];
+    assert(DataSize != 0, "wrong shape given, cannot be zero");
+
+    t32 *Result = (t32 *)gzMemPushSizeAligned(gz_mem_arena_meta(Arena), sizeof(t32) + GZ_TENSOR_HEADER_NO_AUTOGRAD_SIZE,
+                                              sizeof(void *));
+    Result->Header = (tensor_header *)(Result+1);
+    Result->Data.Ptr = NULL;
+    Result->Data.DType = __TO_TENSOR_TYPE(f32);
+    Result->Grad.Ptr = NULL;
+    Result->Grad.DType = dtype_f32;
+    Result->Header->IsContiguous = true;
+    Result->Header->StorageNumElements = DataSize;
+    Result->Header->ShouldGrad = false;
+    Result->Header->HasAutograd = false;
+    Result->Header->Offset = 0;
+    __gz_tensor_set_shape(Result->Header, Shape, NULL, ShapeLength);
+
+    return Result;
+}
+
 internal inline t32 *
 _gz_tensor_alloc_huskf32_batched(u64 *unbatched_shape, u64 unbatched_shape_length, u64 batch_size,
                                  mem_arena *arena) {
-    t32 *Result = NULL;
-
-    u64 batched_shape_length = unbatched_shape_length+1;
-    size_t FinalSize = sizeof(t32) + sizeof(tensor_header) +
-                       3*(unbatched_shape_length+1)*sizeof(u32) + /* For Stride, Shape, SizesAccessPtr */
-                       2*sizeof(t32 *); /*  For tensor operands */
-
-    /* NOTE(Abid): Memory mapping */
-    Result = (t32 *)gzMemPushSize(arena, FinalSize); 
-    assert(Result, "storage memory cannot be allocated"); 
-    Result->Header = (tensor_header *)(Result+1); 
-    Result->Header->Sizes = (u32 *)(Result->Header+1); 
-    Result->Header->Strides = (u32 *)(Result->Header->Sizes + batched_shape_length); 
-    Result->Header->AccessSizes = (u32 *)(Result->Header->Strides + batched_shape_length); 
-    Result->Data.DType = __TO_TENSOR_TYPE(f32);
-    Result->Grad.DType = dtype_f32; 
-    Result->Header->IsContiguous = true; 
-    /* NOTE(Abid): Setting whether to compute the backward pass or not */ 
-    Result->Header->ShouldGrad = false; 
-    Result->Header->DerivedOp.TensorOp = op_none; 
-    Result->Header->DerivedOp.op_context = NULL;  
-    
-    Result->Header->DerivedOp.Operands = (t32 **)(Result->Header->AccessSizes + batched_shape_length); 
-    Result->Header->Offset = 0; 
-    Result->Header->Dim = (u32)batched_shape_length;
+    assert(unbatched_shape_length < GZ_TENSOR_MAX_DIMS, "tensor dim %u is too high", (u32)unbatched_shape_length+1);
     /* TODO(abid): Convert `Sizes`, `Strides` and `Offset` to u64 at some point. */
-    Result->Header->Sizes[0] = (u32)batch_size;
-    memcpy(Result->Header->Sizes + 1, unbatched_shape, unbatched_shape_length*sizeof(u32)); 
-
-    /* NOTE(abid): Calculate number of elements. */
-    Result->Header->StorageNumElements = 1;
-    for(u32 idx = 0; idx < unbatched_shape_length; ++idx)
-        Result->Header->StorageNumElements *= unbatched_shape[idx];
-    Result->Header->StorageNumElements *= batch_size;
-    assert(Result->Header->StorageNumElements != 0, "wrong shape given, cannot be zero");
-    
-    /* NOTE(Abid): Calculate the strides given the tensor shape */      
-    for(u32 Idx = 0; Idx < Result->Header->Dim; ++Idx) {                
-        if(Result->Header->Sizes[Idx] == 1) {                           
-            Result->Header->Strides[Idx] = 0;                           
-            continue;                                                   
-        } else Result->Header->Strides[Idx] = 1;                        
-
-        for(u32 Jdx = Idx+1; Jdx < Result->Header->Dim; ++Jdx) {        
-            Result->Header->Strides[Idx] *= Result->Header->Sizes[Jdx]; 
-        }                                                               
-    }                                                                   
-    
-    return Result;
+    u32 shape[GZ_TENSOR_MAX_DIMS];
+    shape[0] = (u32)batch_size;
+    for(u64 idx = 0; idx < unbatched_shape_length; ++idx) shape[idx+1] = (u32)unbatched_shape[idx];
+
+    return __gz_tensor_alloc_husk(shape, (u32)unbatched_shape_length+1, arena);
 }
 
 internal inline t32 *
 _gz_tensor_alloc_huskf32(u64 *shape, u64 shape_length, mem_arena *arena) { 
-    t32 *Result = NULL;
-
-    size_t DataSize = 1;
-    for (u32 i = 0; i < shape_length; ++i) { DataSize *= shape[i]; }
-    assert(DataSize != 0, "wrong shape given, cannot be zero");
+    assert(shape_length <= GZ_TENSOR_MAX_DIMS, "tensor dim %u is too high", (u32)shape_length);
+    u32 narrow_shape[GZ_TENSOR_MAX_DIMS];
+    for(u64 idx = 0; idx < shape_length; ++idx) narrow_shape[idx] = (u32)shape[idx];
 
-    u64 AllocShapeLength = shape_length;
-    if(shape_length == 1) ++AllocShapeLength;
-    size_t FinalSize = sizeof(t32) + sizeof(tensor_header) +
-                       3*AllocShapeLength*sizeof(u32) + /* For Stride, Shape, SizesAccessPtr */
-                       2*sizeof(t32 *); /*  For tensor operands */
-
-    /* NOTE(Abid): Memory mapping */
-    Result = (t32 *)gzMemPushSize(arena, FinalSize); 
-    assert(Result, "storage memory cannot be allocated"); 
-    Result->Header = (tensor_header *)(Result+1); 
-    Result->Header->Sizes = (u32 *)(Result->Header+1); 
-    Result->Header->Strides = (u32 *)(Result->Header->Sizes + AllocShapeLength); 
-    Result->Header->AccessSizes = (u32 *)(Result->Header->Strides + AllocShapeLength); 
-    Result->Data.DType = __TO_TENSOR_TYPE(f32);
-    Result->Grad.DType = dtype_f32; 
-    Result->Header->IsContiguous = true; 
-    Result->Header->StorageNumElements = DataSize; 
-    /* NOTE(Abid): Setting whether to compute the backward pass or not */ 
-    Result->Header->ShouldGrad = false; 
-    Result->Header->DerivedOp.TensorOp = op_none; 
-    Result->Header->DerivedOp.op_context = NULL;
-    
-    Result->Header->DerivedOp.Operands = (t32 **)(Result->Header->AccessSizes + AllocShapeLength); 
-    Result->Header->Offset = 0; 
-    /* TODO(abid): Convert `Sizes`, `Strides` and `Offset` to u64 at some point. */
-    Result->Header->Dim = (u32)shape_length; 
-    memcpy(Result->Header->Sizes, shape, AllocShapeLength*sizeof(u32)); 
-    
-    /* NOTE(Abid): Calculate the strides given the tensor shape */      
-    for(u32 Idx = 0; Idx < Result->Header->Dim; ++Idx) {                
-        if(Result->Header->Sizes[Idx] == 1) {                           
-            Result->Header->Strides[Idx] = 0;                           
-            continue;                                                   
-        } else Result->Header->Strides[Idx] = 1;                        
-        for(u32 Jdx = Idx+1; Jdx < Result->Header->Dim; ++Jdx) {        
-            Result->Header->Strides[Idx] *= Result->Header->Sizes[Jdx]; 
-        }                                                               
-    }                                                                   
-    
-    return Result;
+    return __gz_tensor_alloc_husk(narrow_shape, (u32)shape_length, arena);
 }
 
 #define gzTensorNormal(Shape, Mean, Std, ShouldGrad, Arena) _gzTensorNormal(Shape, gz_array_length(Shape), Mean, Std, ShouldGrad, Arena)
@@ -234,7 +279,7 @@ _gzTensorNormal(u32 *Shape, u32 ShapeLength, f64 Mean, f64 Std, bool ShouldGrad,
     t32 *Tensor = _gzTensorAllocf32(Shape, ShapeLength, 0, 0, ShouldGrad, false, Arena);
 
     size_t NumData = Tensor->Header->StorageNumElements;
-    for(size_t Idx = 0; Idx <= NumData; ++Idx) {
+    for(size_t Idx = 0; Idx < NumData; ++Idx) {
         *((f32 *)Tensor->Data.Ptr + Idx) = (f32)gzRandNormal(Mean, Std);
     }
 
@@ -276,7 +321,10 @@ gzIsArrayEqual(u32 *Array1, u32 *Array2, u32 Array1Length, u32 Array2Length) {
 }
 
 internal inline bool
-gzIsShapeEqual(tensor_header *A, tensor_header *B) { return gzIsArrayEqual(A->Sizes, B->Sizes, A->Dim, B->Dim); }
+gzIsShapeEqual(tensor_header *A, tensor_header *B) {
+    /* NOTE(abid): Same interned sizes, same shape. Different ones may still differ only in strides. */
+    return ((A->Sizes == B->Sizes) && (A->Dim == B->Dim)) || gzIsArrayEqual(A->Sizes, B->Sizes, A->Dim, B->Dim);
+}
 
 /* TODO(Abid): Implement for unit testing */
 #if 0
@@ -356,6 +404,25 @@ gzSwapDataGrad(t32 *Tensor) {
     Tensor->Data = Grad;
 }
 
+/* NOTE(abid): Records the op and its operand(s) for backprop. Outside of grad mode nothing is recorded,
+ *             and tensors that were made in that mode have no room for it either. */
+internal inline bool
+__gz_record_op(t32 *Result, tensor_op Op, t32 *A, t32 *B) {
+    bool IsRecorded = IS_GRAD_PRESERVE() && Result->Header->HasAutograd;
+    Result->Header->ShouldGrad = IsRecorded && (A->Header->ShouldGrad || (B && B->Header->ShouldGrad));
+    if(IsRecorded) {
+        Result->Header->DerivedOp.TensorOp = Op;
+        Result->Header->DerivedOp.Operands[0] = A;
+        Result->Header->DerivedOp.Operands[1] = B;
+    }
+
+    return IsRecorded;
+}
+
+/* NOTE(abid): The op of the tensor, where graphless tensors count as leaves. */
+internal inline tensor_op
+gz_tensor_op(t32 *A) { return A->Header->HasAutograd ? A->Header->DerivedOp.TensorOp : op_none; }
+
 /* =======================================
  * NOTE(Abid): Math Operations
  * ======================================= */
@@ -370,24 +437,23 @@ gzReduceSumAll_(t32 *A, t32 *Result) {
     switch (A->Data.DType) {
         case dtype_f32: {
             for(i32 Idx = 0; Idx < A->Header->StorageNumElements; ++Idx)
-                ResSum += *(f32 *)A->Data.Ptr + Idx;
+                ResSum += ((f32 *)A->Data.Ptr)[Idx];
         } break;
         case dtype_i32: {
             for(i32 Idx = 0; Idx < A->Header->StorageNumElements; ++Idx)
-                ResSum += *(f32 *)A->Data.Ptr + Idx;
+                ResSum += (f32)((i32 *)A->Data.Ptr)[Idx];
         } break;
         default: assert(0, "invalid code path");
     }
     if(Result->Data.DType == dtype_i32) *(i32 *)Result->Data.Ptr = (i32)ResSum;
     else *(f32 *)Result->Data.Ptr = ResSum;
 
-    Result->Header->DerivedOp.TensorOp = op_unary_reduce_sum_all;
-    Result->Header->DerivedOp.Operands[0] = A;
+    __gz_record_op(Result, op_unary_reduce_sum_all, A, NULL);
 }
 internal inline t32 *
 gzReduceSumAll(t32 *A, mem_arena *Arena) {
     u32 ResultShape[] = {1};
-    t32 *Result = _gzTensorAllocf32(ResultShape, 1, 0, 0, A->Header->ShouldGrad, false, Arena);
+    t32 *Result = _gzTensorAllocf32(ResultShape, 1, 0, 0, false, false, Arena);
     gzReduceSumAll_(A, Result);
 
     return Result;
@@ -396,10 +462,11 @@ gzReduceSumAll(t32 *A, mem_arena *Arena) {
 /* NOTE(Abid): Main routines for elementwise binary operations. */
 internal inline void
 _CheckEndofDimAndUpdate(tensor_header *AHeader, tensor_header *BHeader, tensor_header *ResultHeader,
+                        u32 *AAccessSizes, u32 *BAccessSizes, u32 *ResultAccessSizes,
                         size_t *AOffset, size_t *BOffset, size_t *ResultOffset) {
     u32 DimIdx = 1;
     /* NOTE(Abid): If we've reached the end of the this dim in result tensor */
-    while(ResultHeader->AccessSizes[ResultHeader->Dim- DimIdx] == ResultHeader->Sizes[ResultHeader->Dim- DimIdx]) {
+    while(ResultAccessSizes[ResultHeader->Dim- DimIdx] == ResultHeader->Sizes[ResultHeader->Dim- DimIdx]) {
         /* NOTE(Abid): If there is nothing left to calculate */
         if(ResultHeader->Dim - DimIdx == 0) break;
 
@@ -409,37 +476,37 @@ _CheckEndofDimAndUpdate(tensor_header *AHeader, tensor_header *BHeader, tensor_h
 
         if(ACurrentDim <= 0) { 
             *AOffset = 0;
-            AHeader->AccessSizes[0] = 0;
+            AAccessSizes[0] = 0;
             /* NOTE(Abid): Then B tensor is the one with greater dim */
-            BHeader->AccessSizes[BCurrentDim] = 0;
-            ++BHeader->AccessSizes[BCurrentDim-1];
+            BAccessSizes[BCurrentDim] = 0;
+            ++BAccessSizes[BCurrentDim-1];
             *BOffset -= BHeader->Strides[BCurrentDim]*BHeader->Sizes[BCurrentDim];
             *BOffset += BHeader->Strides[BCurrentDim-1];
         }
         else if(BCurrentDim <= 0) {
             *BOffset = 0;
-            BHeader->AccessSizes[0] = 0;
+            BAccessSizes[0] = 0;
             /* NOTE(Abid): Then A tensor is the one with greater dim */
-            AHeader->AccessSizes[ACurrentDim] = 0;
-            ++AHeader->AccessSizes[ACurrentDim-1];
+            AAccessSizes[ACurrentDim] = 0;
+            ++AAccessSizes[ACurrentDim-1];
             *AOffset -= AHeader->Strides[ACurrentDim]*AHeader->Sizes[ACurrentDim];
             *AOffset += AHeader->Strides[ACurrentDim-1];
         }
         else {
             /* NOTE(Abid): Both tensors have dim in this case */
-            AHeader->AccessSizes[ACurrentDim] = 0;
-            ++AHeader->AccessSizes[ACurrentDim-1];
+            AAccessSizes[ACurrentDim] = 0;
+            ++AAccessSizes[ACurrentDim-1];
             *AOffset -= AHeader->Strides[ACurrentDim]*AHeader->Sizes[ACurrentDim];
             *AOffset += AHeader->Strides[ACurrentDim-1];
 
-            BHeader->AccessSizes[BCurrentDim] = 0;
-            ++BHeader->AccessSizes[BCurrentDim-1];
+            BAccessSizes[BCurrentDim] = 0;
+            ++BAccessSizes[BCurrentDim-1];
             *BOffset -= BHeader->Strides[BCurrentDim]*BHeader->Sizes[BCurrentDim];
             *BOffset += BHeader->Strides[BCurrentDim-1];
         }
 
-        ResultHeader->AccessSizes[ResultCurrentDim] = 0;
-        ++ResultHeader->AccessSizes[ResultCurrentDim-1];
+        ResultAccessSizes[ResultCurrentDim] = 0;
+        ++ResultAccessSizes[ResultCurrentDim-1];
         *ResultOffset -= ResultHeader->Strides[ResultCurrentDim]*ResultHeader->Sizes[ResultCurrentDim];
         *ResultOffset += ResultHeader->Strides[ResultCurrentDim-1];
         ++(DimIdx);
@@ -458,11 +525,12 @@ _CheckEndofDimAndUpdate(tensor_header *AHeader, tensor_header *BHeader, tensor_h
         i32 ACurrentDim = (i32)A->Header->Dim - DimIdx; \
         i32 BCurrentDim = (i32)B->Header->Dim - DimIdx; \
         i32 ResultCurrentDim = (i32)Result->Header->Dim - DimIdx; \
-        AOffset += A->Header->Strides[ACurrentDim]; ++A->Header->AccessSizes[ACurrentDim]; \
-        BOffset += B->Header->Strides[BCurrentDim]; ++B->Header->AccessSizes[BCurrentDim]; \
-        ResultOffset += Result->Header->Strides[ResultCurrentDim]; ++Result->Header->AccessSizes[ResultCurrentDim]; \
+        AOffset += A->Header->Strides[ACurrentDim]; ++AAccessSizes[ACurrentDim]; \
+        BOffset += B->Header->Strides[BCurrentDim]; ++BAccessSizes[BCurrentDim]; \
+        ResultOffset += Result->Header->Strides[ResultCurrentDim]; ++ResultAccessSizes[ResultCurrentDim]; \
         \
-        _CheckEndofDimAndUpdate(A->Header, B->Header, Result->Header, &AOffset, &BOffset, &ResultOffset); \
+        _CheckEndofDimAndUpdate(A->Header, B->Header, Result->Header, AAccessSizes, BAccessSizes, ResultAccessSizes, \
+                                &AOffset, &BOffset, &ResultOffset); \
         --ResDataLeft; \
     }
 
@@ -492,10 +560,10 @@ _CheckEndofDimAndUpdate(tensor_header *AHeader, tensor_header *BHeader, tensor_h
     uintptr ResultOffset = 0; \
     u32 DimIdx = 1; \
     \
-    memset(Result->Header->AccessSizes, 0, Result->Header->Dim*sizeof(u32)); \
-    memset(A->Header->AccessSizes, 0, A->Header->Dim*sizeof(u32)); \
-    memset(B->Header->AccessSizes, 0, B->Header->Dim*sizeof(u32)); \
-    Result->Header->ShouldGrad = IS_GRAD_PRESERVE(); \
+    /* NOTE(abid): Where the walk is in each dim, kept on the stack since the headers are shared. */ \
+    u32 AAccessSizes[GZ_TENSOR_MAX_DIMS] = {0}; \
+    u32 BAccessSizes[GZ_TENSOR_MAX_DIMS] = {0}; \
+    u32 ResultAccessSizes[GZ_TENSOR_MAX_DIMS] = {0}; \
     \
     bin_op_dtypes OpDTypes = bin_op_dtypes_all_float; /* Assuming all f32 types initially. */ \
     if(A->Data.DType == B->Data.DType) { if(A->Data.DType == dtype_i32) OpDTypes = 2; } \
@@ -528,31 +596,19 @@ typedef enum {
 } bin_op_dtypes;
 internal void gzAdd(t32 *A, t32 *B, t32 *Result) {
     __BIN_ELEMENTWISE_OP(A, B, Result, +);
-
-    Result->Header->DerivedOp.TensorOp = op_binary_add;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
+    __gz_record_op(Result, op_binary_add, A, B);
 }
 internal void gzSub(t32 *A, t32 *B, t32 *Result) {
     __BIN_ELEMENTWISE_OP(A, B, Result, -);
-
-    Result->Header->DerivedOp.TensorOp = op_binary_sub;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
+    __gz_record_op(Result, op_binary_sub, A, B);
 }
 internal void gzMul(t32 *A, t32 *B, t32 *Result) {
     __BIN_ELEMENTWISE_OP(A, B, Result, *);
-
-    Result->Header->DerivedOp.TensorOp = op_binary_mul;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
+    __gz_record_op(Result, op_binary_mul, A, B);
 }
 internal void gzDiv(t32 *A, t32 *B, t32 *Result) {
     __BIN_ELEMENTWISE_OP(A, B, Result, /);
-
-    Result->Header->DerivedOp.TensorOp = op_binary_div;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
+    __gz_record_op(Result, op_binary_div, A, B);
 }
 #undef __BIN_ELEMENTWISE_OP_DTYPE
 #undef __BIN_ELEMENTWISE_OP
@@ -581,7 +637,7 @@ gzGetIndex(u32 Dim, i32 Index) {
             BOffset += B->Header->Strides[BSecondLastIdx]; \
         } \
         *((R_DTYPE *)Result->Data.Ptr + ResultOffset) OP (R_DTYPE)DotResult; \
-        ++Result->Header->AccessSizes[Result->Header->Dim-1]; \
+        ++ResultAccessSizes[Result->Header->Dim-1]; \
         \
         AOffset -= A->Header->Strides[ALastIdx]*A->Header->Sizes[ALastIdx]; \
         BOffset -= B->Header->Strides[BSecondLastIdx]*B->Header->Sizes[BSecondLastIdx]; \
@@ -589,24 +645,24 @@ gzGetIndex(u32 Dim, i32 Index) {
         \
         /* NOTE(Abid): If Result dim = 1, then it won't go beyond this point. */ \
         /* NOTE(Abid): In case we have reached the end of the result tensor row. */ \
-        if(Result->Header->AccessSizes[Result->Header->Dim-1] == Result->Header->Sizes[Result->Header->Dim-1]) { \
+        if(ResultAccessSizes[Result->Header->Dim-1] == Result->Header->Sizes[Result->Header->Dim-1]) { \
             ResultOffset -= Result->Header->Strides[Result->Header->Dim-1]*(Result->Header->Sizes[Result->Header->Dim-1]-1); \
-            Result->Header->AccessSizes[Result->Header->Dim-1] = 0; \
+            ResultAccessSizes[Result->Header->Dim-1] = 0; \
             \
             if(ResLastBroadDim > 2) { \
-                ++Result->Header->AccessSizes[Result->Header->Dim-2]; \
-                if(Result->Header->AccessSizes[Result->Header->Dim-2] == Result->Header->Sizes[Result->Header->Dim-2]) { \
+                ++ResultAccessSizes[Result->Header->Dim-2]; \
+                if(ResultAccessSizes[Result->Header->Dim-2] == Result->Header->Sizes[Result->Header->Dim-2]) { \
                     /* NOTE(Abid): We've reached the end, begin broadcast semantics for matrix... */ \
                     IsBroadcastDim = true; \
                     \
                     /* NOTE(Abid): Zero out matrix multiplication dimensions, and take offsets to the start. */ \
                     AOffset -= A->Header->Strides[ASecondLastIdx]*(A->Header->Sizes[ASecondLastIdx]-1); \
-                    A->Header->AccessSizes[ALastIdx] = 0; A->Header->AccessSizes[ASecondLastIdx] = 0; \
+                    AAccessSizes[ALastIdx] = 0; AAccessSizes[ASecondLastIdx] = 0; \
                     \
                     BOffset -= B->Header->Strides[BLastIdx]*(B->Header->Sizes[BLastIdx]-1); \
-                    B->Header->AccessSizes[BLastIdx] = 0; B->Header->AccessSizes[BSecondLastIdx] = 0; \
+                    BAccessSizes[BLastIdx] = 0; BAccessSizes[BSecondLastIdx] = 0; \
                     \
-                    Result->Header->AccessSizes[Result->Header->Dim - (ResLastBroadDim-1)] = 0; \
+                    ResultAccessSizes[Result->Header->Dim - (ResLastBroadDim-1)] = 0; \
                     ResultOffset -= Result->Header->Strides[Result->Header->Dim-2]*(Result->Header->Sizes[Result->Header->Dim-2]-1); \
                 } else { \
                     AOffset += A->Header->Strides[ASecondLastIdx]; /* Going to the next column element (start of next row). */ \
@@ -621,15 +677,15 @@ gzGetIndex(u32 Dim, i32 Index) {
                 if(A->Header->Dim > B->Header->Dim) { \
                     /* NOTE(Abid): BOffset needs to be zero'd out */ \
                     AOffset -= A->Header->Strides[ASecondLastIdx]*(A->Header->Sizes[ASecondLastIdx]-2); \
-                    A->Header->AccessSizes[ALastIdx] = 0; A->Header->AccessSizes[ASecondLastIdx] = 0; \
+                    AAccessSizes[ALastIdx] = 0; AAccessSizes[ASecondLastIdx] = 0; \
                     BOffset = 0; \
                 } else { \
                     /* NOTE(Abid): AOffset needs to be zero'd out */ \
                     BOffset -= B->Header->Strides[BLastIdx]*(B->Header->Sizes[BLastIdx]-2); \
-                    B->Header->AccessSizes[BLastIdx] = 0; B->Header->AccessSizes[BSecondLastIdx] = 0; \
+                    BAccessSizes[BLastIdx] = 0; BAccessSizes[BSecondLastIdx] = 0; \
                     AOffset = 0; \
                 } \
-                Result->Header->AccessSizes[Result->Header->Dim - (ResLastBroadDim-1)] = 0; \
+                ResultAccessSizes[Result->Header->Dim - (ResLastBroadDim-1)] = 0; \
             } \
         } else { \
             BOffset += B->Header->Strides[B->Header->Dim-1]; /* Going to the next row element (start of next column). */ \
@@ -643,34 +699,34 @@ gzGetIndex(u32 Dim, i32 Index) {
                 i32 CurABroadIdx = (i32)A->Header->Dim - CurrenntDimIdx; \
                 i32 CurBBroadIdx = (i32)B->Header->Dim - CurrenntDimIdx; \
                 \
-                if(Result->Header->AccessSizes[CurResBroadIdx]+1 == \
+                if(ResultAccessSizes[CurResBroadIdx]+1 == \
                    Result->Header->Sizes[CurResBroadIdx]) { \
                     /* NOTE(Abid): We are at the end of this broadcast dimension */ \
-                    Result->Header->AccessSizes[CurResBroadIdx] = 0; \
+                    ResultAccessSizes[CurResBroadIdx] = 0; \
                     ResultOffset -= Result->Header->Strides[CurResBroadIdx]*Result->Header->Sizes[CurResBroadIdx]; \
                     if(CurABroadIdx >= 0) { \
-                        A->Header->AccessSizes[CurABroadIdx] = 0; \
+                        AAccessSizes[CurABroadIdx] = 0; \
                         AOffset -= A->Header->Strides[CurABroadIdx]*A->Header->Sizes[CurABroadIdx]; \
                     } else { \
-                        memset(A->Header->AccessSizes, 0, A->Header->Dim*sizeof(u32)); \
+                        memset(AAccessSizes, 0, A->Header->Dim*sizeof(u32)); \
                         AOffset = 0; \
                     } \
                     if(CurBBroadIdx >= 0) { \
-                        B->Header->AccessSizes[CurBBroadIdx] = 0; \
+                        BAccessSizes[CurBBroadIdx] = 0; \
                         BOffset -= B->Header->Strides[CurBBroadIdx]*B->Header->Sizes[CurBBroadIdx]; \
                     } else { \
-                        memset(A->Header->AccessSizes, 0, A->Header->Dim*sizeof(u32)); \
+                        memset(AAccessSizes, 0, A->Header->Dim*sizeof(u32)); \
                         BOffset = 0; \
                     } \
                 } else { \
-                    ++Result->Header->AccessSizes[CurResBroadIdx]; \
+                    ++ResultAccessSizes[CurResBroadIdx]; \
                     ResultOffset += Result->Header->Strides[CurResBroadIdx]; \
                     if(CurABroadIdx >= 0) { \
-                        ++A->Header->AccessSizes[CurABroadIdx]; \
+                        ++AAccessSizes[CurABroadIdx]; \
                         AOffset += A->Header->Strides[CurABroadIdx]; \
                     } \
                     if(CurBBroadIdx >= 0) { \
-                        ++B->Header->AccessSizes[CurBBroadIdx]; \
+                        ++BAccessSizes[CurBBroadIdx]; \
                         BOffset += B->Header->Strides[CurBBroadIdx]; \
                     } \
                     break; \
@@ -680,6 +736,62 @@ gzGetIndex(u32 Dim, i32 Index) {
         } \
     }
 
+/* NOTE(abid): The last two dims of a matmul tensor as a matrix. A vector is taken as a row when it is the
+ *             first operand (`VectorPos` of 0), and as a column when it is the second one. */
+internal inline matrix_layout
+__gzMatrixLayout(t32 *A, u32 VectorPos) {
+    matrix_layout Result = {0};
+    if(A->Header->Dim == 1) {
+        u32 Size = A->Header->Sizes[0];
+        usize Stride = A->Header->Strides[0];
+        Result.rows = VectorPos ? Size : 1;
+        Result.cols = VectorPos ? 1 : Size;
+        Result.row_stride = VectorPos ? Stride : 0;
+        Result.col_stride = VectorPos ? 0 : Stride;
+    } else {
+        Result.rows = GetSizeR(A, 1);
+        Result.cols = GetSizeR(A, 0);
+        Result.row_stride = GetStrideR(A, 1);
+        Result.col_stride = GetStrideR(A, 0);
+    }
+
+    return Result;
+}
+
+/* NOTE(abid): Offset of the matrix that takes part in the given batch of the result, broadcast dims stay put. */
+internal inline usize
+__gzMatMulBatchOffset(t32 *A, t32 *Parent, usize BatchIdx) {
+    usize Offset = 0;
+    for(u32 DimIdx = 2; DimIdx < Parent->Header->Dim; ++DimIdx) {
+        u32 Size = GetSizeR(Parent, DimIdx);
+        usize Pos = BatchIdx % Size;
+        BatchIdx /= Size;
+        if((DimIdx < A->Header->Dim) && (GetSizeR(A, DimIdx) != 1)) Offset += Pos*GetStrideR(A, DimIdx);
+    }
+
+    return Offset;
+}
+
+/* NOTE(abid): One GEMM for every batch of the result. */
+internal void
+__gzMatMulGemm(t32 *A, t32 *B, t32 *Result) {
+    matrix_layout ALayout = __gzMatrixLayout(A, 0);
+    matrix_layout BLayout = __gzMatrixLayout(B, 1);
+    matrix_layout CLayout = __gzMatrixLayout(Result, 0);
+
+    usize NumBatches = 1;
+    for(u32 DimIdx = 2; DimIdx < Result->Header->Dim; ++DimIdx) NumBatches *= GetSizeR(Result, DimIdx);
+
+    memset(Result->Data.Ptr, 0, Result->Header->StorageNumElements*sizeof(f32));
+    for(usize BatchIdx = 0; BatchIdx < NumBatches; ++BatchIdx) {
+        gz_gemm_f32(false, false, CLayout.rows, CLayout.cols, ALayout.cols,
+                    (f32 *)A->Data.Ptr + __gzMatMulBatchOffset(A, Result, BatchIdx), ALayout.row_stride, ALayout.col_stride,
+                    (f32 *)B->Data.Ptr + __gzMatMulBatchOffset(B, Result, BatchIdx), BLayout.row_stride, BLayout.col_stride,
+                    (f32 *)Result->Data.Ptr + __gzMatMulBatchOffset(Result, Result, BatchIdx),
+                    CLayout.row_stride, CLayout.col_stride);
+    }
+}
+
 /* TODO(Abid): This really needs to be refactored */
 internal void 
 gzMatMul(t32 *A, t32 *B, t32 *Result) {
@@ -736,12 +848,9 @@ gzMatMul(t32 *A, t32 *B, t32 *Result) {
     uintptr BOffset = 0;
     uintptr ResultOffset = 0;
 
-    memset(Result->Header->AccessSizes, 0, Result->Header->Dim*sizeof(u32));
-    memset(A->Header->AccessSizes, 0, A->Header->Dim*sizeof(u32));
-    memset(B->Header->AccessSizes, 0, B->Header->Dim*sizeof(u32));
-
-    /* NOTE(Abid): Are we allowed to backprop through this operation? */
-    Result->Header->ShouldGrad = IS_GRAD_PRESERVE();
+    u32 AAccessSizes[GZ_TENSOR_MAX_DIMS] = {0};
+    u32 BAccessSizes[GZ_TENSOR_MAX_DIMS] = {0};
+    u32 ResultAccessSizes[GZ_TENSOR_MAX_DIMS] = {0};
 
     i32 IsBroadcastDim = false; /* Last if we count from the right */
     
@@ -753,7 +862,7 @@ gzMatMul(t32 *A, t32 *B, t32 *Result) {
     if(Result->Data.DType == dtype_i32) OpDTypes += 1; /* Determining the result data type */
 
     switch(OpDTypes) {
-        case bin_op_dtypes_all_float:       { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, f32, f32, =); } break;
+        case bin_op_dtypes_all_float:       { __gzMatMulGemm(A, B, Result); } break;
         case bin_op_dtypes_float_float_int: { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, f32, i32, =); } break;
         case bin_op_dtypes_int_int_float:   { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, i32, f32, =); } break;
         case bin_op_dtypes_all_int:         { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, i32, i32, =); } break;
@@ -764,94 +873,10 @@ gzMatMul(t32 *A, t32 *B, t32 *Result) {
         default:                            assert(0, "Invalid Code Path");
     }
 
-    Result->Header->DerivedOp.TensorOp = op_binary_matmul;
-    Result->Header->DerivedOp.Operands[0] = A;
-    Result->Header->DerivedOp.Operands[1] = B;
-}
-
-internal void
-__gzMatMulAccumulate(t32 *A, t32 *B, t32 *Result) {
-    /* NOTE(Abid): assert greater dim is the same as the result tensors' dim */
-    u32 GreaterDim = 0;
-    u32 LesserDim = 0;
-    u32 ResLastBroadDim = 0;
-
-    if(A->Header->Dim > B->Header->Dim) { GreaterDim = A->Header->Dim; LesserDim = B->Header->Dim; }
-    else { GreaterDim = B->Header->Dim; LesserDim = A->Header->Dim; }
-    if(LesserDim > 1) ResLastBroadDim = 3;
-    else ResLastBroadDim = 2;
-    assert(Result->Header->Dim == GreaterDim, "result-operand(s) dimension mismatch");
-
-    u32 ALastIdx = gzGetIndex(A->Header->Dim, -1);
-    u32 ASecondLastIdx = gzGetIndex(A->Header->Dim, -2);
-
-    u32 BLastIdx = gzGetIndex(B->Header->Dim, -1);
-    u32 BSecondLastIdx = gzGetIndex(B->Header->Dim, -2);
-    /* NOTE(Abid): Assert here the tensor operand(s) can be matrix-multiplied */
-    assert(A->Header->Sizes[ALastIdx] == B->Header->Sizes[BSecondLastIdx],
-           "operand(s) shape mismatch for MatMul operation");
-
-    /* NOTE(Abid): Assert the shapes of the result tensor match with the MatMul operation's required shape.
-     *             1. In case, the lesserDim is 1, then we expect the last dimension of result to be 1 as well
-     *             2. Otherwise, the dimensions must match with the result of the MatMul operation. */
-    assert(((LesserDim > 1) && (
-                                    (A->Header->Sizes[gzGetIndex(A->Header->Dim, -2)] ==
-                                     Result->Header->Sizes[gzGetIndex(Result->Header->Dim, -2)]) &&
-                                    (B->Header->Sizes[gzGetIndex(B->Header->Dim, -1)] ==
-                                     Result->Header->Sizes[gzGetIndex(Result->Header->Dim, -1)])
-                               )
-           ) || ((LesserDim == 1) && (B->Header->Dim == 1 ? Result->Header->Sizes[gzGetIndex(Result->Header->Dim, - 1)] == 1 :
-                                                           Result->Header->Sizes[gzGetIndex(Result->Header->Dim, - 2)] == 1)),
-           "result-operand(s) shape mismatch for MatMul operation");
-
-    /* NOTE(Abid): Assert broadcast shape match */
-    for(u32 Idx = 3; Idx <= GreaterDim; ++Idx) {
-        u32 ASize = 0; u32 BSize = 0;
-        if((i32)(A->Header->Dim - Idx) >= 0) ASize = A->Header->Sizes[A->Header->Dim - Idx];
-        if((i32)(B->Header->Dim - Idx) >= 0) BSize = B->Header->Sizes[B->Header->Dim - Idx];
-        /* NOTE(Abid): Check for shape alignment for the operands */
-        bool IsAGreater = ASize > BSize;
-        assert((IsAGreater && ((BSize == 1) || (BSize == 0))) ||
-               ((BSize > ASize) && ((ASize == 1) || (ASize == 0))) ||
-               (BSize == ASize), "operand(s) shape mismatch");
-        u32 GreaterSize = IsAGreater ? ASize : BSize;
-        assert(Result->Header->Sizes[Result->Header->Dim - Idx] == GreaterSize, "result-operand(s) shape mismatch");
-    }
-
-    /* NOTE(Abid): Initialize variables */
-    i64 ResDataLeft = Result->Header->StorageNumElements;
-    uintptr AOffset = 0;
-    uintptr BOffset = 0;
-    uintptr ResultOffset = 0;
-
-    memset(Result->Header->AccessSizes, 0, Result->Header->Dim*sizeof(u32));
-    memset(A->Header->AccessSizes, 0, A->Header->Dim*sizeof(u32));
-    memset(B->Header->AccessSizes, 0, B->Header->Dim*sizeof(u32));
-
     /* NOTE(Abid): Are we allowed to backprop through this operation? */
-    Result->Header->ShouldGrad = IS_GRAD_PRESERVE();
-
-    i32 IsBroadcastDim = false; /* Last if we count from the right */
-    
-    bin_op_dtypes OpDTypes = bin_op_dtypes_all_float; /* Assuming all f32 types initially. */
-    if(A->Data.DType == B->Data.DType) { if(A->Data.DType == dtype_i32) OpDTypes = 2; }
-    else if(A->Data.DType == dtype_i32) { OpDTypes = 6; } /* A is i32, B is f32 */
-    else OpDTypes = 4; /* A is f32, B is i32 */
-
-    if(Result->Data.DType == dtype_i32) OpDTypes += 1; /* Determining the result data type */
-
-    switch(OpDTypes) {
-        case bin_op_dtypes_all_float:       { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, f32, f32, +=); } break;
-        case bin_op_dtypes_float_float_int: { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, f32, i32, +=); } break;
-        case bin_op_dtypes_int_int_float:   { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, i32, f32, +=); } break;
-        case bin_op_dtypes_all_int:         { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, i32, i32, +=); } break;
-        case bin_op_dtypes_float_int_float: { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, i32, f32, +=); } break;
-        case bin_op_dtypes_float_int_int:   { __GZ_BIN_MATMUL_DTYPE(A, B, Result, f32, i32, i32, +=); } break;
-        case bin_op_dtypes_int_float_float: { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, f32, f32, +=); } break;
-        case bin_op_dtypes_int_float_int:   { __GZ_BIN_MATMUL_DTYPE(A, B, Result, i32, f32, i32, +=); } break;
-        default:                            assert(0, "Invalid Code Path");
-    }
+    __gz_record_op(Result, op_binary_matmul, A, B);
 }
+
 #undef __BIN_MATMUL_DTYPE
 /* NOTE(Abid): Main routines for Unary operations */
 /* TODO(Abid): Implement T32ElementOp here */
@@ -889,13 +914,12 @@ gz_sigmoid_(t32 *A, t32 *Result) {
     assert((A->Data.DType == Result->Data.DType) & (A->Data.DType == dtype_f32),
            "sigmoid require tensor(s) to be of type f32");
     __gzSigmoidOnStorage(A->Header, A->Data.Ptr, Result->Header, Result->Data.Ptr);
-    Result->Header->DerivedOp.TensorOp = op_unary_sigmoid;
-    Result->Header->DerivedOp.Operands[0] = A;
+    __gz_record_op(Result, op_unary_sigmoid, A, NULL);
 }
 
 inline internal t32 *
 gz_sigmoid(t32 *tensor, mem_arena *arena) {
-    t32 *result = _gzTensorAllocf32(tensor->Header->Sizes, tensor->Header->Dim, 0, 0, tensor->Header->ShouldGrad, false, arena);
+    t32 *result = _gzTensorAllocf32(tensor->Header->Sizes, tensor->Header->Dim, 0, 0, false, false, arena);
     gz_sigmoid_(tensor, result);
 
     return result;
@@ -932,13 +956,12 @@ _gz_relu(t32 *A, t32 *Result) {
         }
     }
 
-    Result->Header->DerivedOp.TensorOp = op_unary_relu;
-    Result->Header->DerivedOp.Operands[0] = A;
+    __gz_record_op(Result, op_unary_relu, A, NULL);
 }
 
 internal inline t32 *
 gz_relu(t32 *A, mem_arena *Arena) {
-    t32 *Result = _gzTensorAllocf32(A->Header->Sizes, A->Header->Dim, 0, 0, A->Header->ShouldGrad, false, Arena);
+    t32 *Result = _gzTensorAllocf32(A->Header->Sizes, A->Header->Dim, 0, 0, false, false, Arena);
     _gz_relu(A, Result);
 
     return Result;
@@ -992,8 +1015,10 @@ _gzNewView(t32 *A, u32 *NewShape, u32 NewShapeLength, mem_arena *Arena) {
     assert(NewShapeLength > 0, "invalid view, dim cannot be %d", NewShapeLength);
     assert(gzValidateViewOnTensor(A, NewShape, NewShapeLength), "invalid view, shape-storage mismatch")
 
-    t32 *Result = gz_mem_push_struct(t32, Arena);
-    Result->Header = gz_mem_push_struct(tensor_header, Arena);
+    bool HasAutograd = IS_GRAD_PRESERVE();
+    usize HeaderSize = HasAutograd ? sizeof(tensor_header) : GZ_TENSOR_HEADER_NO_AUTOGRAD_SIZE;
+    t32 *Result = (t32 *)gzMemPushSizeAligned(gz_mem_arena_meta(Arena), sizeof(t32) + HeaderSize, sizeof(void *));
+    Result->Header = (tensor_header *)(Result+1);
 
     /* NOTE(Abid): Copy storage pointer and dtype */
     Result->Data.DType = A->Data.DType;
@@ -1002,24 +1027,38 @@ _gzNewView(t32 *A, u32 *NewShape, u32 NewShapeLength, mem_arena *Arena) {
     Result->Grad.Ptr = A->Grad.Ptr;
 
     /* NOTE(Abid): Copy tensor_header data */
-    Result->Header->Dim = NewShapeLength;
     Result->Header->Offset = A->Header->Offset;
-    Result->Header->ShouldGrad = A->Header->ShouldGrad;
     Result->Header->IsContiguous = A->Header->IsContiguous;
     Result->Header->StorageNumElements = A->Header->StorageNumElements;
 
-    /* NOTE(Abid): Stride and Sizes TODO: Must remove AccessSizes */
-    Result->Header->Sizes = gzMemPushArray(Arena, u32, 3*NewShapeLength);
-    Result->Header->Strides = Result->Header->Sizes + NewShapeLength;
-    Result->Header->AccessSizes = Result->Header->Strides + NewShapeLength;
-    memcpy(Result->Header->Sizes, NewShape, NewShapeLength*sizeof(u32));
-    gzCalculateStride(Result->Header->Strides, Result->Header->Sizes, Result->Header->Dim);
+    __gz_tensor_set_shape(Result->Header, NewShape, NULL, NewShapeLength);
+
+    __gz_mem_plan_on_alloc(Result, 0);
 
-    /* NOTE(Abid): Derived ops operand(s) */
-    Result->Header->DerivedOp.TensorOp = op_unary_view;
-    /* TODO(Abid): Could we just allocate ONE operand instead of two */
-    Result->Header->DerivedOp.Operands = gzMemPushArray(Arena, t32 *, 2);
-    Result->Header->DerivedOp.Operands[0] = A;
+    Result->Header->HasAutograd = HasAutograd;
+    if(HasAutograd) {
+        /* NOTE(abid): The view shares the grad of a leaf, a non-leaf gets its grad lazily during backprop. */
+        Result->Header->IsGradTransient = false;
+        Result->Header->BackwardRefCount = 0;
+        Result->Header->BackwardLock = 0;
+        Result->Header->BackwardReaders = 0;
+        Result->Header->GradHook = NULL;
+        Result->Header->DerivedOp.op_context = NULL;
+        Result->Header->DerivedOp.Operands[0] = Result->Header->DerivedOp.Operands[1] = NULL;
+    }
+    __gz_record_op(Result, op_unary_view, A, NULL);
+
+    return Result;
+}
+
+/* NOTE(abid): A leaf that shares the data and grad of `A`, i.e. backprop stops here and the grads that
+ *             arrive are added straight into the grad of `A`. */
+internal t32 *
+gz_tensor_detach(t32 *A, mem_arena *Arena) {
+    assert(IS_GRAD_PRESERVE(), "detaching a tensor only makes sense in grad mode");
+    t32 *Result = _gzNewView(A, A->Header->Sizes, A->Header->Dim, Arena);
+    Result->Header->DerivedOp.TensorOp = op_none;
+    Result->Header->DerivedOp.Operands[0] = NULL;
 
     return Result;
 }
@@ -1123,13 +1162,16 @@ __gzTransposeInPlaceNoGrad(t32 *A, i32 Dim1, i32 Dim2)
 
     assert(((i32)A->Header->Dim >= Dim1) && ((i32)A->Header->Dim >= Dim2), "dimension index out of bounds");
 
-    /* NOTE(Abid): Swap the sizes and strides */
-    u32 Temp = A->Header->Sizes[Dim1];
-    A->Header->Sizes[Dim1] = A->Header->Sizes[Dim2];
-    A->Header->Sizes[Dim2] = Temp;
-    Temp = A->Header->Strides[Dim1];
-    A->Header->Strides[Dim1] = A->Header->Strides[Dim2];
-    A->Header->Strides[Dim2] = Temp;
+    /* NOTE(Abid): Swap the sizes and strides, the interned ones are shared so this takes a new layout. */
+    u32 Sizes[GZ_TENSOR_MAX_DIMS];
+    u32 Strides[GZ_TENSOR_MAX_DIMS];
+    memcpy(Sizes, A->Header->Sizes, A->Header->Dim*sizeof(u32));
+    memcpy(Strides, A->Header->Strides, A->Header->Dim*sizeof(u32));
+    Sizes[Dim1] = A->Header->Sizes[Dim2];
+    Sizes[Dim2] = A->Header->Sizes[Dim1];
+    Strides[Dim1] = A->Header->Strides[Dim2];
+    Strides[Dim2] = A->Header->Strides[Dim1];
+    __gz_tensor_set_shape(A->Header, Sizes, Strides, A->Header->Dim);
 }
 
 inline internal void
@@ -1152,17 +1194,44 @@ inline internal tensor_list
 gz_tensor_list_allocate(usize Size, mem_arena *Arena) {
     tensor_list TensorList = {0};
     TensorList.size = Size;
-    TensorList.array = gzMemPushArray(Arena, t32 *, TensorList.size);
+    TensorList.array = gzMemPushArray(gz_mem_arena_meta(Arena), t32 *, TensorList.size);
 
     return TensorList;
 }
 
+/* NOTE(abid): The list is flat if its tensors are exactly what the model arena holds, each with its grad at
+ *             the mirrored offset. Tail padding is zero in both buffers, so passes over it change nothing. */
+internal void
+__gz_tensor_list_find_flat(tensor_list *List, mem_arena *Arena) {
+    List->flat.data = List->flat.grad = NULL;
+    List->flat.length = 0;
+    if(!Arena->Grad || !List->used) return;
+
+    u8 *DataBegin = (u8 *)Arena->Ptr;
+    u8 *GradBegin = (u8 *)Arena->Grad->Ptr;
+    usize Bytes = 0;
+    for(usize Idx = 0; Idx < List->used; ++Idx) {
+        t32 *Tensor = List->array[Idx];
+        usize Offset = (u8 *)Tensor->Data.Ptr - DataBegin;
+        if((Tensor->Data.DType != dtype_f32) || !Tensor->Grad.Ptr || (Tensor->Header->Offset != 0) ||
+           ((u8 *)Tensor->Data.Ptr < DataBegin) || (Offset >= Arena->Used) ||
+           ((u8 *)Tensor->Grad.Ptr != GradBegin + Offset)) return;
+        Bytes += __gzTensorStorageBytes(Tensor->Header->StorageNumElements*sizeof(f32));
+    }
+    if(Bytes != Arena->Used) return;
+
+    List->flat.data = (f32 *)DataBegin;
+    List->flat.grad = (f32 *)GradBegin;
+    List->flat.length = Bytes/sizeof(f32);
+}
+
 internal tensor_list
 gzTensorListFromModule(module *Module, mem_arena *Arena) {
     tensor_list TensorList = gz_tensor_list_allocate(Module->weights.used, Arena);
     for(u32 Idx = 0; Idx < Module->weights.used; ++Idx) {
         gz_tensor_list_add(Module->weights.array[Idx], &TensorList);
     }
+    __gz_tensor_list_find_flat(&TensorList, Arena);
 
     return TensorList;
 }
@@ -1181,6 +1250,7 @@ gz_tensor_list_from_module_list(module **modules, u64 modules_length, mem_arena
             gz_tensor_list_add(module->weights.array[jdx], &list);
         }
     }
+    __gz_tensor_list_find_flat(&list, arena);
 
     return list;
 }
@@ -21,6 +21,7 @@ typedef enum {
     op_unary_sigmoid,
     op_unary_relu,
     op_unary_view,
+    op_unary_checkpoint,
 
     op_unary_end, /* NOTE(Abid): Marks the num after the end of unary ops, WARNING: should not be moved! */
 
@@ -50,29 +51,69 @@ typedef enum {
 typedef struct t32 t32;
 typedef struct {
     tensor_op TensorOp;
-    t32 **Operands;
+    t32 *Operands[2];
 
     /* NOTE(Abid): This is used for storing context data related to operations,
      *             One of the main uses is to store the dimensions that transposed. */
     void *op_context;
 } op_info;
 
+/* NOTE(abid): Sizes and strides are interned, so every tensor of the same layout points to the same
+ *             (read-only) arrays. A change of layout has to intern a new one. Shapes are only ever added to
+ *             the front of a bucket and never change afterwards, so lookups go without the lock. */
+#define GZ_TENSOR_MAX_DIMS 32
+#define GZ_TENSOR_SHAPE_BUCKETS 1024
+#define GZ_TENSOR_SHAPE_ARENA_SIZE gzMegabyte(256)
+
+typedef struct tensor_shape {
+    struct tensor_shape *next;
+    u32 hash;
+    u32 dim;
+    /* NOTE(abid): At least two entries each, the ones past `dim` are zero. */
+    u32 *sizes;
+    u32 *strides;
+} tensor_shape;
+
+typedef struct {
+    mem_arena arena;
+    tensor_shape *buckets[GZ_TENSOR_SHAPE_BUCKETS];
+    u32 num_shapes;
+    u32 lock;
+} tensor_shape_table;
+
+global_var tensor_shape_table __gzGLOBALShapeTable;
+
 typedef struct {
     u32 *Sizes;
     u32 *Strides;
+    size_t StorageNumElements;
     u32 Dim;
     u32 Offset;
 
-    /* NOTE(Abid): This is stricly for optimizing math ops, so we don't allocate. TODO: Must remove */
-    u32 *AccessSizes; 
-    size_t StorageNumElements;
-
     bool ShouldGrad;
     bool IsContiguous;
+    /* NOTE(abid): Whether the header has the autograd part below. Tensors made outside of grad mode, and
+     *             dataset husks, are allocated without it, so none of the fields below may be touched. */
+    bool HasAutograd;
+
+    /* NOTE(abid): Only leaves keep a persistent grad. Non-leaf grads are handed out by the grad pool
+     *             during backprop and given back as soon as they have been passed down to the operands. */
+    bool IsGradTransient;
+    /* NOTE(abid): Number of consumers that still have to pass their grad down to this tensor. */
+    u32 BackwardRefCount;
+    /* NOTE(abid): Held while a consumer accumulates into the grad during a parallel backprop. */
+    u32 BackwardLock;
+    /* NOTE(abid): Leaves only, the backward ops that still have to run on the leaf or on a view of it. Any of
+     *             them may read the data of the leaf, so the grad hook waits for all of them. */
+    u32 BackwardReaders;
+    /* NOTE(abid): Leaves only, called by backprop once the grad is final (see `gz_grad_hook_register`). */
+    struct grad_hook *GradHook;
 
     op_info DerivedOp;
 } tensor_header;
 
+#define GZ_TENSOR_HEADER_NO_AUTOGRAD_SIZE ((offsetof(tensor_header, IsGradTransient) + 7) & ~(size_t)7)
+
 typedef struct {
 
     void *Ptr;
@@ -86,10 +127,28 @@ struct t32 {
     storage Grad;
 };
 
+/* NOTE(abid): A matrix inside of a tensor, in elements. */
+typedef struct {
+    u32 rows;
+    u32 cols;
+    usize row_stride;
+    usize col_stride;
+} matrix_layout;
+
+/* NOTE(abid): Data and grads of a whole list as two flat buffers of one layout (see `gz_model_arena_create`),
+ *             so that grad zeroing and optimizer steps need not go tensor by tensor. */
+typedef struct {
+    f32 *data;
+    f32 *grad;
+    usize length;
+} flat_params;
+
 typedef struct {
     t32 **array;
     usize size;
     usize used;
+    /* NOTE(abid): Zero length if the tensors of the list are not laid out like that. */
+    flat_params flat;
 } tensor_list;
 
 typedef enum {
@@ -98,5 +157,18 @@ typedef enum {
     reduce_sum  = 2,
 } reduce_method;
 
+/* NOTE(abid): Data and grad of a tensor start on `alignment` bytes, an alignment of 1 packs them right
+ *             after the metadata. With `pad_to_vector`, the storage is padded with zeros to a whole number
+ *             of vectors, so kernels can run full vectors over the tail of the last row. */
+#define GZ_TENSOR_DEFAULT_ALIGNMENT 64
+#define GZ_TENSOR_VECTOR_BYTES 64
+
+typedef struct {
+    u32 alignment;
+    bool pad_to_vector;
+} tensor_alloc_config;
+
+global_var tensor_alloc_config __gzGLOBALTensorAlloc = { GZ_TENSOR_DEFAULT_ALIGNMENT, false };
+
 #define TENSOR_H
 #endif
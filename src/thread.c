@@ -0,0 +1,279 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 3:06:41 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#include "thread.h"
+
+#ifdef GRAZIE_PLT_WIN
+#define __gz_thread_lock(Pool) EnterCriticalSection(&(Pool)->lock)
+#define __gz_thread_unlock(Pool) LeaveCriticalSection(&(Pool)->lock)
+#define __gz_thread_wait(Pool, Cond) SleepConditionVariableCS(&(Pool)->Cond, &(Pool)->lock, INFINITE)
+#define __gz_thread_wake_all(Pool, Cond) WakeAllConditionVariable(&(Pool)->Cond)
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+#define __gz_thread_lock(Pool) pthread_mutex_lock(&(Pool)->lock)
+#define __gz_thread_unlock(Pool) pthread_mutex_unlock(&(Pool)->lock)
+#define __gz_thread_wait(Pool, Cond) pthread_cond_wait(&(Pool)->Cond, &(Pool)->lock)
+#define __gz_thread_wake_all(Pool, Cond) pthread_cond_broadcast(&(Pool)->Cond)
+#endif
+
+#ifdef GRAZIE_PLT_WIN
+#define __gz_thread_yield() SwitchToThread()
+#endif
+#ifdef GRAZIE_PLT_LINUX
+#define __gz_thread_yield() sched_yield()
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+/* NOTE(abid): Not the private kind of futex, the word may be in memory shared between processes. */
+internal inline void
+gz_futex_wait(u32 *Address, u32 Expected) { syscall(SYS_futex, Address, FUTEX_WAIT, Expected, NULL, NULL, 0); }
+
+internal inline void
+gz_futex_wake_all(u32 *Address) { syscall(SYS_futex, Address, FUTEX_WAKE, INT_MAX, NULL, NULL, 0); }
+#endif
+
+#ifdef GRAZIE_PLT_WIN
+#pragma comment(lib, "Synchronization.lib") /* NOTE(abid): For `WaitOnAddress`. */
+#endif
+
+/* NOTE(abid): Sleeps while `*Address` is `Expected`, between threads of the same process. May return early,
+ *             i.e. always call it in a loop that checks the condition. */
+internal inline void
+gz_wait_u32(u32 *Address, u32 Expected) {
+#ifdef GRAZIE_PLT_WIN
+    WaitOnAddress((volatile VOID *)Address, &Expected, sizeof(u32), INFINITE);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    syscall(SYS_futex, Address, FUTEX_WAIT_PRIVATE, Expected, NULL, NULL, 0);
+#endif
+}
+
+internal inline void
+gz_wake_all_u32(u32 *Address) {
+#ifdef GRAZIE_PLT_WIN
+    WakeByAddressAll((PVOID)Address);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    syscall(SYS_futex, Address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/* NOTE(abid): For short critical sections on a single word, e.g. a lock per tensor. */
+internal inline void
+gz_spin_lock(u32 *Lock) {
+    while(gz_atomic_exchange_u32(Lock, 1)) {
+        while(gz_atomic_load_u32(Lock)) __gz_thread_yield();
+    }
+}
+
+internal inline void
+gz_spin_unlock(u32 *Lock) { gz_atomic_store_u32(Lock, 0); }
+
+/* NOTE(abid): Monotonic wall clock, e.g. for throughput. */
+internal f64
+gz_time_seconds() {
+#ifdef GRAZIE_PLT_WIN
+    LARGE_INTEGER Frequency, Counter;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Counter);
+    return (f64)Counter.QuadPart/(f64)Frequency.QuadPart;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (f64)Time.tv_sec + 1e-9*(f64)Time.tv_nsec;
+#endif
+}
+
+internal u32
+gz_thread_num_cores() {
+    u32 Result = 1;
+#ifdef GRAZIE_PLT_WIN
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    Result = (u32)SystemInfo.dwNumberOfProcessors;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    long NumCores = sysconf(_SC_NPROCESSORS_ONLN);
+    if(NumCores > 0) Result = (u32)NumCores;
+#endif
+    return Result;
+}
+
+/* NOTE(abid): In autograd.c, which comes after this file in the unity build. */
+internal void gz_backprop_release_thread();
+
+/* NOTE(abid): What a worker kept for itself would be lost once it exits, and pools come and go, e.g. with
+ *             `gz_thread_pool_init`. */
+internal void
+__gz_thread_release_locals() {
+    if(__gzGLOBALScratchArena.Ptr) gz_mem_arena_release(&__gzGLOBALScratchArena);
+    memset(&__gzGLOBALScratchArena, 0, sizeof(mem_arena));
+    gz_backprop_release_thread();
+}
+
+internal inline void
+__gz_thread_pool_take_tasks(thread_pool *pool, u32 thread_idx) {
+    for(;;) {
+        u32 task_idx = gz_atomic_add_u32(&pool->next_task, 1);
+        if(task_idx >= pool->num_tasks) break;
+        pool->task(pool->data, task_idx, thread_idx);
+    }
+}
+
+#ifdef GRAZIE_PLT_WIN
+internal DWORD WINAPI
+#endif
+#ifdef GRAZIE_PLT_LINUX
+internal void *
+#endif
+__gz_thread_worker_main(void *arg) {
+    thread_worker *worker = (thread_worker *)arg;
+    thread_pool *pool = worker->pool;
+    u64 seen_generation = 0;
+
+    __gz_thread_lock(pool);
+    for(;;) {
+        while((pool->generation == seen_generation) && !pool->should_quit) __gz_thread_wait(pool, work_ready);
+        if(pool->should_quit) break;
+        seen_generation = pool->generation;
+        ++pool->active_workers;
+        __gz_thread_unlock(pool);
+
+        __gz_thread_pool_take_tasks(pool, worker->thread_idx);
+
+        __gz_thread_lock(pool);
+        if(--pool->active_workers == 0) __gz_thread_wake_all(pool, work_done);
+    }
+    __gz_thread_unlock(pool);
+    __gz_thread_release_locals();
+
+    return 0;
+}
+
+/* NOTE(abid): `num_threads` counts the calling thread, so a pool of 1 spawns nothing and runs serially. */
+internal thread_pool *
+gz_thread_pool_create(u32 num_threads) {
+    assert(num_threads > 0, "thread pool needs at least one thread");
+    thread_pool *pool = (thread_pool *)_Calloc(1, sizeof(thread_pool));
+    assert(pool, "could not allocate the thread pool");
+    pool->num_threads = num_threads;
+    pool->workers = (thread_worker *)_Calloc(num_threads, sizeof(thread_worker));
+    assert(pool->workers, "could not allocate the thread pool workers");
+
+#ifdef GRAZIE_PLT_WIN
+    InitializeCriticalSection(&pool->lock);
+    InitializeConditionVariable(&pool->work_ready);
+    InitializeConditionVariable(&pool->work_done);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+#endif
+
+    for(u32 idx = 1; idx < num_threads; ++idx) {
+        thread_worker *worker = pool->workers + idx;
+        worker->pool = pool;
+        worker->thread_idx = idx;
+#ifdef GRAZIE_PLT_WIN
+        worker->handle = CreateThread(NULL, 0, __gz_thread_worker_main, worker, 0, NULL);
+        assert(worker->handle, "could not create worker thread %u", idx);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+        i32 error = pthread_create(&worker->handle, NULL, __gz_thread_worker_main, worker);
+        assert(error == 0, "could not create worker thread %u, error %d", idx, error);
+#endif
+    }
+
+    return pool;
+}
+
+internal void
+gz_thread_pool_destroy(thread_pool *pool) {
+    __gz_thread_lock(pool);
+    pool->should_quit = true;
+    __gz_thread_wake_all(pool, work_ready);
+    __gz_thread_unlock(pool);
+
+    for(u32 idx = 1; idx < pool->num_threads; ++idx) {
+#ifdef GRAZIE_PLT_WIN
+        WaitForSingleObject(pool->workers[idx].handle, INFINITE);
+        CloseHandle(pool->workers[idx].handle);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+        pthread_join(pool->workers[idx].handle, NULL);
+#endif
+    }
+
+#ifdef GRAZIE_PLT_WIN
+    DeleteCriticalSection(&pool->lock);
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    Free(pool->workers);
+    Free(pool);
+}
+
+/* NOTE(abid): Runs `task` for every index in [0, num_tasks) and returns once all of them are done. */
+internal void
+gz_thread_pool_run(thread_pool *pool, thread_task *task, void *data, u32 num_tasks) {
+    if(!pool || (pool->num_threads == 1) || (num_tasks == 1) || gz_atomic_exchange_u32(&pool->is_busy, 1)) {
+        for(u32 idx = 0; idx < num_tasks; ++idx) task(data, idx, 0);
+        return;
+    }
+
+    /* NOTE(abid): A worker that woke up late for the previous job may still be counted as active. */
+    __gz_thread_lock(pool);
+    while(pool->active_workers > 0) __gz_thread_wait(pool, work_done);
+    pool->task = task;
+    pool->data = data;
+    pool->num_tasks = num_tasks;
+    pool->next_task = 0;
+    ++pool->generation;
+    __gz_thread_wake_all(pool, work_ready);
+    __gz_thread_unlock(pool);
+
+    __gz_thread_pool_take_tasks(pool, 0);
+
+    /* NOTE(abid): Workers only take tasks while they are counted as active, so none of them is still
+     *             inside a task once the count drops to zero. */
+    __gz_thread_lock(pool);
+    while(pool->active_workers > 0) __gz_thread_wait(pool, work_done);
+    __gz_thread_unlock(pool);
+
+    gz_atomic_store_u32(&pool->is_busy, 0);
+}
+
+/* NOTE(abid): Replaces the global pool, 0 threads means one per core. */
+internal void
+gz_thread_pool_init(u32 num_threads) {
+    if(__gzGLOBALThreadPool) gz_thread_pool_destroy(__gzGLOBALThreadPool);
+    if(num_threads == 0) num_threads = gz_thread_num_cores();
+    __gzGLOBALThreadPool = gz_thread_pool_create(num_threads);
+}
+
+internal inline thread_pool *
+gz_thread_pool_get() {
+    if(!__gzGLOBALThreadPool) gz_thread_pool_init(0);
+    return __gzGLOBALThreadPool;
+}
+
+internal inline u32
+gz_thread_pool_num_threads() { return gz_thread_pool_get()->num_threads; }
+
+internal mem_arena *
+gz_thread_scratch_arena() {
+    mem_arena *ScratchArena = &__gzGLOBALScratchArena;
+    if(!ScratchArena->Ptr) *ScratchArena = gz_mem_arena_reserve(GZ_THREAD_SCRATCH_SIZE, GZ_THREAD_SCRATCH_HIGH_WATER, mem_arena_flag_huge_pages);
+    return ScratchArena;
+}
@@ -0,0 +1,88 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 3:06:41 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#if !defined(THREAD_H)
+
+#ifdef GRAZIE_PLT_WIN
+#define gz_atomic_add_u32(Ptr, Value) ((u32)InterlockedExchangeAdd((volatile LONG *)(Ptr), (LONG)(Value)))
+#define gz_atomic_exchange_u32(Ptr, Value) ((u32)InterlockedExchange((volatile LONG *)(Ptr), (LONG)(Value)))
+#define gz_atomic_load_u32(Ptr) ((u32)InterlockedCompareExchange((volatile LONG *)(Ptr), 0, 0))
+#define gz_atomic_store_u32(Ptr, Value) ((void)InterlockedExchange((volatile LONG *)(Ptr), (LONG)(Value)))
+/* NOTE(abid): Aligned 32-bit loads and stores are atomic on x86 and ARM, volatile keeps them single accesses. */
+#define gz_atomic_load_relaxed_u32(Ptr) (*(volatile u32 *)(Ptr))
+#define gz_atomic_store_relaxed_u32(Ptr, Value) (*(volatile u32 *)(Ptr) = (u32)(Value))
+#define gz_atomic_load_ptr(Ptr) InterlockedCompareExchangePointer((PVOID volatile *)(Ptr), NULL, NULL)
+#define gz_atomic_store_ptr(Ptr, Value) ((void)InterlockedExchangePointer((PVOID volatile *)(Ptr), (PVOID)(Value)))
+#endif
+
+#ifdef GRAZIE_PLT_LINUX
+#define gz_atomic_add_u32(Ptr, Value) __atomic_fetch_add((Ptr), (u32)(Value), __ATOMIC_ACQ_REL)
+#define gz_atomic_exchange_u32(Ptr, Value) __atomic_exchange_n((Ptr), (u32)(Value), __ATOMIC_ACQ_REL)
+#define gz_atomic_load_u32(Ptr) __atomic_load_n((Ptr), __ATOMIC_ACQUIRE)
+#define gz_atomic_store_u32(Ptr, Value) __atomic_store_n((Ptr), (u32)(Value), __ATOMIC_RELEASE)
+#define gz_atomic_load_relaxed_u32(Ptr) __atomic_load_n((u32 *)(Ptr), __ATOMIC_RELAXED)
+#define gz_atomic_store_relaxed_u32(Ptr, Value) __atomic_store_n((u32 *)(Ptr), (u32)(Value), __ATOMIC_RELAXED)
+#define gz_atomic_load_ptr(Ptr) ((void *)__atomic_load_n((Ptr), __ATOMIC_ACQUIRE))
+#define gz_atomic_store_ptr(Ptr, Value) __atomic_store_n((Ptr), (Value), __ATOMIC_RELEASE)
+#endif
+
+/* NOTE(abid): Runs once for every task of a job. `thread_idx` is 0 for the calling thread and unique among
+ *             the threads of the pool, so it can be used to pick per-thread storage. */
+typedef void thread_task(void *data, u32 task_idx, u32 thread_idx);
+
+struct thread_pool;
+typedef struct {
+    struct thread_pool *pool;
+    u32 thread_idx;
+#ifdef GRAZIE_PLT_WIN
+    HANDLE handle;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_t handle;
+#endif
+} thread_worker;
+
+/* NOTE(abid): There is only ever one job in flight. Tasks are handed out with an atomic counter, and the
+ *             caller takes tasks as well instead of sleeping until the workers are done. */
+typedef struct thread_pool {
+#ifdef GRAZIE_PLT_WIN
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE work_ready;
+    CONDITION_VARIABLE work_done;
+#endif
+#ifdef GRAZIE_PLT_LINUX
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+#endif
+    thread_worker *workers;
+    u32 num_threads; /* NOTE(abid): Including the calling thread. */
+
+    thread_task *task;
+    void *data;
+    u32 num_tasks;
+    u32 next_task;
+    u32 active_workers;
+    u64 generation;
+    bool should_quit;
+
+    /* NOTE(abid): Set while a job runs, jobs started from inside a task (or from another thread) in the
+     *             meantime run serially on their caller. */
+    u32 is_busy;
+} thread_pool;
+
+global_var thread_pool *__gzGLOBALThreadPool = NULL;
+
+/* NOTE(abid): Per-thread scratch for tasks, reserved on first use and only ever used in temp memory. Only
+ *             what is used gets committed, and anything above the high water is given back afterwards. */
+#define GZ_THREAD_SCRATCH_SIZE gzGigabyte(4)
+#define GZ_THREAD_SCRATCH_HIGH_WATER gzMegabyte(64)
+global_var thread_local_var mem_arena __gzGLOBALScratchArena;
+
+#define THREAD_H
+#endif
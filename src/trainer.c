@@ -0,0 +1,619 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 6:42:10 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#include "trainer.h"
+
+/* NOTE(abid): `Modules` are replica 0 and `Optim` must step them over a flat list, i.e. they live in a model
+ *             arena (see `gz_model_arena_create`), which is also where the trainer is kept. The other replicas
+ *             get model arenas of the same size, and every replica a step arena of `StepArenaBytes`. With more
+ *             replicas than threads in the pool, some threads simply run several replicas one after another. */
+internal data_parallel *
+gz_data_parallel_create(module **Modules, u64 NumModules, mem_arena *ModelArena, optimizer *Optim, u32 NumReplicas,
+                        trainer_loss *Loss, reduce_method Reduce, usize StepArenaBytes) {
+    assert(NumReplicas > 0, "data-parallel training needs at least one replica");
+    assert(Optim->params.flat.length, "data-parallel training needs the parameters in a model arena");
+    assert(!__gzGLOBALMemPlan, "memory plans cannot be used with data-parallel training");
+
+    mem_arena *Meta = gz_mem_arena_meta(ModelArena);
+    data_parallel *Trainer = gz_mem_push_struct(data_parallel, Meta);
+    memset(Trainer, 0, sizeof(data_parallel));
+    Trainer->replicas = gzMemPushArray(Meta, trainer_replica, NumReplicas);
+    memset(Trainer->replicas, 0, NumReplicas*sizeof(trainer_replica));
+    Trainer->num_replicas = NumReplicas;
+    Trainer->num_modules = NumModules;
+    Trainer->loss = Loss;
+    Trainer->reduce = Reduce;
+    Trainer->optim = Optim;
+
+    trainer_replica *Master = Trainer->replicas;
+    Master->modules = Modules;
+    Master->model_arena = ModelArena;
+    Master->params = Optim->params;
+    gz_grad_zero(Master->params);
+
+    for(u32 ReplicaIdx = 0; ReplicaIdx < NumReplicas; ++ReplicaIdx) {
+        trainer_replica *Replica = Trainer->replicas + ReplicaIdx;
+        Replica->step_arena = gz_mem_step_arena(StepArenaBytes, GZ_TRAINER_STEP_HIGH_WATER);
+        if(ReplicaIdx == 0) continue;
+
+        mem_arena *Arena = gz_model_arena_create(ModelArena->Size);
+        Replica->model_arena = Arena;
+        Replica->modules = gzMemPushArray(gz_mem_arena_meta(Arena), module *, NumModules);
+        for(u64 Idx = 0; Idx < NumModules; ++Idx) Replica->modules[Idx] = gz_module_clone(Modules[Idx], Arena);
+        Replica->params = gz_tensor_list_from_module_list(Replica->modules, NumModules, Arena);
+        assert(Replica->params.flat.length == Master->params.flat.length, "replica layout does not match the model");
+        gz_grad_zero(Replica->params);
+    }
+
+    return Trainer;
+}
+
+/* NOTE(abid): Releases the step arenas of all replicas and the model arenas of the clones. The trainer itself
+ *             lives in the model arena of replica 0, which stays with the caller. */
+internal void
+gz_data_parallel_destroy(data_parallel *Trainer) {
+    for(u32 ReplicaIdx = 0; ReplicaIdx < Trainer->num_replicas; ++ReplicaIdx) {
+        trainer_replica *Replica = Trainer->replicas + ReplicaIdx;
+        gz_mem_arena_release(&Replica->step_arena);
+        if(ReplicaIdx) gz_mem_arena_release(Replica->model_arena);
+    }
+}
+
+internal void
+__gz_data_parallel_replica_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    data_parallel *Trainer = (data_parallel *)Data;
+    trainer_replica *Replica = Trainer->replicas + TaskIdx;
+    if(!Replica->input) return;
+
+    t32 *Prediction = gz_module_run_all(Replica->modules, Trainer->num_modules, Replica->input, &Replica->step_arena);
+    t32 *Loss = Trainer->loss(Prediction, Replica->target, Trainer->reduce, &Replica->step_arena);
+    Replica->loss = *((f32 *)Loss->Data.Ptr + Loss->Header->Offset);
+    gz_backprop_many(&Loss, &Replica->weight, 1);
+}
+
+internal inline void
+__gz_data_parallel_slice(data_parallel *Trainer, u32 TaskIdx, usize *Begin, usize *End) {
+    usize Length = Trainer->replicas[0].params.flat.length;
+    *Begin = (usize)TaskIdx*GZ_TRAINER_SLICE_ELEMENTS;
+    *End = *Begin + GZ_TRAINER_SLICE_ELEMENTS;
+    if(*End > Length) *End = Length;
+}
+
+/* NOTE(abid): Reduce-scatter, the grads of the slice are summed into replica 0 pairwise as a tree, so the sum
+ *             comes out the same no matter the scheduling. The other replicas are left with zeroed grads. */
+internal void
+__gz_data_parallel_reduce_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    data_parallel *Trainer = (data_parallel *)Data;
+    usize Begin, End;
+    __gz_data_parallel_slice(Trainer, TaskIdx, &Begin, &End);
+
+    u32 NumReplicas = Trainer->num_replicas;
+    for(u32 Stride = 1; Stride < NumReplicas; Stride <<= 1) {
+        for(u32 ReplicaIdx = 0; ReplicaIdx + Stride < NumReplicas; ReplicaIdx += 2*Stride) {
+            f32 *DestGrad = Trainer->replicas[ReplicaIdx].params.flat.grad;
+            f32 *SrcGrad = Trainer->replicas[ReplicaIdx + Stride].params.flat.grad;
+            for(usize Idx = Begin; Idx < End; ++Idx) DestGrad[Idx] += SrcGrad[Idx];
+        }
+    }
+    for(u32 ReplicaIdx = 1; ReplicaIdx < NumReplicas; ++ReplicaIdx)
+        memset(Trainer->replicas[ReplicaIdx].params.flat.grad + Begin, 0, (End-Begin)*sizeof(f32));
+}
+
+/* NOTE(abid): All-gather, the stepped parameters of replica 0 go out to the others. The grads of replica 0
+ *             have been used up by then, so they are zeroed for the next step. */
+internal void
+__gz_data_parallel_gather_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    data_parallel *Trainer = (data_parallel *)Data;
+    usize Begin, End;
+    __gz_data_parallel_slice(Trainer, TaskIdx, &Begin, &End);
+
+    flat_params *Master = &Trainer->replicas[0].params.flat;
+    for(u32 ReplicaIdx = 1; ReplicaIdx < Trainer->num_replicas; ++ReplicaIdx)
+        memcpy(Trainer->replicas[ReplicaIdx].params.flat.data + Begin, Master->data + Begin, (End-Begin)*sizeof(f32));
+    memset(Master->grad + Begin, 0, (End-Begin)*sizeof(f32));
+}
+
+/* NOTE(abid): A husk over `ShardRows` rows of a contiguous batch from `Row` on, of the same dtype. */
+internal t32 *
+__gz_trainer_shard(t32 *Batch, u32 Row, u32 ShardRows, mem_arena *Arena) {
+    u32 Shape[GZ_TENSOR_MAX_DIMS];
+    memcpy(Shape, Batch->Header->Sizes, Batch->Header->Dim*sizeof(u32));
+    Shape[0] = ShardRows;
+    t32 *Result = __gz_tensor_alloc_husk(Shape, Batch->Header->Dim, Arena);
+    Result->Data.DType = Batch->Data.DType;
+    usize RowElements = Batch->Header->StorageNumElements/Batch->Header->Sizes[0];
+    Result->Data.Ptr = (u8 *)Batch->Data.Ptr +
+                       (Batch->Header->Offset + Row*RowElements)*gz_dtype_size(Batch->Data.DType);
+
+    return Result;
+}
+
+/* NOTE(abid): One step over a batch, with the batch dim first in `Input` and `Target`. The rows are split as
+ *             evenly as possible among the replicas, and the backprop of every replica is seeded with its share
+ *             of the batch under `reduce_mean`, so the summed grads are those of the whole batch. Returns the
+ *             loss of the whole batch. */
+internal f32
+gz_data_parallel_step(data_parallel *Trainer, t32 *Input, t32 *Target) {
+    assert(Input->Header->IsContiguous && Target->Header->IsContiguous, "batch must be contiguous");
+    u32 NumRows = Input->Header->Sizes[0];
+    assert(Target->Header->Sizes[0] == NumRows, "input and target have a different number of rows");
+
+    u32 NumReplicas = Trainer->num_replicas;
+    u32 Row = 0;
+    for(u32 ReplicaIdx = 0; ReplicaIdx < NumReplicas; ++ReplicaIdx) {
+        trainer_replica *Replica = Trainer->replicas + ReplicaIdx;
+        gz_mem_arena_reset(&Replica->step_arena);
+        u32 ShardRows = NumRows/NumReplicas + (ReplicaIdx < (NumRows % NumReplicas));
+        Replica->input = Replica->target = NULL;
+        Replica->loss = Replica->weight = 0.f;
+        if(!ShardRows) continue;
+
+        Replica->input = __gz_trainer_shard(Input, Row, ShardRows, &Replica->step_arena);
+        Replica->target = __gz_trainer_shard(Target, Row, ShardRows, &Replica->step_arena);
+
+        Replica->weight = (Trainer->reduce == reduce_mean) ? (f32)ShardRows/(f32)NumRows : 1.f;
+        Row += ShardRows;
+    }
+
+    thread_pool *Pool = gz_thread_pool_get();
+    u32 NumSlices = (u32)((Trainer->replicas[0].params.flat.length + GZ_TRAINER_SLICE_ELEMENTS-1)/GZ_TRAINER_SLICE_ELEMENTS);
+    gz_thread_pool_run(Pool, __gz_data_parallel_replica_task, Trainer, NumReplicas);
+    gz_thread_pool_run(Pool, __gz_data_parallel_reduce_task, Trainer, NumSlices);
+    gz_optim_step(Trainer->optim);
+    gz_thread_pool_run(Pool, __gz_data_parallel_gather_task, Trainer, NumSlices);
+
+    f32 Result = 0.f;
+    for(u32 ReplicaIdx = 0; ReplicaIdx < NumReplicas; ++ReplicaIdx)
+        Result += Trainer->replicas[ReplicaIdx].weight*Trainer->replicas[ReplicaIdx].loss;
+
+    return Result;
+}
+
+/* NOTE(abid): `Modules` must be in a model arena, i.e. their parameters form a flat list. The other workers get
+ *             model arenas of the same size, of which only the grads are used. */
+internal hogwild *
+gz_hogwild_create(module **Modules, u64 NumModules, mem_arena *ModelArena, u32 NumWorkers, trainer_loss *Loss,
+                  reduce_method Reduce, f32 LearningRate, usize StepArenaBytes) {
+    assert(NumWorkers > 0, "hogwild needs at least one worker");
+    assert(!__gzGLOBALMemPlan, "memory plans cannot be used with hogwild");
+
+    mem_arena *Meta = gz_mem_arena_meta(ModelArena);
+    hogwild *Trainer = gz_mem_push_struct(hogwild, Meta);
+    memset(Trainer, 0, sizeof(hogwild));
+    Trainer->workers = gzMemPushArray(Meta, hogwild_worker, NumWorkers);
+    memset(Trainer->workers, 0, NumWorkers*sizeof(hogwild_worker));
+    Trainer->num_workers = NumWorkers;
+    Trainer->num_modules = NumModules;
+    Trainer->loss = Loss;
+    Trainer->reduce = Reduce;
+    Trainer->learning_rate = LearningRate;
+
+    hogwild_worker *Master = Trainer->workers;
+    Master->modules = Modules;
+    Master->params = gz_tensor_list_from_module_list(Modules, NumModules, ModelArena);
+    assert(Master->params.flat.length, "hogwild needs the parameters in a model arena");
+    Trainer->shared = Master->params.flat;
+    gz_grad_zero(Master->params);
+
+    for(u32 WorkerIdx = 0; WorkerIdx < NumWorkers; ++WorkerIdx) {
+        hogwild_worker *Worker = Trainer->workers + WorkerIdx;
+        Worker->step_arena = gz_mem_step_arena(StepArenaBytes, GZ_TRAINER_STEP_HIGH_WATER);
+        if(WorkerIdx == 0) continue;
+
+        mem_arena *Arena = gz_model_arena_create(ModelArena->Size);
+        Worker->model_arena = Arena;
+        Worker->modules = gzMemPushArray(gz_mem_arena_meta(Arena), module *, NumModules);
+        for(u64 Idx = 0; Idx < NumModules; ++Idx) Worker->modules[Idx] = gz_module_clone(Modules[Idx], Arena);
+        Worker->params = gz_tensor_list_from_module_list(Worker->modules, NumModules, Arena);
+        assert(Worker->params.flat.length == Trainer->shared.length, "worker layout does not match the model");
+        for(usize Idx = 0; Idx < Worker->params.used; ++Idx)
+            Worker->params.array[Idx]->Data.Ptr = Master->params.array[Idx]->Data.Ptr;
+        Worker->params.flat.data = Trainer->shared.data;
+        gz_grad_zero(Worker->params);
+    }
+
+    return Trainer;
+}
+
+/* NOTE(abid): Releases the arenas of the workers. The trainer itself lives in the model arena, which stays with
+ *             the caller. */
+internal void
+gz_hogwild_destroy(hogwild *Trainer) {
+    for(u32 WorkerIdx = 0; WorkerIdx < Trainer->num_workers; ++WorkerIdx) {
+        hogwild_worker *Worker = Trainer->workers + WorkerIdx;
+        gz_mem_arena_release(&Worker->step_arena);
+        if(Worker->model_arena) gz_mem_arena_release(Worker->model_arena);
+    }
+}
+
+/* NOTE(abid): Skips the zero grads, which for sparse grads is most of them, and zeroes the rest on the way. */
+internal void
+__gz_hogwild_update(hogwild *Trainer, f32 *Grad) {
+    f32 *Data = Trainer->shared.data;
+    f32 LearningRate = Trainer->learning_rate;
+    for(usize Idx = 0; Idx < Trainer->shared.length; ++Idx) {
+        if(Grad[Idx] == 0.f) continue;
+        u32 Bits = gz_atomic_load_relaxed_u32(Data + Idx);
+        f32 Param;
+        memcpy(&Param, &Bits, sizeof(f32));
+        Param -= LearningRate*Grad[Idx];
+        memcpy(&Bits, &Param, sizeof(f32));
+        gz_atomic_store_relaxed_u32(Data + Idx, Bits);
+        Grad[Idx] = 0.f;
+    }
+}
+
+internal void
+__gz_hogwild_worker_task(void *Data, u32 TaskIdx, u32 ThreadIdx) {
+    (void)ThreadIdx;
+    hogwild *Trainer = (hogwild *)Data;
+    hogwild_worker *Worker = Trainer->workers + TaskIdx;
+    u64 NumSamples = Trainer->inputs->length;
+    for(;;) {
+        u32 Batch = gz_atomic_add_u32(&Trainer->next_batch, 1);
+        if(Batch >= Trainer->num_batches) break;
+
+        t32 *Input = gz_dataset_index_husk(Trainer->inputs, Batch % NumSamples, &Worker->step_arena);
+        t32 *Target = gz_dataset_index_husk(Trainer->targets, Batch % NumSamples, &Worker->step_arena);
+        t32 *Prediction = gz_module_run_all(Worker->modules, Trainer->num_modules, Input, &Worker->step_arena);
+        t32 *Loss = Trainer->loss(Prediction, Target, Trainer->reduce, &Worker->step_arena);
+        Worker->loss_sum += *((f32 *)Loss->Data.Ptr + Loss->Header->Offset);
+        ++Worker->num_batches;
+        gz_backprop(Loss);
+
+        __gz_hogwild_update(Trainer, Worker->params.flat.grad);
+        gz_mem_arena_reset(&Worker->step_arena);
+    }
+}
+
+/* NOTE(abid): Runs `NumEpochs` over the batches of the datasets, in order, each batch going to whichever worker
+ *             is free. The workers run as tasks on the thread pool, so at most as many run at the same time as
+ *             the pool has threads. Returns the mean loss over all batches. */
+internal f32
+gz_hogwild_run(hogwild *Trainer, dataset *Inputs, dataset *Targets, u32 NumEpochs) {
+    assert(Inputs->length == Targets->length, "inputs and targets have a different number of batches");
+    assert(Inputs->length*NumEpochs <= UINT32_MAX, "too many batches for a single run");
+    Trainer->inputs = Inputs;
+    Trainer->targets = Targets;
+    Trainer->next_batch = 0;
+    Trainer->num_batches = (u32)(Inputs->length*NumEpochs);
+    for(u32 WorkerIdx = 0; WorkerIdx < Trainer->num_workers; ++WorkerIdx) {
+        Trainer->workers[WorkerIdx].loss_sum = 0.0;
+        Trainer->workers[WorkerIdx].num_batches = 0;
+    }
+
+    gz_thread_pool_run(gz_thread_pool_get(), __gz_hogwild_worker_task, Trainer, Trainer->num_workers);
+
+    f64 LossSum = 0.0;
+    for(u32 WorkerIdx = 0; WorkerIdx < Trainer->num_workers; ++WorkerIdx) LossSum += Trainer->workers[WorkerIdx].loss_sum;
+    return Trainer->num_batches ? (f32)(LossSum/Trainer->num_batches) : 0.f;
+}
+
+#ifdef GRAZIE_PLT_LINUX
+/* NOTE(abid): Sleeps on `Seq` until `*Flag` is stamped with `Step`. Whoever stamps a flag bumps the sequence
+ *             after it, so a stamp cannot slip in between the check and the wait. */
+internal inline void
+__gz_mp_wait(u32 *Seq, u32 *Flag, u32 Step) {
+    for(;;) {
+        u32 Observed = gz_atomic_load_u32(Seq);
+        if(gz_atomic_load_u32(Flag) == Step) return;
+        gz_futex_wait(Seq, Observed);
+    }
+}
+
+internal inline void
+__gz_mp_signal(u32 *Seq, u32 *Flag, u32 Step) {
+    gz_atomic_store_u32(Flag, Step);
+    gz_atomic_add_u32(Seq, 1);
+    gz_futex_wake_all(Seq);
+}
+
+internal void
+__gz_mp_barrier(multi_process *Trainer) {
+    mp_shared *Shared = Trainer->shared;
+    u32 Generation = gz_atomic_load_u32(&Shared->barrier_generation);
+    if(gz_atomic_add_u32(&Shared->barrier_arrived, 1) == Trainer->num_workers-1) {
+        gz_atomic_store_u32(&Shared->barrier_arrived, 0);
+        gz_atomic_add_u32(&Shared->barrier_generation, 1);
+        gz_futex_wake_all(&Shared->barrier_generation);
+    } else {
+        while(gz_atomic_load_u32(&Shared->barrier_generation) == Generation)
+            gz_futex_wait(&Shared->barrier_generation, Generation);
+    }
+}
+
+internal inline usize
+__gz_mp_bucket_end(multi_process *Trainer, u32 Bucket) {
+    usize End = ((usize)Bucket+1)*GZ_MP_BUCKET_ELEMENTS;
+    usize Length = Trainer->optim->params.flat.length;
+    return (End > Length) ? Length : End;
+}
+
+/* NOTE(abid): Copies the grad of a parameter out to the shared grads of this worker, and publishes every bucket
+ *             that has all of its parameters in by now. */
+internal void
+__gz_mp_publish(mp_param *Param) {
+    multi_process *Trainer = Param->trainer;
+    if(Param->published_step == Trainer->step) return;
+    Param->published_step = Trainer->step;
+
+    mp_shared *Shared = Trainer->shared;
+    usize Length = Trainer->optim->params.flat.length;
+    f32 *SharedGrad = Shared->grads + Trainer->rank*Length;
+    memcpy(SharedGrad + Param->begin, Trainer->optim->params.flat.grad + Param->begin,
+           (Param->end - Param->begin)*sizeof(f32));
+
+    for(u32 Bucket = (u32)(Param->begin/GZ_MP_BUCKET_ELEMENTS); Bucket*(usize)GZ_MP_BUCKET_ELEMENTS < Param->end; ++Bucket) {
+        usize Begin = (usize)Bucket*GZ_MP_BUCKET_ELEMENTS;
+        usize End = __gz_mp_bucket_end(Trainer, Bucket);
+        if(Begin < Param->begin) Begin = Param->begin;
+        if(End > Param->end) End = Param->end;
+        u32 Overlap = (u32)(End - Begin);
+        if(gz_atomic_add_u32(Trainer->bucket_remaining + Bucket, -(i32)Overlap) == Overlap)
+            __gz_mp_signal(&Shared->workers[Trainer->rank].publish_seq,
+                           Shared->published + Trainer->rank*Trainer->num_buckets + Bucket, Trainer->step);
+    }
+}
+
+internal void
+__gz_mp_grad_hook(t32 *Tensor, void *Context) {
+    (void)Tensor;
+    __gz_mp_publish((mp_param *)Context);
+}
+
+/* NOTE(abid): Buckets are synced from the back, since backprop finishes the last parameters first. Every bucket
+ *             owned by this worker is summed in the same order (its own grads, then the next workers around the
+ *             ring), and every worker copies the same sums back, so all of them end up with the same grads. */
+internal void
+__gz_mp_sync(multi_process *Trainer, u32 Step) {
+    mp_shared *Shared = Trainer->shared;
+    u32 NumWorkers = Trainer->num_workers;
+    u32 NumBuckets = Trainer->num_buckets;
+    usize Length = Trainer->optim->params.flat.length;
+
+    for(u32 Bucket = NumBuckets; Bucket-- > 0;) {
+        if(Bucket % NumWorkers != Trainer->rank) continue;
+        usize Begin = (usize)Bucket*GZ_MP_BUCKET_ELEMENTS;
+        usize End = __gz_mp_bucket_end(Trainer, Bucket);
+        f32 *Sum = Shared->grads + Trainer->rank*Length;
+        __gz_mp_wait(&Shared->workers[Trainer->rank].publish_seq,
+                     Shared->published + Trainer->rank*NumBuckets + Bucket, Step);
+        for(u32 Offset = 1; Offset < NumWorkers; ++Offset) {
+            u32 Peer = (Trainer->rank + Offset) % NumWorkers;
+            __gz_mp_wait(&Shared->workers[Peer].publish_seq, Shared->published + Peer*NumBuckets + Bucket, Step);
+            f32 *PeerGrad = Shared->grads + Peer*Length;
+            for(usize Idx = Begin; Idx < End; ++Idx) Sum[Idx] += PeerGrad[Idx];
+        }
+        __gz_mp_signal(&Shared->workers[Trainer->rank].reduce_seq, Shared->reduced + Bucket, Step);
+    }
+
+    f32 *Grad = Trainer->optim->params.flat.grad;
+    for(u32 Bucket = NumBuckets; Bucket-- > 0;) {
+        u32 Owner = Bucket % NumWorkers;
+        usize Begin = (usize)Bucket*GZ_MP_BUCKET_ELEMENTS;
+        usize End = __gz_mp_bucket_end(Trainer, Bucket);
+        __gz_mp_wait(&Shared->workers[Owner].reduce_seq, Shared->reduced + Bucket, Step);
+        memcpy(Grad + Begin, Shared->grads + Owner*Length + Begin, (End - Begin)*sizeof(f32));
+    }
+}
+
+internal void *
+__gz_mp_comm_main(void *Arg) {
+    multi_process *Trainer = (multi_process *)Arg;
+    u32 LastStep = 0;
+    for(;;) {
+        u32 Step;
+        while((Step = gz_atomic_load_u32(&Trainer->comm_start)) == LastStep) gz_futex_wait(&Trainer->comm_start, Step);
+        if(Trainer->should_quit) break;
+        LastStep = Step;
+
+        __gz_mp_sync(Trainer, Step);
+        gz_atomic_store_u32(&Trainer->comm_done, Step);
+        gz_futex_wake_all(&Trainer->comm_done);
+    }
+
+    return NULL;
+}
+
+/* NOTE(abid): Pins the calling process to the cpus of a NUMA node, workers being dealt out to the nodes in turn.
+ *             Returns the number of cpus the worker gets, or 0 if the system tells nothing about its nodes. */
+internal u32
+__gz_mp_pin_numa(u32 Rank, u32 NumWorkers) {
+    u32 NumNodes = 0;
+    char Path[64];
+    for(;; ++NumNodes) {
+        snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%u/cpulist", NumNodes);
+        if(access(Path, R_OK) != 0) break;
+    }
+    if(!NumNodes) return 0;
+
+    u32 Node = Rank % NumNodes;
+    snprintf(Path, sizeof(Path), "/sys/devices/system/node/node%u/cpulist", Node);
+    FILE *File = fopen(Path, "r");
+    if(!File) return 0;
+    cpu_set_t CpuSet;
+    CPU_ZERO(&CpuSet);
+    u32 NumCpus = 0, First, Last;
+    while(fscanf(File, "%u", &First) == 1) {
+        Last = First;
+        i32 Separator = fgetc(File);
+        if(Separator == '-') {
+            if(fscanf(File, "%u", &Last) != 1) break;
+            Separator = fgetc(File);
+        }
+        for(u32 Cpu = First; (Cpu <= Last) && (Cpu < CPU_SETSIZE); ++Cpu, ++NumCpus) CPU_SET(Cpu, &CpuSet);
+        if(Separator != ',') break;
+    }
+    fclose(File);
+    if(!NumCpus || sched_setaffinity(0, sizeof(CpuSet), &CpuSet) != 0) return 0;
+
+    u32 WorkersOnNode = NumWorkers/NumNodes + (Node < (NumWorkers % NumNodes));
+    return NumCpus/WorkersOnNode;
+}
+
+/* NOTE(abid): Forks `NumWorkers`-1 workers, the calling process being worker 0. Must be called without a job on
+ *             the thread pool, since the threads of the pool do not survive the fork; every worker gets a pool
+ *             of its own on its node instead. From here on every process has to call `gz_multi_process_step`
+ *             with the same batches, and `gz_multi_process_destroy` at the end, which only returns on worker 0.
+ *             The parameters of `Optim` must be the flat list of `Modules`. */
+internal multi_process *
+gz_multi_process_create(module **Modules, u64 NumModules, mem_arena *ModelArena, optimizer *Optim, u32 NumWorkers,
+                        trainer_loss *Loss, reduce_method Reduce, usize StepArenaBytes) {
+    assert(NumWorkers > 0, "multi-process training needs at least one worker");
+    assert(Optim->params.flat.length, "multi-process training needs the parameters in a model arena");
+    assert(!__gzGLOBALMemPlan, "memory plans cannot be used with multi-process training");
+
+    mem_arena *Meta = gz_mem_arena_meta(ModelArena);
+    multi_process *Trainer = gz_mem_push_struct(multi_process, Meta);
+    memset(Trainer, 0, sizeof(multi_process));
+    Trainer->num_workers = NumWorkers;
+    Trainer->modules = Modules;
+    Trainer->num_modules = NumModules;
+    Trainer->optim = Optim;
+    Trainer->loss = Loss;
+    Trainer->reduce = Reduce;
+    Trainer->step_arena = gz_mem_step_arena(StepArenaBytes, GZ_TRAINER_STEP_HIGH_WATER);
+
+    usize Length = Optim->params.flat.length;
+    u32 NumBuckets = (u32)((Length + GZ_MP_BUCKET_ELEMENTS-1)/GZ_MP_BUCKET_ELEMENTS);
+    Trainer->num_buckets = NumBuckets;
+    Trainer->bucket_need = gzMemPushArray(Meta, u32, NumBuckets);
+    Trainer->bucket_remaining = gzMemPushArray(Meta, u32, NumBuckets);
+    memset(Trainer->bucket_need, 0, NumBuckets*sizeof(u32));
+
+    tensor_list *Params = &Optim->params;
+    Trainer->param_ranges = gzMemPushArray(Meta, mp_param, Params->used);
+    for(usize Idx = 0; Idx < Params->used; ++Idx) {
+        t32 *Tensor = Params->array[Idx];
+        mp_param *Param = Trainer->param_ranges + Idx;
+        Param->trainer = Trainer;
+        Param->begin = (usize)((f32 *)Tensor->Data.Ptr - Params->flat.data);
+        Param->end = Param->begin + Tensor->Header->StorageNumElements;
+        Param->published_step = 0;
+        for(usize Elem = Param->begin; Elem < Param->end;) {
+            u32 Bucket = (u32)(Elem/GZ_MP_BUCKET_ELEMENTS);
+            usize End = __gz_mp_bucket_end(Trainer, Bucket);
+            if(End > Param->end) End = Param->end;
+            Trainer->bucket_need[Bucket] += (u32)(End - Elem);
+            Elem = End;
+        }
+        gz_grad_hook_register(Tensor, __gz_mp_grad_hook, Param, ModelArena);
+    }
+
+    /* NOTE(abid): Control first, then the flags and the grads of every worker, each on its own cache line. */
+    usize WorkersOffset = 64;
+    usize PublishedOffset = WorkersOffset + NumWorkers*sizeof(mp_worker_sync);
+    usize ReducedOffset = PublishedOffset + (((usize)NumWorkers*NumBuckets*sizeof(u32) + 63) & ~(usize)63);
+    usize GradsOffset = ReducedOffset + (((usize)NumBuckets*sizeof(u32) + 63) & ~(usize)63);
+    Trainer->shared_bytes = GradsOffset + (usize)NumWorkers*Length*sizeof(f32);
+    u8 *Memory = (u8 *)mmap(NULL, Trainer->shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(Memory != MAP_FAILED, "could not map %zu bytes of shared memory", Trainer->shared_bytes);
+    mp_shared *Shared = (mp_shared *)Memory;
+    Shared->workers = (mp_worker_sync *)(Memory + WorkersOffset);
+    Shared->published = (u32 *)(Memory + PublishedOffset);
+    Shared->reduced = (u32 *)(Memory + ReducedOffset);
+    Shared->grads = (f32 *)(Memory + GradsOffset);
+    Trainer->shared = Shared;
+
+    gz_grad_zero(*Params);
+    Trainer->children = gzMemPushArray(Meta, pid_t, NumWorkers);
+    for(u32 Rank = 1; Rank < NumWorkers; ++Rank) {
+        pid_t Pid = fork();
+        assert(Pid >= 0, "could not fork worker %u", Rank);
+        if(Pid == 0) {
+            Trainer->rank = Rank;
+            /* NOTE(abid): The copy of the pool lost its threads in the fork, so it is left behind. */
+            __gzGLOBALThreadPool = NULL;
+            break;
+        }
+        Trainer->children[Rank] = Pid;
+    }
+
+    u32 NumThreads = __gz_mp_pin_numa(Trainer->rank, NumWorkers);
+    if(!NumThreads) NumThreads = gz_thread_num_cores()/NumWorkers;
+    gz_thread_pool_init(NumThreads ? NumThreads : 1);
+
+    i32 Error = pthread_create(&Trainer->comm_thread, NULL, __gz_mp_comm_main, Trainer);
+    assert(Error == 0, "could not create the comm thread, error %d", Error);
+
+    return Trainer;
+}
+
+/* NOTE(abid): Same as `gz_data_parallel_step`, called by every worker with the same batch. Returns the loss of
+ *             the whole batch on every worker. */
+internal f32
+gz_multi_process_step(multi_process *Trainer, t32 *Input, t32 *Target) {
+    assert(Input->Header->IsContiguous && Target->Header->IsContiguous, "batch must be contiguous");
+    u32 NumRows = Input->Header->Sizes[0];
+    assert(Target->Header->Sizes[0] == NumRows, "input and target have a different number of rows");
+    mp_shared *Shared = Trainer->shared;
+    u32 NumWorkers = Trainer->num_workers;
+
+    /* NOTE(abid): Nobody may publish into the shared grads before everyone copied the sums of the last step. */
+    __gz_mp_barrier(Trainer);
+    u32 Step = ++Trainer->step;
+    memcpy(Trainer->bucket_remaining, Trainer->bucket_need, Trainer->num_buckets*sizeof(u32));
+    gz_atomic_store_u32(&Trainer->comm_start, Step);
+    gz_futex_wake_all(&Trainer->comm_start);
+    for(u32 Bucket = 0; Bucket < Trainer->num_buckets; ++Bucket) if(!Trainer->bucket_need[Bucket])
+        __gz_mp_signal(&Shared->workers[Trainer->rank].publish_seq,
+                       Shared->published + Trainer->rank*Trainer->num_buckets + Bucket, Step);
+
+    u32 Row = 0;
+    for(u32 Rank = 0; Rank < Trainer->rank; ++Rank) Row += NumRows/NumWorkers + (Rank < (NumRows % NumWorkers));
+    u32 ShardRows = NumRows/NumWorkers + (Trainer->rank < (NumRows % NumWorkers));
+    f32 Weight = (Trainer->reduce == reduce_mean) ? (f32)ShardRows/(f32)NumRows : 1.f;
+    Shared->workers[Trainer->rank].loss = 0.f;
+
+    gz_mem_arena_reset(&Trainer->step_arena);
+    if(ShardRows) {
+        t32 *ShardInput = __gz_trainer_shard(Input, Row, ShardRows, &Trainer->step_arena);
+        t32 *ShardTarget = __gz_trainer_shard(Target, Row, ShardRows, &Trainer->step_arena);
+
+        t32 *Prediction = gz_module_run_all(Trainer->modules, Trainer->num_modules, ShardInput, &Trainer->step_arena);
+        t32 *Loss = Trainer->loss(Prediction, ShardTarget, Trainer->reduce, &Trainer->step_arena);
+        Shared->workers[Trainer->rank].loss = Weight * *((f32 *)Loss->Data.Ptr + Loss->Header->Offset);
+        gz_backprop_many(&Loss, &Weight, 1);
+    }
+    /* NOTE(abid): Parameters that got no grad this step still have to be published. */
+    for(usize Idx = 0; Idx < Trainer->optim->params.used; ++Idx) __gz_mp_publish(Trainer->param_ranges + Idx);
+
+    u32 Done;
+    while((Done = gz_atomic_load_u32(&Trainer->comm_done)) != Step) gz_futex_wait(&Trainer->comm_done, Done);
+
+    /* NOTE(abid): Every worker has published all of its buckets, and with them its loss. */
+    f32 Result = 0.f;
+    for(u32 Rank = 0; Rank < NumWorkers; ++Rank) Result += Shared->workers[Rank].loss;
+
+    gz_optim_step(Trainer->optim);
+    gz_grad_zero(Trainer->optim->params);
+
+    return Result;
+}
+
+/* NOTE(abid): Every worker but 0 exits in here, worker 0 returns once all of them are gone. */
+internal void
+gz_multi_process_destroy(multi_process *Trainer) {
+    Trainer->should_quit = true;
+    gz_atomic_add_u32(&Trainer->comm_start, 1);
+    gz_futex_wake_all(&Trainer->comm_start);
+    pthread_join(Trainer->comm_thread, NULL);
+    for(usize Idx = 0; Idx < Trainer->optim->params.used; ++Idx) gz_grad_hook_remove(Trainer->optim->params.array[Idx]);
+
+    if(Trainer->rank != 0) _exit(0);
+    for(u32 Rank = 1; Rank < Trainer->num_workers; ++Rank) {
+        i32 Status = 0;
+        waitpid(Trainer->children[Rank], &Status, 0);
+        assert(WIFEXITED(Status) && (WEXITSTATUS(Status) == 0), "worker %u did not exit cleanly", Rank);
+    }
+    munmap(Trainer->shared, Trainer->shared_bytes);
+}
+#endif
@@ -0,0 +1,150 @@
+/*  +======| File Info |===============================================================+
+    |                                                                                  |
+    |     Subdirectory:  /src                                                          |
+    |    Creation date:  10/19/2026 6:42:10 PM                                         |
+    |    Last Modified:                                                                |
+    |                                                                                  |
+    +======================================| Copyright © Sayed Abid Hashimi |==========+  */
+
+#if !defined(TRAINER_H)
+
+/* NOTE(abid): Same signature as the losses in loss.c, e.g. `gz_loss_binary_cross_entropy`. */
+typedef t32 *trainer_loss(t32 *prediction, t32 *target, reduce_method method, mem_arena *arena);
+
+/* NOTE(abid): One copy of the model. Replica 0 is the model the trainer was made from, the others are clones
+ *             in model arenas of their own, so all of them have the same flat layout. */
+typedef struct {
+    module **modules;
+    mem_arena *model_arena;
+    tensor_list params;
+    mem_arena step_arena;
+
+    /* NOTE(abid): Of the current step, the rows of the batch this replica works on. */
+    t32 *input;
+    t32 *target;
+    f32 weight;
+    f32 loss;
+} trainer_replica;
+
+/* NOTE(abid): Synchronous data-parallel training on the thread pool. Every step the batch is split into one
+ *             shard per replica and the replicas run forward and backward at the same time. Their grads are
+ *             then summed into replica 0 (reduce-scatter, each task owns a slice of the flat buffers), the
+ *             optimizer steps replica 0, and its parameters are copied back out to the others (all-gather). */
+typedef struct {
+    trainer_replica *replicas;
+    u32 num_replicas;
+    u64 num_modules;
+
+    trainer_loss *loss;
+    reduce_method reduce;
+    optimizer *optim;
+} data_parallel;
+
+/* NOTE(abid): Worker 0 runs the model itself, the others run clones whose data is pointed back at the
+ *             parameters of the model, so only their grads (and activations) are their own. */
+typedef struct {
+    module **modules;
+    tensor_list params;
+    mem_arena step_arena;
+    /* NOTE(abid): Of the clone, NULL for worker 0. */
+    mem_arena *model_arena;
+
+    f64 loss_sum;
+    u64 num_batches;
+} hogwild_worker;
+
+/* NOTE(abid): Asynchronous SGD without locks (Hogwild). Every worker takes the next batch off a shared counter,
+ *             runs forward and backward on its own, and subtracts its grads straight from the shared parameters
+ *             with relaxed loads and stores. Updates of different workers may overwrite each other, which is
+ *             rare as long as the grads are sparse, and only the non-zero grads are written at all. */
+typedef struct {
+    hogwild_worker *workers;
+    u32 num_workers;
+    u64 num_modules;
+    flat_params shared;
+
+    trainer_loss *loss;
+    reduce_method reduce;
+    f32 learning_rate;
+
+    /* NOTE(abid): Of the current run. */
+    dataset *inputs;
+    dataset *targets;
+    u32 next_batch;
+    u32 num_batches;
+} hogwild;
+
+#ifdef GRAZIE_PLT_LINUX
+/* NOTE(abid): Gradients are synced in buckets of the flat buffers. Bucket `b` is summed by worker `b % N`. */
+#define GZ_MP_BUCKET_ELEMENTS (1 << 16)
+
+/* NOTE(abid): `publish_seq` and `reduce_seq` are futexes that go up whenever the worker published a bucket of
+ *             its grads, or the sum of a bucket it owns, so that others can sleep on them. One cache line each. */
+typedef struct {
+    u32 publish_seq;
+    u32 reduce_seq;
+    f32 loss;
+    u8 _padding[64 - 3*sizeof(u32)];
+} mp_worker_sync;
+
+/* NOTE(abid): Mapped shared before the fork, so every process sees it at the same address. The flags are
+ *             stamped with the step they are for, i.e. nothing has to be cleared between steps. */
+typedef struct {
+    u32 barrier_arrived;
+    u32 barrier_generation;
+
+    mp_worker_sync *workers;
+    u32 *published; /* NOTE(abid): [worker][bucket] */
+    u32 *reduced;   /* NOTE(abid): [bucket] */
+    f32 *grads;     /* NOTE(abid): [worker][flat length] */
+} mp_shared;
+
+struct multi_process;
+typedef struct {
+    struct multi_process *trainer;
+    usize begin;
+    usize end;
+    u32 published_step;
+} mp_param;
+
+/* NOTE(abid): Multi-process data-parallel training, Linux only. `gz_multi_process_create` forks the workers,
+ *             after which every process runs the same training loop on its own copy of everything (the model,
+ *             the optimizer and the arenas) and its own rows of every batch. While backprop runs, the grad of
+ *             every parameter is published to shared memory as soon as it is final, and a comm thread per
+ *             worker sums the buckets it owns (reduce-scatter) and copies the sums of the others back
+ *             (all-gather) as they become ready. The optimizer then steps every worker the same way. */
+typedef struct multi_process {
+    u32 rank;
+    u32 num_workers;
+    pid_t *children;
+
+    mp_shared *shared;
+    usize shared_bytes;
+    u32 num_buckets;
+    u32 *bucket_need;      /* NOTE(abid): Elements of parameters in the bucket, padding is never published. */
+    u32 *bucket_remaining;
+    mp_param *param_ranges;
+
+    module **modules;
+    u64 num_modules;
+    optimizer *optim;
+    trainer_loss *loss;
+    reduce_method reduce;
+    mem_arena step_arena;
+    u32 step;
+
+    pthread_t comm_thread;
+    u32 comm_start; /* NOTE(abid): Futexes, the step the comm thread is to sync and the one it is done with. */
+    u32 comm_done;
+    bool should_quit;
+} multi_process;
+#endif
+
+/* NOTE(abid): Slice of the flat buffers that a single task of the all-reduce owns. The slices of all replicas
+ *             are walked together, so this is kept small enough for all of them to sit in cache. */
+#define GZ_TRAINER_SLICE_ELEMENTS (1 << 12)
+/* NOTE(abid): Committed memory every step arena keeps between steps. */
+#define GZ_TRAINER_STEP_HIGH_WATER gzMegabyte(64)
+
+#define TRAINER_H
+#endif
@@ -64,6 +64,13 @@ typedef size_t usize;
 #define local_persist static
 #define global_var static
 
+#ifdef GRAZIE_PLT_WIN
+#define thread_local_var __declspec(thread)
+#endif
+#ifdef GRAZIE_PLT_LINUX
+#define thread_local_var __thread
+#endif
+
 /* NOTE(Abid): Defines if op history should be preserved for gradient calculation */
 #define GRAD_PRESERVE(Value) __GetSetGradState(true, Value)
 #define GRAD_PRESERVE_TOGGLE() __GetSetGradState(true, !IS_GRAD_PRESERVE())
@@ -71,7 +78,9 @@ typedef size_t usize;
 
 inline internal bool
 __GetSetGradState(bool Set, bool NewState) {
-    local_persist bool ShouldGrad = true;
+    /* NOTE(abid): Per thread, a checkpointed forward turns it off for a while, which must not leak into the
+     *             forward of a replica on another thread. */
+    local_persist thread_local_var bool ShouldGrad = true;
 
     if(Set) ShouldGrad = NewState;
 